@@ -0,0 +1,126 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/fork_database.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace bpo = boost::program_options;
+using namespace eosio::chain;
+
+static int64_t heap_in_use() {
+#ifdef __GLIBC__
+   return mallinfo().uordblks;
+#else
+   return -1;
+#endif
+}
+
+/// a schedule of the given number of producers with distinct keys
+static producer_schedule_type make_schedule( uint32_t producers ) {
+   producer_schedule_type schedule;
+   for( uint32_t i = 0; i < producers; ++i ) {
+      const std::string name = std::string("producer") + char('a' + i % 26) + char('a' + i / 26);
+      auto key = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( name ) );
+      schedule.producers.push_back( producer_key{ account_name( name ), key.get_public_key() } );
+   }
+   return schedule;
+}
+
+/**
+ * Grows a fork database by a chain of blocks that never become irreversible, which is what a long stall of the last
+ * irreversible block (or the irreversible read mode) leaves it holding, and reports the heap held per block state.
+ * Each block only confirms itself, so no block reaches the confirmations needed to become irreversible.
+ *
+ * With --deep-copy every state is given copies of its own of the schedules it would otherwise share with its parent,
+ * which is the layout the states had before the schedules were made immutable values.
+ */
+int main(int argc, char** argv) {
+   uint32_t blocks = 0;
+   uint32_t producers = 0;
+   bool deep_copy = false;
+
+   bpo::options_description cli("fork_db_bench command line options");
+   cli.add_options()
+      ("blocks", bpo::value<uint32_t>(&blocks)->default_value(10000), "reversible blocks added to the fork database")
+      ("producers", bpo::value<uint32_t>(&producers)->default_value(21), "producers in the active schedule")
+      ("deep-copy", bpo::bool_switch(&deep_copy)->default_value(false), "give each block state copies of its own of the shared parts")
+      ("help,h", "print this help message and exit");
+
+   bpo::variables_map vmap;
+   bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+   bpo::notify(vmap);
+   if(vmap.count("help")) {
+      cli.print(std::cout);
+      return 0;
+   }
+   if( producers == 0 || producers > 26 * 26 ) {
+      std::cerr << "producers must be between 1 and " << 26 * 26 << std::endl;
+      return 1;
+   }
+
+   const auto schedule = make_schedule( producers );
+   block_header_state genesis;
+   genesis.active_schedule       = schedule;
+   genesis.pending_schedule      = producer_schedule_type();
+   genesis.header.timestamp      = block_timestamp_type( fc::time_point::from_iso_string( "2020-01-01T00:00:00.000" ) );
+   genesis.id                    = genesis.header.id();
+   genesis.block_num             = genesis.header.block_num();
+
+   fc::temp_directory tempdir;
+   fork_database fork_db( tempdir.path() );
+
+   auto make_state = []( const block_header_state& h ) {
+      auto s = std::make_shared<block_state>( h );
+      s->block = std::make_shared<signed_block>( h.header );
+      return s;
+   };
+
+   const auto heap_before = heap_in_use();
+   auto start = std::chrono::high_resolution_clock::now();
+
+   block_state_ptr prev = make_state( genesis );
+   fork_db.set( prev );
+   uint64_t shared_schedules = 0;
+   for( uint32_t n = 0; n < blocks; ++n ) {
+      auto next = prev->generate_next( block_timestamp_type() );
+      next.set_confirmed( 0 );
+      next.id = next.header.id();
+      if( deep_copy ) {
+         next.active_schedule              = producer_schedule_type( *next.active_schedule );
+         next.pending_schedule             = producer_schedule_type( *next.pending_schedule );
+      }
+      if( next.active_schedule.shares_instance_with( prev->active_schedule ) )
+         ++shared_schedules;
+      auto s = make_state( next );
+      fork_db.add( s, true );
+      prev = s;
+   }
+
+   auto elapsed = std::chrono::high_resolution_clock::now() - start;
+   const auto heap_after = heap_in_use();
+
+   std::cout << blocks << " reversible blocks, " << producers << " producers, "
+             << (deep_copy ? "deep copied" : "shared") << " state, "
+             << shared_schedules << " states sharing the active schedule of their parent" << std::endl;
+   std::cout << std::setw(24) << "us per block" << std::setw(16) << std::fixed << std::setprecision(1)
+             << std::chrono::duration<double, std::micro>(elapsed).count() / blocks << std::endl;
+   if( heap_before >= 0 ) {
+      std::cout << std::setw(24) << "heap MiB" << std::setw(16) << (heap_after - heap_before) / (1024.0 * 1024.0) << std::endl;
+      std::cout << std::setw(24) << "heap bytes per block" << std::setw(16) << double(heap_after - heap_before) / blocks << std::endl;
+   } else {
+      std::cout << std::setw(24) << "heap MiB" << std::setw(16) << "n/a" << std::endl;
+   }
+   return 0;
+}
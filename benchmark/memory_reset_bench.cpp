@@ -0,0 +1,108 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/wasm_eosio_constraints.hpp>
+
+#include "IR/Types.h"
+#include "Runtime/Runtime.h"
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace bpo = boost::program_options;
+using namespace eosio::chain;
+
+/**
+ * Compares the cost of resetting a WAVM linear memory between actions with the memset path it replaced, for a range of
+ * memory sizes and of pages dirtied by the previous action.
+ *
+ * The reset only decommits and recommits, so the pages the next action touches fault back in then; that refault is
+ * timed separately and included in the total. The old path zeroed the whole memory as it grew it back, faulting in
+ * every page during the reset so the next touch was free: it is timed here as the same decommit and recommit
+ * followed by a memset of the whole memory, and then the touch.
+ */
+int main(int argc, char** argv) {
+   uint32_t iterations = 0;
+
+   bpo::options_description cli("memory_reset_bench command line options");
+   cli.add_options()
+      ("iterations", bpo::value<uint32_t>(&iterations)->default_value(1000), "number of resets timed per configuration")
+      ("help,h", "print this help message and exit");
+
+   bpo::variables_map vmap;
+   bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+   bpo::notify(vmap);
+   if(vmap.count("help")) {
+      cli.print(std::cout);
+      return 0;
+   }
+
+   Runtime::init();
+
+   const std::vector<uint64_t> memory_pages = {1, 16, 64, 256, wasm_constraints::maximum_linear_memory/wasm_constraints::wasm_page_size};
+   const std::vector<uint64_t> dirty_kib    = {4, 64, 1024};
+   const uint64_t os_page_size = 4096;
+
+   std::cout << std::setw(12) << "memory KiB" << std::setw(12) << "dirty KiB"
+             << std::setw(12) << "reset us" << std::setw(12) << "refault us" << std::setw(12) << "total us"
+             << std::setw(14) << "memset us" << std::endl;
+
+   for(uint64_t pages : memory_pages) {
+      IR::MemoryType type(false, {pages, pages});
+      Runtime::MemoryInstance* memory = Runtime::createMemory(type);
+      if(!memory) {
+         std::cerr << "unable to create a memory of " << pages << " pages" << std::endl;
+         return 1;
+      }
+      const uint64_t memory_bytes = pages * wasm_constraints::wasm_page_size;
+
+      for(uint64_t dirty : dirty_kib) {
+         const uint64_t dirty_bytes = std::min(dirty * 1024, memory_bytes);
+         auto touch = [&]() {
+            U8* base = Runtime::getMemoryBaseAddress(memory);
+            for(uint64_t offset = 0; offset < dirty_bytes; offset += os_page_size)
+               base[offset] = 1;
+         };
+
+         std::chrono::nanoseconds reset_time(0), refault_time(0), memset_time(0);
+         touch();
+         for(uint32_t i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            Runtime::resetMemory(memory, type);
+            auto reset = std::chrono::steady_clock::now();
+            touch();
+            auto end = std::chrono::steady_clock::now();
+            reset_time += reset - start;
+            refault_time += end - reset;
+
+            start = std::chrono::steady_clock::now();
+            Runtime::resetMemory(memory, type);
+            memset(Runtime::getMemoryBaseAddress(memory), 0, memory_bytes);
+            touch();
+            memset_time += std::chrono::steady_clock::now() - start;
+
+            // leave only the dirtied pages populated for the next reset, as an action would
+            Runtime::resetMemory(memory, type);
+            touch();
+         }
+
+         auto us = [&](std::chrono::nanoseconds t) {
+            return std::chrono::duration<double, std::micro>(t).count() / iterations;
+         };
+         std::cout << std::setw(12) << memory_bytes / 1024 << std::setw(12) << dirty_bytes / 1024
+                   << std::setw(12) << std::fixed << std::setprecision(2) << us(reset_time)
+                   << std::setw(12) << us(refault_time)
+                   << std::setw(12) << us(reset_time + refault_time)
+                   << std::setw(14) << us(memset_time) << std::endl;
+      }
+   }
+
+   Runtime::freeUnreferencedObjects({});
+   return 0;
+}
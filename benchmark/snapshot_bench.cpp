@@ -0,0 +1,210 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/snapshot.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace bpo = boost::program_options;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+/**
+ * The action data is [u64 first scope][u32 scopes][u32 rows]. For each of the scopes from the first one on, the
+ * action stores the given number of rows in table 1 of that scope, each 16 bytes laid out as a token balance: an
+ * amount followed by a symbol. That is the shape of the largest tables on a busy chain, one small table per holder.
+ */
+static const char table_fill_wast[] = R"=====(
+(module
+ (import "env" "read_action_data" (func $read_action_data (param i32 i32) (result i32)))
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $scope i64)
+  (local $end i64)
+  (local $rows i64)
+  (local $row i64)
+  (drop (call $read_action_data (i32.const 0) (i32.const 16)))
+  (set_local $scope (i64.load (i32.const 0)))
+  (set_local $end (i64.add (get_local $scope) (i64.extend_u/i32 (i32.load (i32.const 8)))))
+  (set_local $rows (i64.extend_u/i32 (i32.load (i32.const 12))))
+  (i64.store (i32.const 24) (i64.const 1397703940))
+  (block $scopes_done
+   (loop $scopes
+    (br_if $scopes_done (i64.ge_u (get_local $scope) (get_local $end)))
+    (set_local $row (i64.const 0))
+    (block $rows_done
+     (loop $rows_loop
+      (br_if $rows_done (i64.ge_u (get_local $row) (get_local $rows)))
+      (i64.store (i32.const 16) (i64.mul (i64.add (get_local $scope) (get_local $row)) (i64.const 10000)))
+      (drop (call $db_store_i64 (get_local $scope) (i64.const 1) (get_local $0) (get_local $row) (i32.const 16) (i32.const 16)))
+      (set_local $row (i64.add (get_local $row) (i64.const 1)))
+      (br $rows_loop)
+     )
+    )
+    (set_local $scope (i64.add (get_local $scope) (i64.const 1)))
+    (br $scopes)
+   )
+  )
+ )
+)
+)=====";
+
+struct snapshot_format {
+   std::string name;
+   bool        sectioned = false;
+   uint32_t    threads = 1;
+   bool        compress = false;
+};
+
+/**
+ * Fills a chain with contract tables and then writes its state as a snapshot in each format, and loads each snapshot
+ * into a new chain: the version 1 stream written and read on one thread, and the sectioned version 2 written and read
+ * on one thread and on the given number of threads, with and without compression.
+ *
+ * Reported are the seconds to write and to load each snapshot and its size. Loading includes the integrity hash the
+ * controller computes of a state loaded from a snapshot, which takes the same time whatever the format.
+ */
+int main(int argc, char** argv) {
+   uint32_t tables = 0;
+   uint32_t rows_per_table = 0;
+   uint32_t threads = 0;
+   uint64_t chunk_size = 0;
+   uint64_t state_size = 0;
+
+   bpo::options_description cli("snapshot_bench command line options");
+   cli.add_options()
+      ("tables", bpo::value<uint32_t>(&tables)->default_value(100000), "contract tables, each in a scope of its own")
+      ("rows-per-table", bpo::value<uint32_t>(&rows_per_table)->default_value(10), "rows stored in each table")
+      ("threads", bpo::value<uint32_t>(&threads)->default_value(4), "threads writing and reading the sectioned snapshots")
+      ("chunk-size", bpo::value<uint64_t>(&chunk_size)->default_value(sectioned_snapshot_writer::default_chunk_size), "bytes of rows in each chunk of the sectioned snapshots")
+      ("state-size", bpo::value<uint64_t>(&state_size)->default_value(2ull*1024*1024*1024), "size of the chain state database")
+      ("help,h", "print this help message and exit");
+
+   bpo::variables_map vmap;
+   bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+   bpo::notify(vmap);
+   if(vmap.count("help")) {
+      cli.print(std::cout);
+      return 0;
+   }
+   if( rows_per_table == 0 || threads == 0 ) {
+      std::cerr << "rows-per-table and threads must be greater than 0" << std::endl;
+      return 1;
+   }
+
+   try {
+      fc::temp_directory tempdir;
+
+      controller::config cfg;
+      cfg.blocks_dir             = tempdir.path() / "chain" / config::default_blocks_dir_name;
+      cfg.state_dir              = tempdir.path() / "chain" / config::default_state_dir_name;
+      cfg.state_size             = state_size;
+      cfg.state_guard_size       = 0;
+      cfg.reversible_guard_size  = 0;
+      cfg.genesis.initial_timestamp = fc::time_point::from_iso_string("2020-01-01T00:00:00.000");
+      cfg.genesis.initial_key       = base_tester::get_public_key( config::system_account_name, "active" );
+
+      tester chain(cfg);
+      const account_name filler = N(filler);
+      chain.create_accounts( {filler} );
+      chain.produce_block();
+      chain.set_code(filler, table_fill_wast);
+      chain.produce_block();
+
+      // enough tables per transaction for a couple of thousand rows each
+      const uint32_t tables_per_trx = std::max<uint32_t>( 1, 2000 / rows_per_table );
+      uint32_t transactions = 0;
+      for( uint32_t first = 0; first < tables; first += tables_per_trx ) {
+         bytes data(16);
+         fc::datastream<char*> ds( data.data(), data.size() );
+         fc::raw::pack( ds, uint64_t(first + 1) );
+         fc::raw::pack( ds, std::min( tables_per_trx, tables - first ) );
+         fc::raw::pack( ds, rows_per_table );
+
+         signed_transaction trx;
+         action act;
+         act.account = filler;
+         act.name = N(fill);
+         act.authorization = vector<permission_level>{{filler, config::active_name}};
+         act.data = std::move(data);
+         trx.actions.push_back(act);
+         chain.set_transaction_headers(trx);
+         trx.sign(chain.get_private_key(filler, "active"), chain.control->get_chain_id());
+         chain.push_transaction(trx);
+         if( ++transactions % 50 == 0 )
+            chain.produce_block();
+      }
+      chain.produce_block();
+      chain.control->abort_block();
+
+      const std::vector<snapshot_format> formats = {
+         { "v1",                                      false, 1,       false },
+         { "v2 1 thread",                             true,  1,       false },
+         { "v2 " + std::to_string(threads) + " threads",      true,  threads, false },
+         { "v2 " + std::to_string(threads) + " threads zlib", true,  threads, true  },
+      };
+
+      std::cout << tables << " tables of " << rows_per_table << " rows" << std::endl;
+      std::cout << std::setw(24) << "" << std::setw(12) << "write s" << std::setw(12) << "load s" << std::setw(12) << "MiB" << std::endl;
+
+      uint32_t ordinal = 0;
+      for( const auto& format : formats ) {
+         const auto path = (tempdir.path() / ("snapshot-" + std::to_string(ordinal) + ".bin")).generic_string();
+
+         auto start = std::chrono::high_resolution_clock::now();
+         {
+            std::ofstream out( path, (std::ios::out | std::ios::binary) );
+            if( format.sectioned ) {
+               auto writer = std::make_shared<sectioned_snapshot_writer>( out, format.threads, format.compress, chunk_size );
+               chain.control->write_snapshot( writer );
+               writer->finalize();
+            } else {
+               auto writer = std::make_shared<ostream_snapshot_writer>( out );
+               chain.control->write_snapshot( writer );
+               writer->finalize();
+            }
+            out.flush();
+         }
+         const std::chrono::duration<double> write_time = std::chrono::high_resolution_clock::now() - start;
+
+         controller::config load_cfg = cfg;
+         load_cfg.blocks_dir = tempdir.path() / std::to_string(ordinal) / config::default_blocks_dir_name;
+         load_cfg.state_dir  = tempdir.path() / std::to_string(ordinal) / config::default_state_dir_name;
+
+         std::chrono::duration<double> load_time;
+         {
+            controller loaded( load_cfg );
+            loaded.add_indices();
+
+            std::ifstream in( path, (std::ios::in | std::ios::binary) );
+            auto reader = make_istream_snapshot_reader( in, format.threads );
+
+            start = std::chrono::high_resolution_clock::now();
+            loaded.startup( []() { return false; }, reader );
+            load_time = std::chrono::high_resolution_clock::now() - start;
+         }
+         fc::remove_all( tempdir.path() / std::to_string(ordinal) );
+
+         std::cout << std::setw(24) << format.name << std::setw(12) << std::fixed << std::setprecision(2) << write_time.count()
+                   << std::setw(12) << load_time.count()
+                   << std::setw(12) << fc::file_size( path ) / (1024.0 * 1024.0) << std::endl;
+         ++ordinal;
+      }
+   } catch(const fc::exception& e) {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/testing/tester.hpp>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/program_options.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace bpo = boost::program_options;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+/**
+ * Action 0 stores ${ROWS} rows in table 1 of the receiver's scope. Any other action runs db_find_i64 and
+ * db_lowerbound_i64 on each of those rows and then walks the whole table with db_next_i64, which is the access
+ * pattern of a contract looping over a table.
+ */
+static const char table_scan_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_lowerbound_i64" (func $db_lowerbound_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_next_i64" (func $db_next_i64 (param i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $i i64)
+  (local $itr i32)
+  (if (i64.eq (get_local $2) (i64.const 0)) (then
+   (block $done
+    (loop $store
+     (br_if $done (i64.ge_u (get_local $i) (i64.const ${ROWS})))
+     (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (get_local $i) (i32.const 0) (i32.const 8)))
+     (set_local $i (i64.add (get_local $i) (i64.const 1)))
+     (br $store)
+    )
+   )
+   (return)
+  ))
+  (block $found
+   (loop $find
+    (br_if $found (i64.ge_u (get_local $i) (i64.const ${ROWS})))
+    (drop (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (get_local $i)))
+    (drop (call $db_lowerbound_i64 (get_local $0) (get_local $0) (i64.const 1) (get_local $i)))
+    (set_local $i (i64.add (get_local $i) (i64.const 1)))
+    (br $find)
+   )
+  )
+  (set_local $itr (call $db_lowerbound_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 0)))
+  (block $walked
+   (loop $walk
+    (br_if $walked (i32.lt_s (get_local $itr) (i32.const 0)))
+    (set_local $itr (call $db_next_i64 (get_local $itr) (i32.const 16)))
+    (br $walk)
+   )
+  )
+ )
+)
+)=====";
+
+/**
+ * Times the scan action above against a table of a given size: a find and a lower bound per row followed by a
+ * next per row. The per operation figure is what the table and iterator caches of apply_context are meant to keep
+ * low and flat as the number of rows grows.
+ */
+int main(int argc, char** argv) {
+   uint32_t rows = 0;
+   uint32_t iterations = 0;
+
+   bpo::options_description cli("table_lookup_bench command line options");
+   cli.add_options()
+      ("rows", bpo::value<uint32_t>(&rows)->default_value(1000), "number of rows in the scanned table")
+      ("iterations", bpo::value<uint32_t>(&iterations)->default_value(100), "number of scan actions timed")
+      ("help,h", "print this help message and exit");
+
+   bpo::variables_map vmap;
+   bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+   bpo::notify(vmap);
+   if(vmap.count("help")) {
+      cli.print(std::cout);
+      return 0;
+   }
+
+   try {
+      tester chain;
+      const account_name scanner = N(scanner);
+      chain.create_accounts( {scanner} );
+      chain.produce_block();
+
+      std::string wast = table_scan_wast;
+      boost::replace_all(wast, "${ROWS}", std::to_string(rows));
+      chain.set_code(scanner, wast.c_str());
+      chain.produce_block();
+
+      auto push = [&](uint64_t action_num, uint32_t nonce) {
+         signed_transaction trx;
+         action act;
+         act.account = scanner;
+         act.name = name(action_num);
+         act.authorization = vector<permission_level>{{scanner, config::active_name}};
+         act.data = fc::raw::pack(nonce); // keeps the otherwise identical transactions distinct
+         trx.actions.push_back(act);
+         chain.set_transaction_headers(trx);
+         trx.sign(chain.get_private_key(scanner, "active"), chain.control->get_chain_id());
+         return chain.push_transaction(trx);
+      };
+
+      push(0, 0);
+      chain.produce_block();
+
+      fc::microseconds elapsed;
+      for(uint32_t i = 0; i < iterations; ++i) {
+         auto trace = push(1, i);
+         elapsed += trace->action_traces.front().elapsed;
+         if(i % 50 == 49)
+            chain.produce_block();
+      }
+
+      const double per_scan_us = double(elapsed.count()) / iterations;
+      const double operations  = 3.0 * rows;
+      std::cout << std::setw(10) << "rows" << std::setw(14) << "scan us" << std::setw(14) << "ns per op" << std::endl;
+      std::cout << std::setw(10) << rows << std::setw(14) << std::fixed << std::setprecision(2) << per_scan_us
+                << std::setw(14) << per_scan_us * 1000.0 / operations << std::endl;
+   } catch(const fc::exception& e) {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
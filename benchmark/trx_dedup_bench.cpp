@@ -0,0 +1,186 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/transaction_dedup_store.hpp>
+#include <eosio/chain/multi_index_includes.hpp>
+
+#include <chainbase/chainbase.hpp>
+#include <fc/filesystem.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace bpo = boost::program_options;
+using namespace eosio::chain;
+
+/// the transaction_object row the deduplication list used to be kept as in the chain state database
+struct legacy_transaction_object : public chainbase::object<transaction_object_type, legacy_transaction_object> {
+   OBJECT_CTOR(legacy_transaction_object)
+
+   id_type             id;
+   time_point_sec      expiration;
+   transaction_id_type trx_id;
+};
+
+struct by_expiration;
+struct by_trx_id;
+using legacy_transaction_multi_index = chainbase::shared_multi_index_container<
+   legacy_transaction_object,
+   indexed_by<
+      ordered_unique< tag<by_id>, BOOST_MULTI_INDEX_MEMBER(legacy_transaction_object, legacy_transaction_object::id_type, id)>,
+      ordered_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(legacy_transaction_object, transaction_id_type, trx_id)>,
+      ordered_unique< tag<by_expiration>,
+         composite_key< legacy_transaction_object,
+            BOOST_MULTI_INDEX_MEMBER( legacy_transaction_object, time_point_sec, expiration ),
+            BOOST_MULTI_INDEX_MEMBER( legacy_transaction_object, legacy_transaction_object::id_type, id)
+         >
+      >
+   >
+>;
+
+CHAINBASE_SET_INDEX_TYPE(legacy_transaction_object, legacy_transaction_multi_index)
+
+static transaction_id_type make_id( uint64_t n ) {
+   // splitmix64, cheap enough not to be what is measured
+   transaction_id_type id;
+   for( auto& word : id._hash ) {
+      uint64_t z = (n += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      word = z ^ (z >> 31);
+   }
+   return id;
+}
+
+static int64_t heap_in_use() {
+#ifdef __GLIBC__
+   return mallinfo().uordblks;
+#else
+   return -1;
+#endif
+}
+
+/**
+ * Runs the deduplication list through the life it has on a busy chain: two blocks a second each holding half the
+ * given rate of transactions, every transaction recorded in an undo session of its own squashed into its block's,
+ * the expired ones cleared at the start of each block and blocks made irreversible a fixed number of blocks behind
+ * the head. It is run once against the chainbase index the list used to be kept in and once against
+ * transaction_dedup_store, for long enough past the transaction lifetime that expiry runs at the same rate as
+ * insertion.
+ *
+ * Reported are the time per transaction (recording plus its share of expiry and of the undo bookkeeping) and the
+ * memory held at the end: the used part of the chainbase segment, and the growth of the heap for the store (where
+ * the C library can report it).
+ */
+int main(int argc, char** argv) {
+   uint32_t tps = 0;
+   uint32_t lifetime = 0;
+   uint32_t seconds = 0;
+   uint32_t lib_lag = 0;
+   uint64_t state_size = 0;
+
+   bpo::options_description cli("trx_dedup_bench command line options");
+   cli.add_options()
+      ("tps", bpo::value<uint32_t>(&tps)->default_value(10000), "transactions per second")
+      ("lifetime", bpo::value<uint32_t>(&lifetime)->default_value(60), "seconds from inclusion to expiration of each transaction")
+      ("seconds", bpo::value<uint32_t>(&seconds)->default_value(180), "seconds of chain time simulated")
+      ("lib-lag", bpo::value<uint32_t>(&lib_lag)->default_value(325), "blocks between the head and the last irreversible block")
+      ("state-size", bpo::value<uint64_t>(&state_size)->default_value(4ull*1024*1024*1024), "size of the chainbase segment used by the legacy run")
+      ("help,h", "print this help message and exit");
+
+   bpo::variables_map vmap;
+   bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+   bpo::notify(vmap);
+   if(vmap.count("help")) {
+      cli.print(std::cout);
+      return 0;
+   }
+
+   const uint32_t blocks = seconds * 2;
+   const uint32_t per_block = tps / 2;
+   const fc::time_point start_time = fc::time_point( time_point_sec( 1000000 ) );
+
+   auto simulate = [&]( auto&& session, auto&& record, auto&& clear, auto&& commit ) {
+      uint64_t n = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      for( uint32_t b = 1; b <= blocks; ++b ) {
+         const fc::time_point now = start_time + fc::milliseconds( 500 * b );
+         auto block = session();
+         clear( now );
+         for( uint32_t t = 0; t < per_block; ++t, ++n ) {
+            auto trx = session();
+            record( make_id( n ), time_point_sec( now ) + lifetime );
+            trx.squash();
+         }
+         block.push();
+         if( b > lib_lag )
+            commit( b - lib_lag );
+      }
+      auto elapsed = std::chrono::high_resolution_clock::now() - start;
+      return std::chrono::duration<double, std::nano>(elapsed).count() / n;
+   };
+
+   double legacy_ns = 0;
+   uint64_t legacy_bytes = 0;
+   {
+      fc::temp_directory tempdir;
+      chainbase::database db( tempdir.path(), chainbase::database::read_write, state_size );
+      db.add_index<legacy_transaction_multi_index>();
+      const auto free_before = db.get_segment_manager()->get_free_memory();
+
+      legacy_ns = simulate(
+         [&]() { return db.start_undo_session( true ); },
+         [&]( const transaction_id_type& id, time_point_sec expiration ) {
+            db.create<legacy_transaction_object>( [&]( auto& o ) {
+               o.trx_id = id;
+               o.expiration = expiration;
+            });
+         },
+         [&]( fc::time_point now ) {
+            auto& idx = db.get_mutable_index<legacy_transaction_multi_index>();
+            const auto& by_exp = idx.indices().get<by_expiration>();
+            while( !by_exp.empty() && now > fc::time_point( by_exp.begin()->expiration ) )
+               idx.remove( *by_exp.begin() );
+         },
+         [&]( int64_t revision ) { db.commit( revision ); } );
+
+      legacy_bytes = free_before - db.get_segment_manager()->get_free_memory();
+   }
+
+   double store_ns = 0;
+   int64_t store_bytes = 0;
+   transaction_dedup_store::stats store_stats;
+   {
+      const auto heap_before = heap_in_use();
+      transaction_dedup_store store;
+
+      store_ns = simulate(
+         [&]() { return store.start_undo_session( true ); },
+         [&]( const transaction_id_type& id, time_point_sec expiration ) { store.add( id, expiration ); },
+         [&]( fc::time_point now ) { store.clear_expired( now ); },
+         [&]( int64_t revision ) { store.commit( revision ); } );
+
+      store_stats = store.get_stats();
+      store_bytes = heap_before >= 0 ? heap_in_use() - heap_before : -1;
+   }
+
+   std::cout << tps << " tps, " << lifetime << " s lifetime, " << store_stats.transactions << " unexpired transactions, "
+             << store_stats.undo_changes << " reversible changes" << std::endl;
+   std::cout << std::setw(12) << "" << std::setw(14) << "ns per trx" << std::setw(16) << "memory MiB" << std::endl;
+   std::cout << std::setw(12) << "chainbase" << std::setw(14) << std::fixed << std::setprecision(1) << legacy_ns
+             << std::setw(16) << legacy_bytes / (1024.0 * 1024.0) << std::endl;
+   std::cout << std::setw(12) << "bucketed" << std::setw(14) << store_ns;
+   if( store_bytes >= 0 )
+      std::cout << std::setw(16) << store_bytes / (1024.0 * 1024.0) << std::endl;
+   else
+      std::cout << std::setw(16) << "n/a" << std::endl;
+   return 0;
+}
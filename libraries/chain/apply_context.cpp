@@ -8,8 +8,11 @@
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/database_utils.hpp>
 #include <boost/container/flat_set.hpp>
+#include <fc/scoped_exit.hpp>
 
 using boost::container::flat_set;
 
@@ -29,6 +32,60 @@ static inline void print_debug(account_name receiver, const action_trace& ar) {
    }
 }
 
+namespace detail {
+
+   /// what running a contract left behind, compared between the native and WASM runs of differential mode
+   struct contract_run_outcome {
+      int64_t     except_code = 0; ///< 0 when the run completed, -1 when it threw something other than an fc::exception
+      digest_type effects;         ///< notifications, inline actions, RAM deltas and used authorizations
+      digest_type state_changes;   ///< rows created, modified and removed
+      string      console;
+
+      bool operator==( const contract_run_outcome& o )const {
+         return except_code == o.except_code && effects == o.effects
+                && state_changes == o.state_changes && console == o.console;
+      }
+   };
+
+   template<typename Object>
+   void hash_row( digest_type::encoder& enc, const Object& row ) {
+      fc::raw::pack( enc, row.id );
+      fc::raw::pack( enc, row.t_id );
+      fc::raw::pack( enc, row );
+   }
+
+   static void hash_row( digest_type::encoder& enc, const table_id_object& row ) {
+      fc::raw::pack( enc, row.id );
+      fc::raw::pack( enc, row );
+   }
+
+   static void hash_row( digest_type::encoder& enc, const generated_transaction_object& row ) {
+      fc::raw::pack( enc, row.id );
+      fc::raw::pack( enc, row );
+   }
+
+   /// hashes the changes recorded by the innermost undo session of an index
+   template<typename Index>
+   void hash_undo_state( digest_type::encoder& enc, const chainbase::database& db ) {
+      const auto& index = db.get_index<Index>();
+      if( index.stack().empty() ) {
+         fc::raw::pack( enc, uint32_t(0) );
+         return;
+      }
+      const auto& undo = index.stack().back();
+      fc::raw::pack( enc, uint32_t(undo.old_values.size()) );
+      for( const auto& old : undo.old_values )
+         hash_row( enc, index.get( old.first ) );
+      fc::raw::pack( enc, uint32_t(undo.removed_values.size()) );
+      for( const auto& removed : undo.removed_values )
+         fc::raw::pack( enc, removed.first );
+      fc::raw::pack( enc, uint32_t(undo.new_ids.size()) );
+      for( const auto& id : undo.new_ids )
+         hash_row( enc, index.get( id ) );
+   }
+
+} // namespace detail
+
 void apply_context::exec_one( action_trace& trace )
 {
    auto start = fc::time_point::now();
@@ -58,7 +115,7 @@ void apply_context::exec_one( action_trace& trace )
             (*native)( *this );
          }
 
-         if( a.code.size() > 0
+         if( a.code_version != digest_type()
              && !(act.account == config::system_account_name && act.name == N( setcode ) &&
                   receiver == config::system_account_name) ) {
             if( trx_context.enforce_whiteblacklist && control.is_producing_block() ) {
@@ -66,10 +123,10 @@ void apply_context::exec_one( action_trace& trace )
                control.check_action_list( act.account, act.name );
             }
             try {
-               control.get_wasm_interface().apply( a.code_version, a.code, *this );
+               run_contract( a );
             } catch( const wasm_exit& ) {}
          }
-      } FC_RETHROW_EXCEPTIONS( warn, "pending console output: ${console}", ("console", _pending_console_output.str()) )
+      } FC_RETHROW_EXCEPTIONS( warn, "pending console output: ${console}", ("console", get_pending_console_output()) )
    } catch( fc::exception& e ) {
       trace.receipt = r; // fill with known data
       trace.except = e;
@@ -88,9 +145,9 @@ void apply_context::exec_one( action_trace& trace )
       r.auth_sequence[auth.actor] = next_auth_sequence( auth.actor );
    }
 
-   trace.receipt = r;
+   trx_context.executed_action_digests.emplace_back( r.digest() );
 
-   trx_context.executed.emplace_back( move(r) );
+   trace.receipt = move(r);
 
    finalize_trace( trace, start );
 
@@ -104,12 +161,145 @@ void apply_context::finalize_trace( action_trace& trace, const fc::time_point& s
    trace.account_ram_deltas = std::move( _account_ram_deltas );
    _account_ram_deltas.clear();
 
-   trace.console = _pending_console_output.str();
+   trace.console = get_pending_console_output();
    reset_console();
 
    trace.elapsed = fc::time_point::now() - start;
 }
 
+void apply_context::run_contract( const account_object& a ) {
+   const auto& code = db.get<code_object, by_code_hash>( a.code_version );
+   auto& registry = control.get_native_contract_registry();
+   const auto* native = registry.find( code.code_hash );
+   if( !native ) {
+      control.get_wasm_interface().apply( code.code_hash, code.code, *this );
+   } else if( registry.get_mode() == native_contract_registry::mode::enabled ) {
+      (*native)( *this );
+   } else {
+      run_contract_differential( *native, code );
+   }
+}
+
+/// running out of time says nothing about what the contract does, so it is neither an outcome to compare nor to keep
+static bool is_deadline_exception( const fc::exception& e ) {
+   switch( e.code() ) {
+      case deadline_exception::code_value:
+      case tx_cpu_usage_exceeded::code_value:
+      case block_cpu_usage_exceeded::code_value:
+      case leeway_deadline_exception::code_value:
+      case greylist_cpu_usage_exceeded::code_value:
+         return true;
+      default:
+         return false;
+   }
+}
+
+void apply_context::run_contract_differential( const native_contract_registry::native_apply& native, const code_object& code ) {
+   detail::contract_run_outcome native_outcome;
+   {
+      // the native run gets a context of its own seeded from this one, and an undo session that discards its writes
+      apply_context native_context( control, trx_context, act, recurse_depth );
+      native_context.receiver            = receiver;
+      native_context.context_free        = context_free;
+      native_context.privileged          = privileged;
+      native_context.used_authorizations = used_authorizations;
+      native_context._notified           = _notified;
+      native_context._inline_actions     = _inline_actions;
+      native_context._cfa_inline_actions = _cfa_inline_actions;
+      native_context._account_ram_deltas = _account_ram_deltas;
+      if( _pending_console_output )
+         native_context.get_console_stream() << _pending_console_output->str();
+
+      // what the transaction keeps outside of the database is put back as well, and the run is not billed
+      const uint64_t net_usage      = trx_context.net_usage;
+      const auto validate_ram_usage = trx_context.validate_ram_usage;
+      trx_context.pause_billing_timer();
+      auto restore = fc::make_scoped_exit([&]() {
+         trx_context.net_usage          = net_usage;
+         trx_context.validate_ram_usage = validate_ram_usage;
+         trx_context.resume_billing_timer();
+      });
+
+      auto native_session = db.start_undo_session( true );
+      int64_t except_code = 0;
+      try {
+         try {
+            native( native_context );
+         } catch( const wasm_exit& ) {}
+      } catch( const fc::exception& e ) {
+         if( is_deadline_exception( e ) )
+            throw;
+         except_code = e.code();
+      } catch( ... ) {
+         except_code = -1;
+      }
+      native_context.capture_outcome( native_outcome, except_code );
+      native_session.undo();
+      // undo puts back what the native run removed as new objects, so what this context cached of them is stale
+      clear_table_caches();
+   }
+
+   auto compare = [&]( const detail::contract_run_outcome& wasm_outcome ) {
+      if( native_outcome == wasm_outcome )
+         return;
+      control.get_native_contract_registry().record_mismatch();
+      elog( "native implementation of code ${code} diverged from its WASM code on ${account}::${action} for ${receiver}: "
+            "native (except ${ne}, effects ${nf}, state ${ns}, console \"${nc}\") "
+            "wasm (except ${we}, effects ${wf}, state ${ws}, console \"${wc}\")",
+            ("code", code.code_hash)("account", act.account)("action", act.name)("receiver", receiver)
+            ("ne", native_outcome.except_code)("nf", native_outcome.effects)
+            ("ns", native_outcome.state_changes)("nc", native_outcome.console)
+            ("we", wasm_outcome.except_code)("wf", wasm_outcome.effects)
+            ("ws", wasm_outcome.state_changes)("wc", wasm_outcome.console) );
+   };
+
+   detail::contract_run_outcome wasm_outcome;
+   auto wasm_session = db.start_undo_session( true );
+   try {
+      try {
+         control.get_wasm_interface().apply( code.code_hash, code.code, *this );
+      } catch( const wasm_exit& ) {}
+   } catch( const fc::exception& e ) {
+      if( !is_deadline_exception( e ) ) {
+         capture_outcome( wasm_outcome, e.code() );
+         compare( wasm_outcome );
+      }
+      throw;
+   } catch( ... ) {
+      capture_outcome( wasm_outcome, -1 );
+      compare( wasm_outcome );
+      throw;
+   }
+   capture_outcome( wasm_outcome, 0 );
+   wasm_session.squash();
+   compare( wasm_outcome );
+}
+
+void apply_context::capture_outcome( detail::contract_run_outcome& outcome, int64_t except_code )const {
+   outcome.except_code = except_code;
+
+   digest_type::encoder effects;
+   fc::raw::pack( effects, vector<account_name>( _notified.begin(), _notified.end() ) );
+   fc::raw::pack( effects, _inline_actions );
+   fc::raw::pack( effects, _cfa_inline_actions );
+   fc::raw::pack( effects, _account_ram_deltas );
+   fc::raw::pack( effects, vector<uint8_t>( used_authorizations.begin(), used_authorizations.end() ) );
+   outcome.effects = effects.result();
+
+   digest_type::encoder state;
+   detail::hash_undo_state<table_id_multi_index>( state, db );
+   detail::hash_undo_state<key_value_index>( state, db );
+   detail::hash_undo_state<index64_index>( state, db );
+   detail::hash_undo_state<index128_index>( state, db );
+   detail::hash_undo_state<index256_index>( state, db );
+   detail::hash_undo_state<index_double_index>( state, db );
+   detail::hash_undo_state<index_long_double_index>( state, db );
+   detail::hash_undo_state<generated_transaction_multi_index>( state, db );
+   outcome.state_changes = state.result();
+
+   outcome.console = get_pending_console_output();
+}
+
 void apply_context::exec( action_trace& trace )
 {
    _notified.push_back(receiver);
@@ -123,6 +313,8 @@ void apply_context::exec( action_trace& trace )
    if( _cfa_inline_actions.size() > 0 || _inline_actions.size() > 0 ) {
       EOS_ASSERT( recurse_depth < control.get_global_properties().configuration.max_inline_action_depth,
                   transaction_exception, "max inline action depth per transaction reached" );
+      // grow once up front instead of moving the traces already written each time the vector reallocates
+      trace.inline_traces.reserve( trace.inline_traces.size() + _cfa_inline_actions.size() + _inline_actions.size() );
    }
 
    for( const auto& inline_action : _cfa_inline_actions ) {
@@ -238,9 +430,12 @@ void apply_context::execute_inline( action&& a ) {
 
    // No need to check authorization if replaying irreversible blocks or contract is privileged
    if( !control.skip_auth_check() && !privileged ) {
+      // check_authorization takes a list of actions, lend it the action rather than copying it and its data
+      vector<action> checked_actions;
+      checked_actions.emplace_back( move(a) );
       try {
          control.get_authorization_manager()
-                .check_authorization( {a},
+                .check_authorization( checked_actions,
                                       {},
                                       {{receiver, config::eosio_code_name}},
                                       control.pending_block_time() - trx_context.published,
@@ -269,6 +464,7 @@ void apply_context::execute_inline( action&& a ) {
             EOS_THROW(subjective_block_production_exception, "Unexpected exception occurred validating inline action sent to self");
          }
       }
+      a = move( checked_actions.front() );
    }
 
    _inline_actions.emplace_back( move(a) );
@@ -410,30 +606,77 @@ bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, acc
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
-   return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   if( auto* cached = find_cached_table_id( code, scope, table ) )
+      return cached->tid;
+   const auto* tid = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   cache_table_id( code, scope, table, tid );
+   return tid;
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
-   const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   auto* cached = find_cached_table_id( code, scope, table );
+   if( cached && cached->tid )
+      return *cached->tid;
+
+   const auto* existing_tid = cached ? nullptr : db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
    if (existing_tid != nullptr) {
+      cache_table_id( code, scope, table, existing_tid );
       return *existing_tid;
    }
 
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-   return db.create<table_id_object>([&](table_id_object &t_id){
+   const auto& created = db.create<table_id_object>([&](table_id_object &t_id){
       t_id.code = code;
       t_id.scope = scope;
       t_id.table = table;
       t_id.payer = payer;
    });
+   cache_table_id( code, scope, table, &created );
+   return created;
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
+   if( auto* cached = find_cached_table_id( tid.code, tid.scope, tid.table ) )
+      cached->tid = nullptr;
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
    db.remove(tid);
 }
 
+/**
+ *  Tables only come and go through find_or_create_table and remove_table, both of which keep the cache in step, and
+ *  chainbase does not move an object while it exists, so a cached pointer (or the absence of one) stays valid for as
+ *  long as this context lives, unless an undo session puts back objects removed under it (see clear_table_caches).
+ *  The cache is scanned linearly and bounded; an action touching more tables than that simply falls back to the
+ *  database for the remainder.
+ */
+apply_context::cached_table_id* apply_context::find_cached_table_id( name code, name scope, name table ) {
+   for( auto& c : _table_id_cache ) {
+      if( c.table == table && c.scope == scope && c.code == code )
+         return &c;
+   }
+   return nullptr;
+}
+
+void apply_context::cache_table_id( name code, name scope, name table, const table_id_object* tid ) {
+   if( auto* cached = find_cached_table_id( code, scope, table ) ) {
+      cached->tid = tid;
+      return;
+   }
+   if( _table_id_cache.size() < config::max_cached_table_ids_per_action )
+      _table_id_cache.push_back( cached_table_id{code, scope, table, tid} );
+}
+
+void apply_context::clear_table_caches() {
+   _table_id_cache.clear();
+   keyval_cache = iterator_cache<key_value_object>();
+   idx64.clear_cache();
+   idx128.clear_cache();
+   idx256.clear_cache();
+   idx_double.clear_cache();
+   idx_long_double.clear_cache();
+}
+
 vector<account_name> apply_context::get_active_producers() const {
    const auto& ap = control.active_producers();
    vector<account_name> accounts; accounts.reserve( ap.producers.size() );
@@ -445,8 +688,23 @@ vector<account_name> apply_context::get_active_producers() const {
 }
 
 void apply_context::reset_console() {
-   _pending_console_output = std::ostringstream();
-   _pending_console_output.setf( std::ios::scientific, std::ios::floatfield );
+   _pending_console_output.reset();
+}
+
+/**
+ *  The console intrinsics print nothing unless contracts-console is enabled, so on most nodes the stream is never
+ *  built at all and an action's console output is simply empty.
+ */
+std::ostringstream& apply_context::get_console_stream() {
+   if( !_pending_console_output ) {
+      _pending_console_output.reset( new std::ostringstream() );
+      _pending_console_output->setf( std::ios::scientific, std::ios::floatfield );
+   }
+   return *_pending_console_output;
+}
+
+string apply_context::get_pending_console_output()const {
+   return _pending_console_output ? _pending_console_output->str() : string();
 }
 
 bytes apply_context::get_packed_transaction() {
@@ -13,6 +13,11 @@
 #include <eosio/chain/contract_types.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <boost/tuple/tuple_io.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <iterator>
 #include <eosio/chain/database_utils.hpp>
 
 
@@ -24,11 +29,65 @@ namespace eosio { namespace chain {
       permission_link_index
    >;
 
+   namespace detail {
+      /**
+       * A permission that was found to be satisfied by a set of keys under a delay, while the permission table had the
+       * given permission_version_object label. Only satisfied results are kept.
+       */
+      struct satisfied_authority {
+         permission_level              level;
+         fc::microseconds              delay;
+         uint16_t                      max_depth = 0;
+         uint64_t                      permission_version = 0;
+         flat_set<public_key_type>     provided_keys;
+         flat_set<public_key_type>     used_keys;
+      };
+
+      struct permission_level_hash {
+         size_t operator()( const permission_level& level )const {
+            size_t seed = 0;
+            boost::hash_combine( seed, level.actor.value );
+            boost::hash_combine( seed, level.permission.value );
+            return seed;
+         }
+      };
+
+      struct by_level;
+
+      /**
+       * Bounded, least recently used first, cache of satisfied_authority. An entry is only used while the permission
+       * table still has the label it was cached under. As undo restores the label together with the permissions, an
+       * entry cached before a change that is undone becomes usable again, and one cached after it never is.
+       */
+      struct satisfied_authority_cache {
+         static const size_t max_entries = 16 * 1024;
+
+         typedef bmi::multi_index_container<
+            satisfied_authority,
+            indexed_by<
+               bmi::sequenced<>,
+               bmi::hashed_non_unique< tag<by_level>,
+                  member<satisfied_authority, permission_level, &satisfied_authority::level>,
+                  permission_level_hash
+               >
+            >
+         > index_type;
+
+         index_type  entries;
+         uint64_t    hits = 0;
+         uint64_t    misses = 0;
+      };
+   }
+
    authorization_manager::authorization_manager(controller& c, database& d)
-   :_control(c),_db(d){}
+   :_control(c),_db(d),_satisfied_cache(new detail::satisfied_authority_cache()){}
+
+   authorization_manager::~authorization_manager() {}
 
    void authorization_manager::add_indices() {
       authorization_index_set::add_indices(_db);
+      // not in authorization_index_set, which is what snapshots and the integrity hash cover
+      _db.add_index<permission_version_index>();
    }
 
    void authorization_manager::initialize_database() {
@@ -105,8 +164,9 @@ namespace eosio { namespace chain {
             return;
          }
 
-         snapshot->write_section<section_t>([this]( auto& section ){
-            decltype(utils)::walk(_db, [this, &section]( const auto &row ) {
+         const auto parts = decltype(utils)::part_count(_db, config::snapshot_rows_per_part);
+         snapshot->write_section_parts<section_t>(parts, [this, parts]( uint32_t part, auto& section ){
+            decltype(utils)::walk_part(_db, part, parts, [this, &section]( const auto &row ) {
                section.add_row(row, _db);
             });
          });
@@ -157,6 +217,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = auth;
       });
+      bump_permission_version();
       return perm;
    }
 
@@ -184,6 +245,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = std::move(auth);
       });
+      bump_permission_version();
       return perm;
    }
 
@@ -192,6 +254,7 @@ namespace eosio { namespace chain {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
       });
+      bump_permission_version();
    }
 
    void authorization_manager::remove_permission( const permission_object& permission ) {
@@ -202,6 +265,7 @@ namespace eosio { namespace chain {
 
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
+      bump_permission_version();
    }
 
    void authorization_manager::update_permission_usage( const permission_object& permission ) {
@@ -425,6 +489,89 @@ namespace eosio { namespace chain {
 
    std::function<void()> authorization_manager::_noop_checktime{&noop_checktime};
 
+   uint64_t authorization_manager::permission_version()const {
+      const auto* v = _db.find<permission_version_object>();
+      return v ? v->version : 0;
+   }
+
+   void authorization_manager::bump_permission_version() {
+      // a label restored by undo was issued before, a new one has to differ from all of them
+      _permission_versions_issued = std::max( _permission_versions_issued, permission_version() ) + 1;
+      const auto* v = _db.find<permission_version_object>();
+      if( v ) {
+         _db.modify( *v, [&]( permission_version_object& o ) {
+            o.version = _permission_versions_issued;
+         });
+      } else {
+         _db.create<permission_version_object>( [&]( permission_version_object& o ) {
+            o.version = _permission_versions_issued;
+         });
+      }
+   }
+
+   /**
+    *  Whether the permission at level is satisfied by provided_keys under provided_delay, adding the keys it used to
+    *  used_keys. Answers from the satisfied authority cache when an entry for the same inputs is still valid, otherwise
+    *  runs an authority_checker of its own and caches a satisfied result.
+    */
+   bool authorization_manager::check_satisfied( const permission_level& level,
+                                                fc::microseconds provided_delay,
+                                                const flat_set<public_key_type>& provided_keys,
+                                                const std::function<void()>& checktime,
+                                                flat_set<public_key_type>& used_keys )const
+   {
+      auto& cache = *_satisfied_cache;
+      const uint16_t max_depth = _control.get_global_properties().configuration.max_authority_depth;
+      const uint64_t version = permission_version();
+
+      auto& by_level_idx = cache.entries.get<detail::by_level>();
+      auto range = by_level_idx.equal_range( level );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         if( itr->permission_version != version || itr->delay != provided_delay || itr->max_depth != max_depth
+             || itr->provided_keys != provided_keys )
+            continue;
+
+         ++cache.hits;
+         used_keys.insert( itr->used_keys.begin(), itr->used_keys.end() );
+         cache.entries.relocate( cache.entries.end(), cache.entries.project<0>( itr ) );
+         return true;
+      }
+      ++cache.misses;
+
+      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+                                        max_depth,
+                                        provided_keys,
+                                        {},
+                                        provided_delay,
+                                        checktime
+                                      );
+
+      if( !checker.satisfied( level ) )
+         return false;
+
+      detail::satisfied_authority entry;
+      entry.level              = level;
+      entry.delay              = provided_delay;
+      entry.max_depth          = max_depth;
+      entry.permission_version = version;
+      entry.provided_keys      = provided_keys;
+      entry.used_keys          = checker.used_keys();
+      used_keys.insert( entry.used_keys.begin(), entry.used_keys.end() );
+
+      cache.entries.emplace_back( std::move( entry ) );
+      while( cache.entries.size() > detail::satisfied_authority_cache::max_entries )
+         cache.entries.pop_front();
+      return true;
+   }
+
+   authorization_manager::satisfied_cache_stats authorization_manager::get_satisfied_cache_stats()const {
+      satisfied_cache_stats s;
+      s.entries = _satisfied_cache->entries.size();
+      s.hits    = _satisfied_cache->hits;
+      s.misses  = _satisfied_cache->misses;
+      return s;
+   }
+
    void
    authorization_manager::check_authorization( const vector<action>&                actions,
                                                const flat_set<public_key_type>&     provided_keys,
@@ -505,9 +652,15 @@ namespace eosio { namespace chain {
       // for checking the set of declared authorizations.
       // The permission_levels are traversed in ascending order, which is:
       // ascending order of the actor name with ties broken by ascending order of the permission name.
+      // the satisfied authority cache does not know about provided permissions, those checks always run in full
+      const bool use_satisfied_cache = provided_permissions.empty();
+      flat_set<public_key_type> used_keys;
+
       for( const auto& p : permissions_to_satisfy ) {
          checktime(); // TODO: this should eventually move into authority_checker instead
-         EOS_ASSERT( checker.satisfied( p.first, p.second ), unsatisfied_authorization,
+         EOS_ASSERT( use_satisfied_cache ? check_satisfied( p.first, p.second, provided_keys, checktime, used_keys )
+                                         : checker.satisfied( p.first, p.second ),
+                     unsatisfied_authorization,
                      "transaction declares authority '${auth}', "
                      "but does not have signatures for it under a provided delay of ${provided_delay} ms, "
                      "provided permissions ${provided_permissions}, provided keys ${provided_keys}, "
@@ -522,9 +675,19 @@ namespace eosio { namespace chain {
       }
 
       if( !allow_unused_keys ) {
-         EOS_ASSERT( checker.all_keys_used(), tx_irrelevant_sig,
-                     "transaction bears irrelevant signatures from these keys: ${keys}",
-                     ("keys", checker.unused_keys()) );
+         if( use_satisfied_cache ) {
+            if( used_keys.size() != provided_keys.size() ) {
+               flat_set<public_key_type> unused_keys;
+               std::set_difference( provided_keys.begin(), provided_keys.end(), used_keys.begin(), used_keys.end(),
+                                    std::inserter( unused_keys, unused_keys.end() ) );
+               EOS_THROW( tx_irrelevant_sig, "transaction bears irrelevant signatures from these keys: ${keys}",
+                          ("keys", unused_keys) );
+            }
+         } else {
+            EOS_ASSERT( checker.all_keys_used(), tx_irrelevant_sig,
+                        "transaction bears irrelevant signatures from these keys: ${keys}",
+                        ("keys", checker.unused_keys()) );
+         }
       }
    }
 
@@ -10,9 +10,9 @@ namespace eosio { namespace chain {
    }
 
    producer_key block_header_state::get_scheduled_producer( block_timestamp_type t )const {
-      auto index = t.slot % (active_schedule.producers.size() * config::producer_repetitions);
+      auto index = t.slot % (active_schedule->producers.size() * config::producer_repetitions);
       index /= config::producer_repetitions;
-      return active_schedule.producers[index];
+      return active_schedule->producers[index];
    }
 
    uint32_t block_header_state::calc_dpos_last_irreversible()const {
@@ -43,7 +43,7 @@ namespace eosio { namespace chain {
     }
     result.header.timestamp                                = when;
     result.header.previous                                 = id;
-    result.header.schedule_version                         = active_schedule.version;
+    result.header.schedule_version                         = active_schedule->version;
                                                            
     auto prokey                                            = get_scheduled_producer(when);
     result.block_signing_key                               = prokey.block_signing_key;
@@ -70,7 +70,7 @@ namespace eosio { namespace chain {
     static_assert(std::numeric_limits<uint8_t>::max() >= (config::max_producers * 2 / 3) + 1, "8bit confirmations may not be able to hold all of the needed confirmations");
 
     // This uses the previous block active_schedule because thats the "schedule" that signs and therefore confirms _this_ block
-    auto num_active_producers = active_schedule.producers.size();
+    auto num_active_producers = active_schedule->producers.size();
     uint32_t required_confs = (uint32_t)(num_active_producers * 2 / 3) + 1;
 
     if( confirm_count.size() < config::maximum_tracked_dpos_confirmations ) {
@@ -88,13 +88,14 @@ namespace eosio { namespace chain {
   } /// generate_next
 
    bool block_header_state::maybe_promote_pending() {
-      if( pending_schedule.producers.size() &&
+      if( pending_schedule->producers.size() &&
           dpos_irreversible_blocknum >= pending_schedule_lib_num )
       {
-         active_schedule = move( pending_schedule );
+         active_schedule = pending_schedule;
+         pending_schedule = producer_schedule_type{ pending_schedule->version, {} };
 
          flat_map<account_name,uint32_t> new_producer_to_last_produced;
-         for( const auto& pro : active_schedule.producers ) {
+         for( const auto& pro : active_schedule->producers ) {
             auto existing = producer_to_last_produced.find( pro.producer_name );
             if( existing != producer_to_last_produced.end() ) {
                new_producer_to_last_produced[pro.producer_name] = existing->second;
@@ -104,7 +105,7 @@ namespace eosio { namespace chain {
          }
 
          flat_map<account_name,uint32_t> new_producer_to_last_implied_irb;
-         for( const auto& pro : active_schedule.producers ) {
+         for( const auto& pro : active_schedule->producers ) {
             auto existing = producer_to_last_implied_irb.find( pro.producer_name );
             if( existing != producer_to_last_implied_irb.end() ) {
                new_producer_to_last_implied_irb[pro.producer_name] = existing->second;
@@ -113,9 +114,9 @@ namespace eosio { namespace chain {
             }
          }
 
+         new_producer_to_last_produced[header.producer] = block_num;
          producer_to_last_produced = move( new_producer_to_last_produced );
          producer_to_last_implied_irb = move( new_producer_to_last_implied_irb);
-         producer_to_last_produced[header.producer] = block_num;
 
          return true;
       }
@@ -123,8 +124,8 @@ namespace eosio { namespace chain {
    }
 
   void block_header_state::set_new_producers( producer_schedule_type pending ) {
-      EOS_ASSERT( pending.version == active_schedule.version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
-      EOS_ASSERT( pending_schedule.producers.size() == 0, producer_schedule_exception,
+      EOS_ASSERT( pending.version == active_schedule->version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
+      EOS_ASSERT( pending_schedule->producers.size() == 0, producer_schedule_exception,
                  "cannot set new pending producers until last pending is confirmed" );
       header.new_producers     = move(pending);
       pending_schedule_hash    = digest_type::hash( *header.new_producers );
@@ -242,7 +243,7 @@ namespace eosio { namespace chain {
      for( const auto& c : confirmations )
         EOS_ASSERT( c.producer != conf.producer, producer_double_confirm, "block already confirmed by this producer" );
 
-     auto key = active_schedule.get_producer_key( conf.producer );
+     auto key = active_schedule->get_producer_key( conf.producer );
      EOS_ASSERT( key != public_key_type(), producer_not_in_schedule, "producer not in current schedule" );
      auto signer = fc::crypto::public_key( conf.producer_signature, sig_digest(), true );
      EOS_ASSERT( signer == key, wrong_signing_key, "confirmation not signed by expected key" );
@@ -4,9 +4,25 @@
  */
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/compression.hpp>
 #include <fstream>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <thread>
 #include <fc/io/raw.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 #define LOG_RW ( std::ios::in | std::ios::out | std::ios::binary )
@@ -20,22 +36,163 @@ namespace eosio { namespace chain {
     * Version 1: complete block log from genesis
     * Version 2: adds optional partial block log, cannot be used for replay without snapshot
     *            this is in the form of an first_block_num that is written immediately after the version
+    * Version 3: each block is zlib compressed and stored as a packed byte vector, only ever used for compressed
+    *            retained files of a block log split by stride, never for blocks.log itself
     */
    const uint32_t block_log::max_supported_version = 2;
 
    namespace detail {
+      /// version of retained files written with retained file compression, never that of blocks.log
+      const uint32_t compressed_log_version = 3;
+
+      /**
+       * A read only mapping of a block log file and its index as they were when it was made, always at the boundary of
+       * an appended block.
+       */
+      struct block_log_mapping {
+         block_log_mapping( const fc::path& block_file, const fc::path& index_file, uint32_t first_block_num );
+
+         uint64_t block_count()const { return index_size / sizeof(uint64_t); }
+
+         bool holds( uint32_t block_num )const {
+            return block_num >= first_block_num && block_num - first_block_num < block_count();
+         }
+
+         uint64_t block_pos( uint64_t index )const {
+            uint64_t pos;
+            memcpy( &pos, index_data + index * sizeof(uint64_t), sizeof(pos) );
+            return pos;
+         }
+
+         /// the bytes of the block at index, without the position that follows each block
+         std::pair<const char*, uint64_t> block_entry( uint64_t index )const {
+            const uint64_t pos = block_pos( index );
+            const uint64_t end = ( index + 1 < block_count() ? block_pos( index + 1 ) : block_size ) - sizeof(uint64_t);
+            EOS_ASSERT( pos < end && end <= block_size, block_log_exception,
+                        "Block log index entry of block ${n} is out of range", ("n", first_block_num + index)("pos", pos)("end", end) );
+            return { block_data + pos, end - pos };
+         }
+
+         uint32_t version()const {
+            uint32_t v = 0;
+            if( block_size >= sizeof(v) )
+               memcpy( &v, block_data, sizeof(v) );
+            return v;
+         }
+
+         boost::interprocess::file_mapping  block_mapping;
+         boost::interprocess::mapped_region block_region;
+         boost::interprocess::file_mapping  index_mapping;
+         boost::interprocess::mapped_region index_region;
+
+         uint32_t    first_block_num = 0;
+         const char* block_data = nullptr;
+         uint64_t    block_size = 0;
+         const char* index_data = nullptr;
+         uint64_t    index_size = 0;
+      };
+
+      block_log_mapping::block_log_mapping( const fc::path& block_file, const fc::path& index_file, uint32_t first_block_num )
+      :first_block_num( first_block_num )
+      {
+         using namespace boost::interprocess;
+
+         block_size = fc::file_size( block_file );
+         if( block_size ) {
+            block_mapping = file_mapping( block_file.generic_string().c_str(), read_only );
+            block_region  = mapped_region( block_mapping, read_only, 0, block_size );
+            block_data    = static_cast<const char*>( block_region.get_address() );
+         }
+
+         index_size = fc::file_size( index_file );
+         if( index_size ) {
+            index_mapping = file_mapping( index_file.generic_string().c_str(), read_only );
+            index_region  = mapped_region( index_mapping, read_only, 0, index_size );
+            index_data    = static_cast<const char*>( index_region.get_address() );
+         }
+      }
+
+      /// a file the blocks [first_block_num, last_block_num] were moved to when blocks.log reached the stride
+      struct retained_block_file {
+         uint32_t                                 first_block_num = 0;
+         uint32_t                                 last_block_num = 0;
+         fc::path                                 block_file;
+         fc::path                                 index_file;
+         std::shared_ptr<const block_log_mapping> mapping;
+      };
+      using retained_block_files = vector<retained_block_file>;
+
+      static std::string retained_file_name( uint32_t first_block_num, uint32_t last_block_num ) {
+         return "blocks-" + std::to_string( first_block_num ) + "-" + std::to_string( last_block_num );
+      }
+
+      /// the path a file is written under before it is renamed to its own
+      static fc::path temp_file( const fc::path& p ) {
+         return fc::path( p.generic_string() + ".tmp" );
+      }
+
+      /// flushes a file, or the entries of a directory, to the disk
+      static void sync_file( const fc::path& p ) {
+         const int fd = ::open( p.generic_string().c_str(), O_RDONLY );
+         EOS_ASSERT( fd >= 0, block_log_exception, "Unable to open ${p} to flush it to disk", ("p", p.generic_string()) );
+         const int r = ::fsync( fd );
+         ::close( fd );
+         EOS_ASSERT( r == 0, block_log_exception, "Unable to flush ${p} to disk", ("p", p.generic_string()) );
+      }
+
+      /// @return false if file_name is not that of a retained block log file
+      static bool parse_retained_file_name( const std::string& file_name, uint32_t& first_block_num, uint32_t& last_block_num ) {
+         const std::string prefix = "blocks-", suffix = ".log";
+         if( file_name.size() <= prefix.size() + suffix.size() || file_name.compare( 0, prefix.size(), prefix ) != 0 ||
+             file_name.compare( file_name.size() - suffix.size(), suffix.size(), suffix ) != 0 )
+            return false;
+         const std::string range = file_name.substr( prefix.size(), file_name.size() - prefix.size() - suffix.size() );
+         const auto dash = range.find( '-' );
+         if( dash == std::string::npos || dash == 0 || dash + 1 == range.size() ||
+             range.find_first_not_of( "0123456789-" ) != std::string::npos || range.find( '-', dash + 1 ) != std::string::npos )
+            return false;
+         first_block_num = std::stoul( range.substr( 0, dash ) );
+         last_block_num  = std::stoul( range.substr( dash + 1 ) );
+         return first_block_num > 0 && first_block_num <= last_block_num;
+      }
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
             block_id_type            head_id;
             std::fstream             block_stream;
             std::fstream             index_stream;
+            fc::path                 data_dir;
             fc::path                 block_file;
             fc::path                 index_file;
+            fc::path                 next_block_file; ///< blocks.log starting over, while blocks.log is retained
             bool                     open_files = false;
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
-            uint32_t                 first_block_num = 0;
+            std::atomic<uint32_t>    first_block_num{0}; ///< of blocks.log, changed by the writer thread when blocks.log is retained
+            bytes                    genesis_data; ///< the packed genesis_state of the header, repeated in each file
+            block_log_config         config;
+            std::mutex               mtx; ///< serializes use of the streams and the remapping of the files
+
+            std::shared_ptr<const block_log_mapping>    mapping;  ///< only accessed through std::atomic_load/atomic_store
+            std::shared_ptr<const retained_block_files> retained; ///< oldest first, only accessed through std::atomic_load/atomic_store
+            std::mutex               retained_mtx; ///< serializes changes to the retained files and to their list, after mtx
+            std::future<void>        compression; ///< compresses retained files in the background, one batch at a time
+            std::atomic<uint32_t>    readable_head_num{0}; ///< the last block flushed to the files, readable through a mapping
+
+            /// a block appended but not yet flushed to the files by the writer thread
+            struct pending_block {
+               uint32_t                     block_num = 0;
+               std::shared_ptr<const bytes> data;
+            };
+
+            std::thread                 writer; ///< only running when config.write_queue_size is not 0
+            std::mutex                  queue_mtx; ///< guards the members below
+            std::condition_variable     queue_cv; ///< signalled when a block is queued or the writer is to stop
+            std::condition_variable     written_cv; ///< signalled when the writer has flushed a batch or failed
+            std::deque<pending_block>   queue; ///< consecutive blocks, oldest first, each kept until it is readable from the files
+            bool                        stop_writer = false;
+            std::exception_ptr          writer_error;
 
             inline void check_open_files() {
                if( !open_files ) {
@@ -44,12 +201,49 @@ namespace eosio { namespace chain {
             }
             void reopen();
 
+            std::pair<signed_block_ptr, uint64_t> read_block(uint64_t pos);
+
+            template<typename Covers>
+            std::shared_ptr<const block_log_mapping> get_mapping( Covers&& covers );
+            uint64_t get_block_pos( uint32_t block_num );
+            serialized_block_view read_serialized_block( uint32_t block_num );
+            serialized_block_view read_retained_block( uint32_t block_num );
+
+            void write_header();
+            void finish_header();
+            uint64_t recover_tail( uint64_t header_end, uint64_t log_size );
+
+            uint64_t write_block( uint32_t block_num, const bytes& data );
+            void flush_files() {
+               block_stream.flush();
+               index_stream.flush();
+            }
+
+            void start_writer();
+            void run_writer();
+            void stop_writing();
+            void enqueue( uint32_t block_num, std::shared_ptr<const bytes> data );
+            void wait_for_writer();
+            serialized_block_view read_pending_block( uint32_t block_num );
+
+            void open_retained_files();
+            void retain_blocks_log( uint32_t next_block_num );
+            void apply_retention( retained_block_files& files );
+            void remove_retained_files( uint32_t next_block_num );
+            void compress_retained_files( retained_block_files files );
+            void compress_retained_file( const retained_block_file& f );
+            void wait_for_compression() {
+               if( compression.valid() )
+                  compression.get();
+            }
+
             void close() {
                if( block_stream.is_open() )
                   block_stream.close();
                if( index_stream.is_open() )
                   index_stream.close();
                open_files = false;
+               std::atomic_store( &mapping, std::shared_ptr<const block_log_mapping>() );
             }
       };
 
@@ -68,13 +262,546 @@ namespace eosio { namespace chain {
 
          open_files = true;
       }
+
+      std::pair<signed_block_ptr, uint64_t> block_log_impl::read_block(uint64_t pos) {
+         check_open_files();
+
+         block_stream.seekg(pos);
+         std::pair<signed_block_ptr,uint64_t> result;
+         result.first = std::make_shared<signed_block>();
+         fc::raw::unpack(block_stream, *result.first);
+         result.second = uint64_t(block_stream.tellg()) + 8;
+         return result;
+      }
+
+      template<typename Covers>
+      std::shared_ptr<const block_log_mapping> block_log_impl::get_mapping( Covers&& covers ) {
+         auto m = std::atomic_load( &mapping );
+         if( m && covers( *m ) )
+            return m;
+
+         // appends hold the lock until both files are flushed, so a mapping made under it ends at a block boundary
+         std::lock_guard<std::mutex> g( mtx );
+         m = std::atomic_load( &mapping );
+         if( !m || !covers( *m ) ) {
+            check_open_files();
+            m = std::make_shared<const block_log_mapping>( block_file, index_file, first_block_num );
+            std::atomic_store( &mapping, m );
+         }
+         return m;
+      }
+
+      uint64_t block_log_impl::get_block_pos( uint32_t block_num ) {
+         if( block_num > readable_head_num.load() ) {
+            // a queued block has no position until the writer has written it
+            wait_for_writer();
+            if( block_num > readable_head_num.load() )
+               return block_log::npos;
+         }
+         auto m = get_mapping( [block_num]( const block_log_mapping& mapped ) {
+            return block_num < mapped.first_block_num || mapped.holds( block_num );
+         } );
+         return m->holds( block_num ) ? m->block_pos( block_num - m->first_block_num ) : block_log::npos;
+      }
+
+      serialized_block_view block_log_impl::read_serialized_block( uint32_t block_num ) {
+         serialized_block_view view;
+         if( block_num > readable_head_num.load() ) {
+            view = read_pending_block( block_num );
+            // the writer makes a block readable from the files before it takes it off the queue
+            if( view || block_num > readable_head_num.load() )
+               return view;
+         }
+         // the mapping knows the first block of the file it maps, which changes whenever blocks.log is retained
+         auto m = get_mapping( [block_num]( const block_log_mapping& mapped ) {
+            return block_num < mapped.first_block_num || mapped.holds( block_num );
+         } );
+         if( block_num < m->first_block_num )
+            return read_retained_block( block_num );
+         if( !m->holds( block_num ) )
+            return view;
+
+         std::tie( view._data, view._size ) = m->block_entry( block_num - m->first_block_num );
+         view._owner = std::move( m );
+         return view;
+      }
+
+      serialized_block_view block_log_impl::read_retained_block( uint32_t block_num ) {
+         serialized_block_view view;
+         auto files = std::atomic_load( &retained );
+         if( !files )
+            return view;
+         auto itr = std::upper_bound( files->begin(), files->end(), block_num, []( uint32_t n, const retained_block_file& f ) {
+            return n < f.first_block_num;
+         } );
+         if( itr == files->begin() )
+            return view;
+         --itr;
+         if( block_num > itr->last_block_num || !itr->mapping->holds( block_num ) )
+            return view;
+
+         auto entry = itr->mapping->block_entry( block_num - itr->first_block_num );
+         if( itr->mapping->version() != compressed_log_version ) {
+            std::tie( view._data, view._size ) = entry;
+            view._owner = itr->mapping;
+         } else {
+            fc::datastream<const char*> ds( entry.first, entry.second );
+            bytes compressed;
+            fc::raw::unpack( ds, compressed );
+            auto block = std::make_shared<const bytes>( zlib_decompress( compressed.data(), compressed.size() ) );
+            view._data  = block->data();
+            view._size  = block->size();
+            view._owner = std::move( block );
+         }
+         return view;
+      }
+
+      void block_log_impl::write_header() {
+         reopen();
+
+         version = 0; // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
+         block_stream.seekp(0, std::ios::end);
+         const uint32_t first = first_block_num;
+         block_stream.write((char*)&version, sizeof(version));
+         block_stream.write((char*)&first, sizeof(first));
+         block_stream.write(genesis_data.data(), genesis_data.size());
+         genesis_written_to_block_log = true;
+
+         // append a totem to indicate the division between blocks and header
+         auto totem = block_log::npos;
+         block_stream.write((char*)&totem, sizeof(totem));
+      }
+
+      void block_log_impl::finish_header() {
+         auto pos = block_stream.tellp();
+
+         static_assert( block_log::max_supported_version > 0, "a version number of zero is not supported" );
+         version = block_log::max_supported_version;
+         block_stream.seekp( 0 );
+         block_stream.write( (char*)&version, sizeof(version) );
+         block_stream.seekp( pos );
+         block_stream.flush();
+      }
+
+      /**
+       * The log can end in a partly written block if the process died while the writer was at it. The log is cut back
+       * to the end of the last block written in full, found from the last index entry that points at one; the index is
+       * then reconstructed as it is for any index that runs past the log.
+       *
+       * @return the size of the log
+       */
+      uint64_t block_log_impl::recover_tail( uint64_t header_end, uint64_t log_size ) {
+         // the end of the complete block written at pos, or 0 if there is none
+         auto end_of_block_at = [&]( uint64_t pos ) -> uint64_t {
+            try {
+               block_stream.seekg( pos );
+               signed_block tmp;
+               fc::raw::unpack( block_stream, tmp );
+               uint64_t stored_pos = block_log::npos;
+               block_stream.read( (char*)&stored_pos, sizeof(stored_pos) );
+               if( stored_pos == pos )
+                  return block_stream.tellg();
+            } catch( ... ) {
+            }
+            block_stream.clear();
+            return 0;
+         };
+
+         if( log_size == header_end )
+            return log_size;
+         if( log_size >= header_end + sizeof(uint64_t) ) {
+            uint64_t last_pos = block_log::npos;
+            block_stream.seekg( log_size - sizeof(last_pos) );
+            block_stream.read( (char*)&last_pos, sizeof(last_pos) );
+            if( last_pos >= header_end && last_pos < log_size && end_of_block_at( last_pos ) == log_size )
+               return log_size;
+         }
+
+         wlog( "Block log ${f} ends in an incomplete block, truncating it to the last complete block", ("f", block_file.generic_string()) );
+         uint64_t end = header_end;
+         const uint64_t index_size = fc::file_size( index_file );
+         for( uint64_t i = index_size / sizeof(uint64_t); i > 0; --i ) {
+            uint64_t pos = 0;
+            index_stream.seekg( (i - 1) * sizeof(pos) );
+            index_stream.read( (char*)&pos, sizeof(pos) );
+            if( pos < header_end || pos >= log_size )
+               continue;
+            if( auto block_end = end_of_block_at( pos ) ) {
+               end = block_end;
+               break;
+            }
+         }
+         // blocks past the index (or all of them, without one) are only found by walking the log
+         while( end < log_size ) {
+            auto block_end = end_of_block_at( end );
+            if( !block_end )
+               break;
+            end = block_end;
+         }
+
+         close();
+         fc::resize_file( block_file, end );
+         reopen();
+         ilog( "Block log truncated from ${old} to ${new} bytes", ("old", log_size)("new", end) );
+         return end;
+      }
+
+      /// writes a packed block at the end of blocks.log, retaining it first if the block starts a new stride, under the lock
+      uint64_t block_log_impl::write_block( uint32_t block_num, const bytes& data ) {
+         check_open_files();
+
+         if( config.stride != std::numeric_limits<uint32_t>::max() && block_num > first_block_num &&
+             (block_num - 1) % config.stride == 0 ) {
+            retain_blocks_log( block_num );
+         }
+
+         block_stream.seekp(0, std::ios::end);
+         index_stream.seekp(0, std::ios::end);
+         uint64_t pos = block_stream.tellp();
+         EOS_ASSERT(index_stream.tellp() == sizeof(uint64_t) * (block_num - first_block_num),
+                   block_log_append_fail,
+                   "Append to index file occuring at wrong position.",
+                   ("position", (uint64_t) index_stream.tellp())
+                   ("expected", (block_num - first_block_num) * sizeof(uint64_t)));
+         block_stream.write(data.data(), data.size());
+         block_stream.write((char*)&pos, sizeof(pos));
+         index_stream.write((char*)&pos, sizeof(pos));
+         return pos;
+      }
+
+      void block_log_impl::start_writer() {
+         if( config.write_queue_size == 0 || writer.joinable() )
+            return;
+         stop_writer = false;
+         writer_error = nullptr;
+         writer = std::thread( [this]() { run_writer(); } );
+      }
+
+      /**
+       * Writes whatever is queued when it wakes as one batch with a single flush at its end, so that the more blocks
+       * arrive while a flush is under way the fewer flushes there are per block.
+       */
+      void block_log_impl::run_writer() {
+         std::unique_lock<std::mutex> lk( queue_mtx );
+         while( true ) {
+            queue_cv.wait( lk, [this]() { return !queue.empty() || stop_writer; } );
+            if( queue.empty() )
+               return;
+
+            const vector<pending_block> batch( queue.begin(), queue.end() );
+            lk.unlock();
+            try {
+               std::lock_guard<std::mutex> g( mtx );
+               for( const auto& p : batch )
+                  write_block( p.block_num, *p.data );
+               flush_files();
+               readable_head_num = batch.back().block_num;
+            } catch( ... ) {
+               lk.lock();
+               writer_error = std::current_exception();
+               elog( "Block log writer failed writing blocks ${first} to ${last}, no more blocks will be written",
+                     ("first", batch.front().block_num)("last", batch.back().block_num) );
+               written_cv.notify_all();
+               return;
+            }
+            lk.lock();
+            queue.erase( queue.begin(), queue.begin() + batch.size() );
+            written_cv.notify_all();
+         }
+      }
+
+      /// waits for every queued block to be written and stops the writer, whose failure is left for wait_for_writer
+      void block_log_impl::stop_writing() {
+         if( !writer.joinable() )
+            return;
+         {
+            std::lock_guard<std::mutex> g( queue_mtx );
+            stop_writer = true;
+         }
+         queue_cv.notify_one();
+         writer.join();
+      }
+
+      void block_log_impl::enqueue( uint32_t block_num, std::shared_ptr<const bytes> data ) {
+         std::unique_lock<std::mutex> lk( queue_mtx );
+         written_cv.wait( lk, [this]() { return queue.size() < config.write_queue_size || writer_error; } );
+         if( writer_error )
+            std::rethrow_exception( writer_error );
+         queue.push_back( pending_block{ block_num, std::move( data ) } );
+         queue_cv.notify_one();
+      }
+
+      void block_log_impl::wait_for_writer() {
+         std::unique_lock<std::mutex> lk( queue_mtx );
+         written_cv.wait( lk, [this]() { return queue.empty() || writer_error; } );
+         if( writer_error )
+            std::rethrow_exception( writer_error );
+      }
+
+      serialized_block_view block_log_impl::read_pending_block( uint32_t block_num ) {
+         serialized_block_view view;
+         std::lock_guard<std::mutex> g( queue_mtx );
+         if( queue.empty() || block_num < queue.front().block_num || block_num > queue.back().block_num )
+            return view;
+         const auto& p = queue[block_num - queue.front().block_num];
+         view._data  = p.data->data();
+         view._size  = p.data->size();
+         view._owner = p.data;
+         return view;
+      }
+
+      void block_log_impl::open_retained_files() {
+         auto files = std::make_shared<retained_block_files>();
+         for( fc::directory_iterator itr( data_dir ), end; itr != end; ++itr ) {
+            retained_block_file f;
+            if( !fc::is_regular_file( *itr ) ||
+                !parse_retained_file_name( itr->filename().generic_string(), f.first_block_num, f.last_block_num ) )
+               continue;
+            f.block_file = *itr;
+            f.index_file = data_dir / ( retained_file_name( f.first_block_num, f.last_block_num ) + ".index" );
+            // a compressed file replaces the log before its index does, so an index left over means it got that far
+            if( fc::exists( temp_file( f.index_file ) ) && !fc::exists( temp_file( f.block_file ) ) )
+               fc::rename( temp_file( f.index_file ), f.index_file );
+            for( const auto& p : { temp_file( f.block_file ), temp_file( f.index_file ) } ) {
+               if( fc::exists( p ) )
+                  fc::remove( p );
+            }
+            EOS_ASSERT( fc::exists( f.index_file ), block_log_exception, "Index ${i} of retained block log file ${f} is missing",
+                        ("i", f.index_file.generic_string())("f", f.block_file.generic_string()) );
+            f.mapping = std::make_shared<const block_log_mapping>( f.block_file, f.index_file, f.first_block_num );
+            files->emplace_back( std::move( f ) );
+         }
+         std::sort( files->begin(), files->end(), []( const retained_block_file& a, const retained_block_file& b ) {
+            return a.first_block_num < b.first_block_num;
+         } );
+         for( size_t i = 1; i < files->size(); ++i ) {
+            if( (*files)[i].first_block_num != (*files)[i-1].last_block_num + 1 )
+               wlog( "Blocks ${first} to ${last} are missing from the retained block log files",
+                     ("first", (*files)[i-1].last_block_num + 1)("last", (*files)[i].first_block_num - 1) );
+         }
+         if( !files->empty() )
+            ilog( "Found ${n} retained block log files holding blocks ${first} to ${last}",
+                  ("n", files->size())("first", files->front().first_block_num)("last", files->back().last_block_num) );
+
+         // those a crash left uncompressed, or retained before compression was configured, are compressed now
+         retained_block_files uncompressed;
+         if( config.compress_retained_files ) {
+            std::copy_if( files->begin(), files->end(), std::back_inserter( uncompressed ), []( const retained_block_file& f ) {
+               return f.mapping->version() != compressed_log_version;
+            } );
+         }
+         {
+            std::lock_guard<std::mutex> g( retained_mtx );
+            apply_retention( *files );
+            std::atomic_store( &retained, std::shared_ptr<const retained_block_files>( std::move( files ) ) );
+         }
+         if( !uncompressed.empty() )
+            compress_retained_files( std::move( uncompressed ) );
+      }
+
+      /**
+       * Moves the blocks in blocks.log to a retained file and starts blocks.log over at next_block_num, under the lock.
+       *
+       * A crash at any step leaves files that open to the same blocks: the new blocks.log is written out in full as
+       * blocks.log.next before the index and then the log are renamed to the retained file, and open() completes or
+       * undoes the switch if it was cut short. The retained file is compressed afterwards, off the append path.
+       */
+      void block_log_impl::retain_blocks_log( uint32_t next_block_num ) {
+         retained_block_file f;
+         f.first_block_num = first_block_num;
+         f.last_block_num  = next_block_num - 1;
+         const auto name = retained_file_name( f.first_block_num, f.last_block_num );
+         f.block_file = data_dir / ( name + ".log" );
+         f.index_file = data_dir / ( name + ".index" );
+
+         block_stream.flush();
+         index_stream.flush();
+         close();
+         sync_file( block_file );
+         sync_file( index_file );
+
+         {
+            std::fstream next_out( next_block_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            next_out.exceptions( std::fstream::failbit | std::fstream::badbit );
+            const uint32_t v = block_log::max_supported_version;
+            auto totem = block_log::npos;
+            next_out.write( (char*)&v, sizeof(v) );
+            next_out.write( (char*)&next_block_num, sizeof(next_block_num) );
+            next_out.write( genesis_data.data(), genesis_data.size() );
+            next_out.write( (char*)&totem, sizeof(totem) );
+         }
+         sync_file( next_block_file );
+
+         {
+            std::lock_guard<std::mutex> g( retained_mtx );
+            fc::rename( index_file, f.index_file );
+            fc::rename( block_file, f.block_file );
+            fc::rename( next_block_file, block_file );
+            sync_file( data_dir );
+
+            f.mapping = std::make_shared<const block_log_mapping>( f.block_file, f.index_file, f.first_block_num );
+            ilog( "Blocks ${first} to ${last} moved to retained block log file ${f}",
+                  ("first", f.first_block_num)("last", f.last_block_num)("f", f.block_file.generic_string()) );
+
+            // readers find the blocks in the retained file before blocks.log is started over without them
+            auto files = std::make_shared<retained_block_files>( *std::atomic_load( &retained ) );
+            files->push_back( f );
+            apply_retention( *files );
+            std::atomic_store( &retained, std::shared_ptr<const retained_block_files>( std::move( files ) ) );
+         }
+
+         first_block_num = next_block_num;
+         version = block_log::max_supported_version;
+         reopen();
+
+         if( config.compress_retained_files )
+            compress_retained_files( { f } );
+      }
+
+      /// compresses the files in a task of their own, once the files handed to the previous one are done
+      void block_log_impl::compress_retained_files( retained_block_files files ) {
+         wait_for_compression();
+         compression = std::async( std::launch::async, [this, files = std::move( files )]() {
+            for( const auto& f : files ) {
+               try {
+                  compress_retained_file( f );
+               } catch( const fc::exception& e ) {
+                  wlog( "Unable to compress retained block log file ${f}, it is kept as it is: ${e}",
+                        ("f", f.block_file.generic_string())("e", e.to_detail_string()) );
+               } catch( const std::exception& e ) {
+                  wlog( "Unable to compress retained block log file ${f}, it is kept as it is: ${e}",
+                        ("f", f.block_file.generic_string())("e", e.what()) );
+               } catch( ... ) {
+                  wlog( "Unable to compress retained block log file ${f}, it is kept as it is", ("f", f.block_file.generic_string()) );
+               }
+            }
+         } );
+      }
+
+      /**
+       * Rewrites a retained file with each block compressed on its own, so that it stays randomly readable through its
+       * index. Both files are written under temporary names and replace the originals log first; readers keep the
+       * mapping of the originals until they next look the file up.
+       */
+      void block_log_impl::compress_retained_file( const retained_block_file& f ) {
+         const auto block_tmp = temp_file( f.block_file );
+         const auto index_tmp = temp_file( f.index_file );
+         {
+            const auto& src = *f.mapping;
+            std::fstream block_out( block_tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            std::fstream index_out( index_tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            block_out.exceptions( std::fstream::failbit | std::fstream::badbit );
+            index_out.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+            // the genesis state is taken from the header of the file itself, which is there before any block
+            EOS_ASSERT( src.block_count() > 0, block_log_exception, "Retained block log file ${f} holds no blocks",
+                        ("f", f.block_file.generic_string()) );
+            const uint64_t genesis_begin = src.version() > 1 ? 2 * sizeof(uint32_t) : sizeof(uint32_t);
+            const uint64_t genesis_end   = src.version() > 1 ? src.block_pos( 0 ) - sizeof(uint64_t) : src.block_pos( 0 );
+
+            const uint32_t v = compressed_log_version;
+            auto totem = block_log::npos;
+            block_out.write( (char*)&v, sizeof(v) );
+            block_out.write( (char*)&f.first_block_num, sizeof(f.first_block_num) );
+            block_out.write( src.block_data + genesis_begin, genesis_end - genesis_begin );
+            block_out.write( (char*)&totem, sizeof(totem) );
+            for( uint64_t i = 0; i < src.block_count(); ++i ) {
+               auto entry = src.block_entry( i );
+               auto data = fc::raw::pack( zlib_compress( entry.first, entry.second ) );
+               uint64_t pos = block_out.tellp();
+               block_out.write( data.data(), data.size() );
+               block_out.write( (char*)&pos, sizeof(pos) );
+               index_out.write( (char*)&pos, sizeof(pos) );
+            }
+         }
+         sync_file( block_tmp );
+         sync_file( index_tmp );
+
+         std::lock_guard<std::mutex> g( retained_mtx );
+         auto files = std::make_shared<retained_block_files>( *std::atomic_load( &retained ) );
+         auto itr = std::find_if( files->begin(), files->end(), [&]( const retained_block_file& r ) {
+            return r.block_file == f.block_file;
+         } );
+         if( itr == files->end() ) {
+            // archived or removed while it was being compressed
+            fc::remove( block_tmp );
+            fc::remove( index_tmp );
+            return;
+         }
+         fc::rename( block_tmp, f.block_file );
+         fc::rename( index_tmp, f.index_file );
+         sync_file( data_dir );
+         itr->mapping = std::make_shared<const block_log_mapping>( f.block_file, f.index_file, f.first_block_num );
+         std::atomic_store( &retained, std::shared_ptr<const retained_block_files>( std::move( files ) ) );
+         ilog( "Retained block log file ${f} compressed", ("f", f.block_file.generic_string()) );
+      }
+
+      void block_log_impl::apply_retention( retained_block_files& files ) {
+         if( files.size() <= config.max_retained_files )
+            return;
+
+         fc::path archive_dir = config.archive_dir;
+         if( !archive_dir.empty() && archive_dir.is_relative() )
+            archive_dir = data_dir / archive_dir;
+         if( !archive_dir.empty() && !fc::is_directory( archive_dir ) )
+            fc::create_directories( archive_dir );
+
+         const size_t excess = files.size() - config.max_retained_files;
+         for( size_t i = 0; i < excess; ++i ) {
+            const auto& f = files[i];
+            for( const auto& p : { f.block_file, f.index_file } ) {
+               if( archive_dir.empty() ) {
+                  fc::remove( p );
+               } else {
+                  try {
+                     fc::rename( p, archive_dir / p.filename() );
+                  } catch( const fc::exception& ) {
+                     // the archive may be on another file system
+                     fc::copy( p, archive_dir / p.filename() );
+                     fc::remove( p );
+                  }
+               }
+            }
+            ilog( "Blocks ${first} to ${last} ${what} the block log",
+                  ("first", f.first_block_num)("last", f.last_block_num)("what", archive_dir.empty() ? "removed from" : "archived out of") );
+         }
+         // mappings still held by readers stay valid after their files are gone
+         files.erase( files.begin(), files.begin() + excess );
+      }
+
+      /// removes the retained files, unless the log starting over at next_block_num carries on from them
+      void block_log_impl::remove_retained_files( uint32_t next_block_num ) {
+         std::lock_guard<std::mutex> g( retained_mtx );
+         auto files = std::atomic_load( &retained );
+         if( files && !files->empty() && files->back().last_block_num + 1 == next_block_num ) {
+            ilog( "Keeping the retained block log files of blocks ${first} to ${last}, which the block log carries on from",
+                  ("first", files->front().first_block_num)("last", files->back().last_block_num) );
+            return;
+         }
+         if( files ) {
+            for( const auto& f : *files ) {
+               fc::remove( f.block_file );
+               fc::remove( f.index_file );
+            }
+         }
+         std::atomic_store( &retained, std::make_shared<const retained_block_files>() );
+      }
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   signed_block_ptr serialized_block_view::unpack()const {
+      auto b = std::make_shared<signed_block>();
+      fc::datastream<const char*> ds( _data, _size );
+      fc::raw::unpack( ds, *b );
+      return b;
+   }
+
+   block_log::block_log(const fc::path& data_dir, const block_log_config& config)
    :my(new detail::block_log_impl()) {
+      my->config = config;
       my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
       my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
       open(data_dir);
+      my->start_writer();
    }
 
    block_log::block_log(block_log&& other) {
@@ -83,7 +810,9 @@ namespace eosio { namespace chain {
 
    block_log::~block_log() {
       if (my) {
-         flush();
+         my->stop_writing();
+         my->wait_for_compression();
+         my->flush_files();
          my->close();
          my.reset();
       }
@@ -95,8 +824,22 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(data_dir))
          fc::create_directories(data_dir);
 
+      my->data_dir   = data_dir;
       my->block_file = data_dir / "blocks.log";
       my->index_file = data_dir / "blocks.index";
+      my->next_block_file = data_dir / "blocks.log.next";
+
+      // a retain cut short leaves the new blocks.log, in full, either next to the old one or in place of it
+      if( fc::exists( my->next_block_file ) ) {
+         if( fc::exists( my->block_file ) ) {
+            fc::remove( my->next_block_file );
+         } else {
+            ilog( "Completing the retain of the block log interrupted before ${f} was started over", ("f", my->block_file.generic_string()) );
+            fc::rename( my->next_block_file, my->block_file );
+         }
+      }
+      // before the head is read, which is in the newest of them while blocks.log has just been started over
+      my->open_retained_files();
 
       my->reopen();
 
@@ -134,19 +877,30 @@ namespace eosio { namespace chain {
 
          my->genesis_written_to_block_log = true; // Assume it was constructed properly.
          if (my->version > 1){
-            my->first_block_num = 0;
-            my->block_stream.read( (char*)&my->first_block_num, sizeof(my->first_block_num) );
-            EOS_ASSERT(my->first_block_num > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+            uint32_t first = 0;
+            my->block_stream.read( (char*)&first, sizeof(first) );
+            EOS_ASSERT(first > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+            my->first_block_num = first;
          } else {
             my->first_block_num = 1;
          }
 
+         genesis_state gs;
+         fc::raw::unpack( my->block_stream, gs );
+         my->genesis_data = fc::raw::pack( gs );
+
+         uint64_t header_end = my->block_stream.tellg();
+         if( my->version > 1 )
+            header_end += sizeof(uint64_t); // the totem
+         log_size = my->recover_tail( header_end, log_size );
+
          my->head = read_head();
          if( my->head ) {
             my->head_id = my->head->id();
          } else {
             my->head_id = {};
          }
+         my->readable_head_num = my->head ? my->head->block_num() : my->first_block_num - 1;
 
          if (index_size) {
             ilog("Index is nonempty");
@@ -181,87 +935,85 @@ namespace eosio { namespace chain {
       try {
          EOS_ASSERT( my->genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
-         my->check_open_files();
-
-         my->block_stream.seekp(0, std::ios::end);
-         my->index_stream.seekp(0, std::ios::end);
-         uint64_t pos = my->block_stream.tellp();
-         EOS_ASSERT(my->index_stream.tellp() == sizeof(uint64_t) * (b->block_num() - my->first_block_num),
-                   block_log_append_fail,
-                   "Append to index file occuring at wrong position.",
-                   ("position", (uint64_t) my->index_stream.tellp())
-                   ("expected", (b->block_num() - my->first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         my->block_stream.write(data.data(), data.size());
-         my->block_stream.write((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
+         // packed once, the same bytes are written and served to readers while the block waits for the writer
+         auto data = std::make_shared<const bytes>( fc::raw::pack(*b) );
+         uint64_t pos = npos;
+         if( my->writer.joinable() ) {
+            // the writer only finds out about a misplaced block later, so it is rejected here; with no head the queue
+            // is empty and first_block_num is not being changed by the writer
+            const uint32_t expected = my->head ? my->head->block_num() + 1 : my->first_block_num.load();
+            EOS_ASSERT( b->block_num() == expected, block_log_append_fail,
+                        "Append of block ${n} to block log which expects block ${e} next", ("n", b->block_num())("e", expected) );
+            my->enqueue( b->block_num(), std::move( data ) );
+         } else {
+            std::lock_guard<std::mutex> g( my->mtx );
+            pos = my->write_block( b->block_num(), *data );
+            my->flush_files();
+            my->readable_head_num = b->block_num();
+         }
          my->head = b;
          my->head_id = b->id();
 
-         flush();
-
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
    void block_log::flush() {
-      my->block_stream.flush();
-      my->index_stream.flush();
+      if( my->writer.joinable() ) {
+         my->wait_for_writer();
+      } else {
+         my->flush_files();
+      }
    }
 
    void block_log::reset( const genesis_state& gs, const signed_block_ptr& first_block, uint32_t first_block_num ) {
+      // whatever is still queued belongs to the log being discarded, and the header is written around the first block
+      my->stop_writing();
+      my->wait_for_compression();
+      {
+         std::lock_guard<std::mutex> g( my->queue_mtx );
+         my->queue.clear();
+      }
       my->close();
 
       fc::remove_all(my->block_file);
       fc::remove_all(my->index_file);
+      my->remove_retained_files( first_block_num );
 
-      my->reopen();
-
-      auto data = fc::raw::pack(gs);
-      my->version = 0; // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
+      my->genesis_data = fc::raw::pack(gs);
       my->first_block_num = first_block_num;
-      my->block_stream.seekp(0, std::ios::end);
-      my->block_stream.write((char*)&my->version, sizeof(my->version));
-      my->block_stream.write((char*)&my->first_block_num, sizeof(my->first_block_num));
-      my->block_stream.write(data.data(), data.size());
-      my->genesis_written_to_block_log = true;
-
-      // append a totem to indicate the division between blocks and header
-      auto totem = npos;
-      my->block_stream.write((char*)&totem, sizeof(totem));
+      my->readable_head_num = first_block_num - 1;
+      my->head.reset();
+      my->head_id = {};
+      my->write_header();
 
       if (first_block) {
          append(first_block);
       }
 
-      auto pos = my->block_stream.tellp();
-
-      static_assert( block_log::max_supported_version > 0, "a version number of zero is not supported" );
-      my->version = block_log::max_supported_version;
-      my->block_stream.seekp( 0 );
-      my->block_stream.write( (char*)&my->version, sizeof(my->version) );
-      my->block_stream.seekp( pos );
-      flush();
+      my->finish_header();
+      my->start_writer();
    }
 
    std::pair<signed_block_ptr, uint64_t> block_log::read_block(uint64_t pos)const {
-      my->check_open_files();
+      auto m = my->get_mapping( [pos]( const detail::block_log_mapping& mapped ) { return pos < mapped.block_size; } );
+      EOS_ASSERT( pos < m->block_size, block_log_exception, "Position ${pos} is past the end of the block log", ("pos", pos) );
 
-      my->block_stream.seekg(pos);
+      fc::datastream<const char*> ds( m->block_data + pos, m->block_size - pos );
       std::pair<signed_block_ptr,uint64_t> result;
       result.first = std::make_shared<signed_block>();
-      fc::raw::unpack(my->block_stream, *result.first);
-      result.second = uint64_t(my->block_stream.tellg()) + 8;
+      fc::raw::unpack(ds, *result.first);
+      result.second = pos + ds.tellp() + 8;
       return result;
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
          signed_block_ptr b;
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
-            b = read_block(pos).first;
+         auto view = my->read_serialized_block(block_num);
+         if (view) {
+            b = view.unpack();
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
          }
@@ -269,17 +1021,18 @@ namespace eosio { namespace chain {
       } FC_LOG_AND_RETHROW()
    }
 
+   serialized_block_view block_log::read_serialized_block_by_num(uint32_t block_num)const {
+      return my->read_serialized_block(block_num);
+   }
+
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_open_files();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
-         return npos;
-      my->index_stream.seekg(sizeof(uint64_t) * (block_num - my->first_block_num));
-      uint64_t pos;
-      my->index_stream.read((char*)&pos, sizeof(pos));
-      return pos;
+      return my->get_block_pos(block_num);
    }
 
    signed_block_ptr block_log::read_head()const {
+      if( my->writer.joinable() )
+         my->wait_for_writer();
+      std::lock_guard<std::mutex> g( my->mtx );
       my->check_open_files();
 
       uint64_t pos;
@@ -292,17 +1045,30 @@ namespace eosio { namespace chain {
       my->block_stream.seekg(-sizeof(pos), std::ios::end);
       my->block_stream.read((char*)&pos, sizeof(pos));
       if (pos != npos) {
-         return read_block(pos).first;
-      } else {
-         return {};
+         return my->read_block(pos).first;
+      }
+
+      // blocks.log is started over without blocks when it is retained, until the block after the stride is appended
+      auto files = std::atomic_load( &my->retained );
+      if( files && !files->empty() && files->back().last_block_num + 1 == my->first_block_num ) {
+         if( auto view = my->read_retained_block( files->back().last_block_num ) )
+            return view.unpack();
       }
+      return {};
    }
 
    const signed_block_ptr& block_log::head()const {
       return my->head;
    }
 
+   uint32_t block_log::readable_head_num() const {
+      return my->readable_head_num;
+   }
+
    uint32_t block_log::first_block_num() const {
+      auto files = std::atomic_load( &my->retained );
+      if( files && !files->empty() )
+         return files->front().first_block_num;
       return my->first_block_num;
    }
 
@@ -379,6 +1145,19 @@ namespace eosio { namespace chain {
       fc::create_directories(blocks_dir);
       auto block_log_path = blocks_dir / "blocks.log";
 
+      // retained files hold irreversible blocks that were already checked when they were retained, so they are moved
+      // back as they are
+      for( fc::directory_iterator itr( backup_dir ), end; itr != end; ++itr ) {
+         uint32_t first = 0, last = 0;
+         if( !fc::is_regular_file( *itr ) || !detail::parse_retained_file_name( itr->filename().generic_string(), first, last ) )
+            continue;
+         const auto name = detail::retained_file_name( first, last );
+         for( const auto& file_name : { name + ".log", name + ".index" } ) {
+            if( fc::exists( backup_dir / file_name ) )
+               fc::rename( backup_dir / file_name, blocks_dir / file_name );
+         }
+      }
+
       ilog( "Reconstructing '${new_block_log}' from backed up block log", ("new_block_log", block_log_path) );
 
       std::fstream  old_block_stream;
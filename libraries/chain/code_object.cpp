@@ -0,0 +1,39 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+namespace eosio { namespace chain {
+
+   void add_code_reference( chainbase::database& db, const digest_type& code_hash, const char* code, size_t code_size ) {
+      const auto* existing = db.find<code_object, by_code_hash>( code_hash );
+      if( existing ) {
+         db.modify( *existing, []( auto& c ) {
+            ++c.code_ref_count;
+         });
+         return;
+      }
+      db.create<code_object>( [&]( auto& c ) {
+         c.code_hash = code_hash;
+         c.code.assign( code, code_size );
+         c.code_ref_count = 1;
+      });
+   }
+
+   bool release_code_reference( chainbase::database& db, const digest_type& code_hash ) {
+      const auto& existing = db.get<code_object, by_code_hash>( code_hash );
+      EOS_ASSERT( existing.code_ref_count > 0, misc_exception,
+                  "code ${hash} has no references left to release", ("hash", code_hash) );
+      if( existing.code_ref_count == 1 ) {
+         db.remove( existing );
+         return true;
+      }
+      db.modify( existing, []( auto& c ) {
+         --c.code_ref_count;
+      });
+      return false;
+   }
+
+} } // eosio::chain
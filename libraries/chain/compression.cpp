@@ -0,0 +1,35 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/compression.hpp>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace bio = boost::iostreams;
+
+   bytes zlib_compress( const char* data, size_t size ) {
+      bytes out;
+      bio::filtering_ostream comp;
+      comp.push( bio::zlib_compressor( bio::zlib::best_speed ) );
+      comp.push( bio::back_inserter( out ) );
+      bio::write( comp, data, size );
+      bio::close( comp );
+      return out;
+   }
+
+   bytes zlib_decompress( const char* data, size_t size ) {
+      bytes out;
+      bio::filtering_ostream decomp;
+      decomp.push( bio::zlib_decompressor() );
+      decomp.push( bio::back_inserter( out ) );
+      bio::write( decomp, data, size );
+      bio::close( decomp );
+      return out;
+   }
+
+} } /// namespace eosio::chain
@@ -6,24 +6,30 @@
 #include <eosio/chain/exceptions.hpp>
 
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/database_header_object.hpp>
 #include <eosio/chain/block_summary_object.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/transaction_dedup_store.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
 #include <fc/scoped_exit.hpp>
 #include <fc/variant_object.hpp>
 
+#include <deque>
+
 namespace eosio { namespace chain {
 
 using resource_limits::resource_limits_manager;
@@ -31,10 +37,10 @@ using resource_limits::resource_limits_manager;
 using controller_index_set = index_set<
    account_index,
    account_sequence_index,
+   code_index,
    global_property_multi_index,
    dynamic_global_property_multi_index,
    block_summary_multi_index,
-   transaction_multi_index,
    generated_transaction_multi_index,
    table_id_multi_index
 >;
@@ -54,11 +60,13 @@ class maybe_session {
 
       maybe_session( maybe_session&& other)
       :_session(move(other._session))
+      ,_dedup_session(move(other._dedup_session))
       {
       }
 
-      explicit maybe_session(database& db) {
+      maybe_session(database& db, transaction_dedup_store& dedup) {
          _session = db.start_undo_session(true);
+         _dedup_session = dedup.start_undo_session(true);
       }
 
       maybe_session(const maybe_session&) = delete;
@@ -66,16 +74,22 @@ class maybe_session {
       void squash() {
          if (_session)
             _session->squash();
+         if (_dedup_session)
+            _dedup_session->squash();
       }
 
       void undo() {
          if (_session)
             _session->undo();
+         if (_dedup_session)
+            _dedup_session->undo();
       }
 
       void push() {
          if (_session)
             _session->push();
+         if (_dedup_session)
+            _dedup_session->push();
       }
 
       maybe_session& operator = ( maybe_session&& mv ) {
@@ -86,11 +100,19 @@ class maybe_session {
             _session.reset();
          }
 
+         if (mv._dedup_session) {
+            _dedup_session = move(*mv._dedup_session);
+            mv._dedup_session.reset();
+         } else {
+            _dedup_session.reset();
+         }
+
          return *this;
       };
 
    private:
-      optional<database::session>     _session;
+      optional<database::session>                  _session;
+      optional<transaction_dedup_store::session>   _dedup_session;
 };
 
 struct pending_state {
@@ -101,7 +123,7 @@ struct pending_state {
 
    block_state_ptr                    _pending_block_state;
 
-   vector<action_receipt>             _actions;
+   vector<digest_type>                _action_receipt_digests;
 
    controller::block_status           _block_status = controller::block_status::incomplete;
 
@@ -115,12 +137,14 @@ struct pending_state {
 struct controller_impl {
    controller&                    self;
    chainbase::database            db;
-   chainbase::database            reversible_blocks; ///< a special database to persist blocks that have successfully been applied but are still reversible
+   transaction_dedup_store        trx_dedup; ///< ids of the unexpired transactions in blocks, kept at the revision of db
+   reversible_block_log           reversible_blocks; ///< persists blocks that have successfully been applied but are still reversible
    block_log                      blog;
    optional<pending_state>        pending;
    block_state_ptr                head;
    fork_database                  fork_db;
    wasm_interface                 wasmif;
+   native_contract_registry       native_contracts;
    resource_limits_manager        resource_limits;
    authorization_manager          authorization;
    controller::config             conf;
@@ -132,6 +156,7 @@ struct controller_impl {
    optional<fc::microseconds>     subjective_cpu_leeway;
    bool                           trusted_producer_light_validation = false;
    uint32_t                       snapshot_head_block = 0;
+   key_recovery_report            last_key_recovery;
    boost::asio::thread_pool       thread_pool;
 
    typedef pair<scope_name,action_name>                   handler_key;
@@ -148,10 +173,7 @@ struct controller_impl {
       auto prev = fork_db.get_block( head->header.previous );
       EOS_ASSERT( prev, block_validate_exception, "attempt to pop beyond last irreversible block" );
 
-      if( const auto* b = reversible_blocks.find<reversible_block_object,by_num>(head->block_num) )
-      {
-         reversible_blocks.remove( *b );
-      }
+      reversible_blocks.truncate_from( head->block_num );
 
       if ( read_mode == db_read_mode::SPECULATIVE ) {
          EOS_ASSERT( head->block, block_validate_exception, "attempting to pop a block that was sparsely loaded from a snapshot");
@@ -160,6 +182,7 @@ struct controller_impl {
       }
       head = prev;
       db.undo();
+      trx_dedup.undo();
 
    }
 
@@ -173,12 +196,11 @@ struct controller_impl {
     db( cfg.state_dir,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.state_size ),
-    reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
-        cfg.read_only ? database::read_only : database::read_write,
-        cfg.reversible_cache_size ),
-    blog( cfg.blocks_dir ),
+    trx_dedup( cfg.state_dir ),
+    reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name, cfg.read_only ),
+    blog( cfg.blocks_dir, cfg.blocks_log ),
     fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime ),
+    wasmif( cfg.wasm_runtime, cfg.wasm_code_cache_dir, cfg.wasm_code_cache_size, cfg.wasm_cache_size, cfg.wasm_tiering ),
     resource_limits( db ),
     authorization( s, db ),
     conf( cfg ),
@@ -186,6 +208,8 @@ struct controller_impl {
     read_mode( cfg.read_mode ),
     thread_pool( cfg.thread_pool_size )
    {
+   signature_recovery_cache::instance().set_capacity( cfg.sig_recovery_cache_size );
+   native_contracts.set_mode( cfg.native_contract_mode );
 
 #define SET_APP_HANDLER( receiver, contract, action) \
    set_apply_handler( #receiver, #contract, #action, &BOOST_PP_CAT(apply_, BOOST_PP_CAT(contract, BOOST_PP_CAT(_,action) ) ) )
@@ -262,17 +286,14 @@ struct controller_impl {
 
 
       db.commit( s->block_num );
+      trx_dedup.commit( s->block_num );
 
       if( append_to_blog ) {
          blog.append(s->block);
       }
 
-      const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
-      auto objitr = ubi.begin();
-      while( objitr != ubi.end() && objitr->blocknum <= s->block_num ) {
-         reversible_blocks.remove( *objitr );
-         objitr = ubi.begin();
-      }
+      // a block still queued for the block log's writer would be lost by a crash, so it is kept until it is readable
+      reversible_blocks.remove_through( std::min( s->block_num, blog.readable_head_num() ) );
 
       // the "head" block when a snapshot is loaded is virtual and has no block data, all of its effects
       // should already have been loaded from the snapshot so, it cannot be applied
@@ -281,7 +302,7 @@ struct controller_impl {
             // when applying a snapshot, head may not be present
             // when not applying a snapshot, make sure this is the next block
             if (!head || s->block_num == head->block_num + 1) {
-               apply_block(s->block, controller::block_status::complete);
+               apply_block(s, controller::block_status::complete);
                head = s;
             } else {
                // otherwise, assert the one odd case where initializing a chain
@@ -297,6 +318,47 @@ struct controller_impl {
       }
    }
 
+   struct replay_block {
+      signed_block_ptr                 block;
+      vector<transaction_metadata_ptr> trxs;
+   };
+
+   /**
+    *  Reads a block from the block log and builds the metadata of its packed transactions on the thread pool, so that
+    *  decoding, transaction id computation and (when all checks are forced) key recovery overlap with the application
+    *  of the blocks before it.
+    */
+   std::future<replay_block> read_ahead_block( uint32_t block_num, bool recover_keys ) {
+      return async_thread_pool( thread_pool, [this, block_num, recover_keys]() {
+         replay_block r;
+         r.block = blog.read_block_by_num( block_num );
+         if( r.block ) {
+            r.trxs.reserve( r.block->transactions.size() );
+            try {
+               for( auto& receipt : r.block->transactions ) {
+                  if( receipt.trx.contains<packed_transaction>() ) {
+                     // share the packed transaction owned by the block instead of copying it, this is also how
+                     // apply_block recognizes the metadata as belonging to the block
+                     packed_transaction_ptr ptrx( r.block, &receipt.trx.get<packed_transaction>() );
+                     auto mtrx = std::make_shared<transaction_metadata>( ptrx );
+                     if( recover_keys ) {
+                        try {
+                           mtrx->recover_keys( chain_id );
+                        } catch( const fc::exception& ) {} // left unrecovered, applying the transaction recovers again and fails there
+                     }
+                     r.trxs.emplace_back( std::move( mtrx ) );
+                  }
+               }
+            } catch( const fc::exception& ) {
+               // a transaction that cannot be decoded fails when the block is applied, which builds all of its
+               // metadata itself when none is attached. Anything else, such as running out of memory, ends the replay
+               r.trxs.clear();
+            }
+         }
+         return r;
+      } );
+   }
+
    void replay(std::function<bool()> shutdown) {
       auto blog_head = blog.read_head();
       auto blog_head_time = blog_head->timestamp.to_time_point();
@@ -306,25 +368,55 @@ struct controller_impl {
       ilog( "existing block log, attempting to replay from ${s} to ${n} blocks",
             ("s", start_block_num)("n", blog_head->block_num()) );
 
+      // recording every replayed block in the fork database log only for it to be pruned is wasted, the fork
+      // database is written once when the replay ends, however it ends
+      fork_db.suspend_log();
+      auto resume_fork_db_log = fc::make_scoped_exit([this]() {
+         fork_db.resume_log();
+      });
+
       auto start = fc::time_point::now();
-      while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
-         replay_push_block( next, controller::block_status::irreversible );
-         if( next->block_num() % 500 == 0 ) {
-            ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
-            if( shutdown() ) break;
+      {
+         std::deque<std::future<replay_block>> read_ahead;
+         uint32_t next_read = start_block_num;
+         auto wait_read_ahead = fc::make_scoped_exit([&read_ahead]() {
+            for( auto& f : read_ahead )
+               f.wait();
+         });
+
+         while( true ) {
+            replay_block next;
+            if( conf.replay_read_ahead_blocks > 0 ) {
+               while( read_ahead.size() < conf.replay_read_ahead_blocks && next_read <= blog_head->block_num() )
+                  read_ahead.emplace_back( read_ahead_block( next_read++, conf.force_all_checks ) );
+               if( read_ahead.empty() ) break;
+               next = read_ahead.front().get();
+               read_ahead.pop_front();
+            } else {
+               next.block = blog.read_block_by_num( head->block_num + 1 );
+            }
+            if( !next.block ) break;
+
+            replay_push_block( next.block, controller::block_status::irreversible, std::move( next.trxs ) );
+            if( next.block->block_num() % 500 == 0 ) {
+               ilog( "${n} of ${head}", ("n", next.block->block_num())("head", blog_head->block_num()) );
+               if( shutdown() ) break;
+            }
          }
       }
       ilog( "${n} blocks replayed", ("n", head->block_num - start_block_num) );
 
       // if the irreversible log is played without undo sessions enabled, we need to sync the
       // revision ordinal to the appropriate expected value here.
-      if( self.skip_db_sessions( controller::block_status::irreversible ) )
+      if( self.skip_db_sessions( controller::block_status::irreversible ) ) {
          db.set_revision(head->block_num);
+         trx_dedup.set_revision(head->block_num);
+      }
 
       int rev = 0;
-      while( auto obj = reversible_blocks.find<reversible_block_object,by_num>(head->block_num+1) ) {
+      while( auto b = reversible_blocks.read_block_by_num( head->block_num+1 ) ) {
          ++rev;
-         replay_push_block( obj->get_block(), controller::block_status::validated );
+         replay_push_block( b, controller::block_status::validated );
       }
 
       ilog( "${n} reversible blocks replayed", ("n",rev) );
@@ -336,7 +428,19 @@ struct controller_impl {
       replay_head_time.reset();
    }
 
+   /// the objects of a state database of another version are laid out differently, so it must not be read at all
+   void validate_db_version()const {
+      const auto* header = db.find<database_header_object>();
+      EOS_ASSERT( header, bad_database_version_exception,
+                  "state database version pre-dates versioning; restore from a snapshot or replay the blockchain" );
+      header->validate();
+   }
+
    void init(std::function<bool()> shutdown, const snapshot_reader_ptr& snapshot) {
+      // a database at revision 0 is empty and is about to be filled from the snapshot, the genesis state or the block log
+      if( db.revision() > 0 ) {
+         validate_db_version();
+      }
 
       bool report_integrity_hash = !!snapshot;
       if (snapshot) {
@@ -370,12 +474,10 @@ struct controller_impl {
 
       if( shutdown() ) return;
 
-      const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
-      auto objitr = ubi.rbegin();
-      if( objitr != ubi.rend() ) {
-         EOS_ASSERT( objitr->blocknum == head->block_num, fork_database_exception,
+      if( !reversible_blocks.empty() ) {
+         EOS_ASSERT( reversible_blocks.last_block_num() == head->block_num, fork_database_exception,
                     "reversible block database is inconsistent with fork database, replay blockchain",
-                    ("head",head->block_num)("unconfimed", objitr->blocknum)         );
+                    ("head",head->block_num)("unconfimed", reversible_blocks.last_block_num())         );
       } else {
          auto end = blog.read_head();
          EOS_ASSERT( !end || end->block_num() == head->block_num, fork_database_exception,
@@ -385,6 +487,9 @@ struct controller_impl {
 
       EOS_ASSERT( db.revision() >= head->block_num, fork_database_exception, "fork database is inconsistent with shared memory",
                  ("db",db.revision())("head",head->block_num) );
+      EOS_ASSERT( trx_dedup.revision() == db.revision(), fork_database_exception,
+                 "transaction deduplication store is inconsistent with shared memory, replay blockchain",
+                 ("dedup",trx_dedup.revision())("db",db.revision()) );
 
       if( db.revision() > head->block_num ) {
          wlog( "warning: database revision (${db}) is greater than head block number (${head}), "
@@ -393,6 +498,7 @@ struct controller_impl {
       }
       while( db.revision() > head->block_num ) {
          db.undo();
+         trx_dedup.undo();
       }
 
       if( report_integrity_hash ) {
@@ -410,10 +516,9 @@ struct controller_impl {
    }
 
    void add_indices() {
-      reversible_blocks.add_index<reversible_block_index>();
-
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
+      db.add_index<database_header_multi_index>();
 
       authorization.add_indices();
       resource_limits.add_indices();
@@ -422,11 +527,15 @@ struct controller_impl {
    void clear_all_undo() {
       // Rewind the database to the last irreversible block
       db.undo_all();
+      trx_dedup.undo_all();
    }
 
    void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section("contract_tables", [this]( auto& section ) {
-         index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
+      // each table is written whole by the part its id falls in, so that parts can be written at once
+      using table_utils = index_utils<table_id_multi_index>;
+      const auto parts = table_utils::part_count(db, config::snapshot_tables_per_part);
+      snapshot->write_section_parts("contract_tables", parts, [this, parts]( uint32_t part, auto& section ) {
+         table_utils::walk_part(db, part, parts, [this, &section]( const table_id_object& table_row ){
             // add a row for the table
             section.add_row(table_row, db);
 
@@ -500,13 +609,20 @@ struct controller_impl {
             return;
          }
 
-         snapshot->write_section<value_t>([this]( auto& section ){
-            decltype(utils)::walk(db, [this, &section]( const auto &row ) {
+         const auto parts = decltype(utils)::part_count(db, config::snapshot_rows_per_part);
+         snapshot->write_section_parts<value_t>(parts, [this, parts]( uint32_t part, auto& section ){
+            decltype(utils)::walk_part(db, part, parts, [this, &section]( const auto &row ) {
                section.add_row(row, db);
             });
          });
       });
 
+      snapshot->write_section<transaction_object>([this]( auto& section ){
+         trx_dedup.walk([this, &section]( const transaction_id_type& id, time_point_sec expiration ) {
+            section.add_row(transaction_object{expiration, id}, db);
+         });
+      });
+
       add_contract_tables_to_snapshot(snapshot);
 
       authorization.add_to_snapshot(snapshot);
@@ -514,12 +630,13 @@ struct controller_impl {
    }
 
    void read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
-      snapshot->read_section<chain_snapshot_header>([this]( auto &section ){
-         chain_snapshot_header header;
+      chain_snapshot_header header;
+      snapshot->read_section<chain_snapshot_header>([this, &header]( auto &section ){
          section.read_row(header, db);
          header.validate();
       });
 
+      db.create<database_header_object>([](auto&){});
 
       snapshot->read_section<block_state>([this]( auto &section ){
          block_header_state head_header_state;
@@ -533,7 +650,7 @@ struct controller_impl {
          snapshot_head_block = head->block_num;
       });
 
-      controller_index_set::walk_indices([this, &snapshot]( auto utils ){
+      controller_index_set::walk_indices([this, &snapshot, &header]( auto utils ){
          using value_t = typename decltype(utils)::index_t::value_type;
 
          // skip the table_id_object as its inlined with contract tables section
@@ -541,6 +658,17 @@ struct controller_impl {
             return;
          }
 
+         // version 1 snapshots kept the code in the account rows and have no section of code objects
+         if (header.version < 2) {
+            if (std::is_same<value_t, account_object>::value) {
+               read_legacy_accounts_from_snapshot(snapshot);
+               return;
+            }
+            if (std::is_same<value_t, code_object>::value) {
+               return;
+            }
+         }
+
          snapshot->read_section<value_t>([this]( auto& section ) {
             bool more = !section.empty();
             while(more) {
@@ -551,12 +679,45 @@ struct controller_impl {
          });
       });
 
+      snapshot->read_section<transaction_object>([this]( auto& section ) {
+         bool more = !section.empty();
+         while(more) {
+            transaction_object row;
+            more = section.read_row(row, db);
+            trx_dedup.add(row.trx_id, row.expiration);
+         }
+      });
+
       read_contract_tables_from_snapshot(snapshot);
 
       authorization.read_from_snapshot(snapshot);
       resource_limits.read_from_snapshot(snapshot);
 
       db.set_revision( head->block_num );
+      trx_dedup.set_revision( head->block_num );
+   }
+
+   void read_legacy_accounts_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+      snapshot->read_section<account_object>([this]( auto& section ) {
+         bool more = !section.empty();
+         while(more) {
+            legacy::snapshot_account_object_v1 row;
+            more = section.read_row(row, db);
+            db.create<account_object>([&]( auto& a ) {
+               a.name             = row.name;
+               a.vm_type          = row.vm_type;
+               a.vm_version       = row.vm_version;
+               a.privileged       = row.privileged;
+               a.last_code_update = row.last_code_update;
+               a.code_version     = row.code_version;
+               a.creation_date    = row.creation_date;
+               a.abi.assign(row.abi.data.data(), row.abi.data.size());
+            });
+            if (row.code.data.size() > 0) {
+               add_code_reference(db, row.code_version, row.code.data.data(), row.code.data.size());
+            }
+         }
+      });
    }
 
    sha256 calculate_integrity_hash() const {
@@ -589,6 +750,7 @@ struct controller_impl {
       head->block = std::make_shared<signed_block>(genheader.header);
       fork_db.set( head );
       db.set_revision( head->block_num );
+      trx_dedup.set_revision( head->block_num );
 
       initialize_database();
    }
@@ -624,6 +786,8 @@ struct controller_impl {
    }
 
    void initialize_database() {
+      db.create<database_header_object>([](auto&){});
+
       // Initialize block summary index
       for (int i = 0; i < 0x10000; i++)
          db.create<block_summary_object>([&](block_summary_object&) {});
@@ -684,10 +848,7 @@ struct controller_impl {
          }
 
          if( !replaying ) {
-            reversible_blocks.create<reversible_block_object>( [&]( auto& ubo ) {
-               ubo.blocknum = pending->_pending_block_state->block_num;
-               ubo.set_block( pending->_pending_block_state->block );
-            });
+            reversible_blocks.append( pending->_pending_block_state->block );
          }
 
          emit( self.accepted_block, pending->_pending_block_state );
@@ -706,7 +867,7 @@ struct controller_impl {
    fc::scoped_exit<std::function<void()>> make_block_restore_point() {
       auto orig_block_transactions_size = pending->_pending_block_state->block->transactions.size();
       auto orig_state_transactions_size = pending->_pending_block_state->trxs.size();
-      auto orig_state_actions_size      = pending->_actions.size();
+      auto orig_state_actions_size      = pending->_action_receipt_digests.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
@@ -715,7 +876,7 @@ struct controller_impl {
       {
          pending->_pending_block_state->block->transactions.resize(orig_block_transactions_size);
          pending->_pending_block_state->trxs.resize(orig_state_transactions_size);
-         pending->_actions.resize(orig_state_actions_size);
+         pending->_action_receipt_digests.resize(orig_state_actions_size);
       };
 
       return fc::make_scoped_exit( std::move(callback) );
@@ -753,7 +914,7 @@ struct controller_impl {
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
-         fc::move_append( pending->_actions, move(trx_context.executed) );
+         fc::move_append( pending->_action_receipt_digests, move(trx_context.executed_action_digests) );
 
          trx_context.squash();
          restore.cancel();
@@ -810,7 +971,7 @@ struct controller_impl {
    { try {
       maybe_session undo_session;
       if ( !self.skip_db_sessions() )
-         undo_session = maybe_session(db);
+         undo_session = maybe_session(db, trx_dedup);
 
       auto gtrx = generated_transaction(gto);
 
@@ -879,7 +1040,7 @@ struct controller_impl {
                                         trx_context.billed_cpu_time_us,
                                         trace->net_usage );
 
-         fc::move_append( pending->_actions, move(trx_context.executed) );
+         fc::move_append( pending->_action_receipt_digests, move(trx_context.executed_action_digests) );
 
          emit( self.accepted_transaction, trx );
          emit( self.applied_transaction, trace );
@@ -1055,7 +1216,7 @@ struct controller_impl {
                trace->receipt = r;
             }
 
-            fc::move_append(pending->_actions, move(trx_context.executed));
+            fc::move_append(pending->_action_receipt_digests, move(trx_context.executed_action_digests));
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1108,7 +1269,7 @@ struct controller_impl {
          EOS_ASSERT( db.revision() == head->block_num, database_exception, "db revision is not on par with head block",
                      ("db.revision()", db.revision())("controller_head_block", head->block_num)("fork_db_head_block", fork_db.head()->block_num) );
 
-         pending.emplace(maybe_session(db));
+         pending.emplace(maybe_session(db, trx_dedup));
       } else {
          pending.emplace(maybe_session());
       }
@@ -1128,7 +1289,7 @@ struct controller_impl {
          const auto& gpo = db.get<global_property_object>();
          if( gpo.proposed_schedule_block_num.valid() && // if there is a proposed schedule that was proposed in a block ...
              ( *gpo.proposed_schedule_block_num <= pending->_pending_block_state->dpos_irreversible_blocknum ) && // ... that has now become irreversible ...
-             pending->_pending_block_state->pending_schedule.producers.size() == 0 && // ... and there is room for a new pending schedule ...
+             pending->_pending_block_state->pending_schedule->producers.size() == 0 && // ... and there is room for a new pending schedule ...
              !was_pending_promoted // ... and not just because it was promoted to active at the start of this block, then:
          )
             {
@@ -1180,24 +1341,81 @@ struct controller_impl {
       static_cast<signed_block_header&>(*p->block) = p->header;
    } /// sign_block
 
-   void apply_block( const signed_block_ptr& b, controller::block_status s ) { try {
+   /**
+    *  Hands over the transaction metadata already attached to bsp when it was built from the packed transactions of
+    *  its own block (see read_ahead_block), otherwise returns nothing and leaves bsp untouched.
+    */
+   static vector<transaction_metadata_ptr> take_prepared_transactions( const block_state_ptr& bsp ) {
+      if( bsp->trxs.empty() )
+         return {};
+
+      auto itr = bsp->trxs.begin();
+      for( const auto& receipt : bsp->block->transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            if( itr == bsp->trxs.end() || (*itr)->packed_trx.get() != &receipt.trx.get<packed_transaction>() )
+               return {};
+            ++itr;
+         }
+      }
+      if( itr != bsp->trxs.end() )
+         return {};
+
+      vector<transaction_metadata_ptr> trxs;
+      trxs.swap( bsp->trxs );
+      return trxs;
+   }
+
+   /**
+    *  Returns the metadata of the transaction when it was already received on its own and is waiting in
+    *  unapplied_transactions, so that its id, unpacked body and recovered keys are not computed again. Lookup is by
+    *  signed_id which covers the signatures and context free data as well as the transaction itself.
+    *
+    *  The block gets metadata of its own sharing that state, since the unapplied transaction can still be pushed or
+    *  referred to on its own. Its accepted flag starts out clear, like that of every other transaction of the block.
+    */
+   transaction_metadata_ptr get_block_transaction_metadata( const packed_transaction& pt ) {
+      const auto signed_id = digest_type::hash( pt );
+      auto itr = unapplied_transactions.find( signed_id );
+      if( itr != unapplied_transactions.end() ) {
+         const auto& mtrx = itr->second;
+         auto result = std::make_shared<transaction_metadata>( mtrx->packed_trx, mtrx->id, mtrx->signed_id );
+         // waiting on a recovery still in progress would hold up the block, and one started with a deadline may
+         // have failed, which must not fail the block. In both cases only the unpacked transaction is shared and
+         // its keys are recovered with those of the rest of the block
+         if( mtrx->signing_keys_future.valid() &&
+             mtrx->signing_keys_future.wait_for( std::chrono::seconds(0) ) == std::future_status::ready ) {
+            try {
+               mtrx->signing_keys_future.get();
+               result->signing_keys_future   = mtrx->signing_keys_future;
+               result->signing_keys_chain_id = mtrx->signing_keys_chain_id;
+            } catch( ... ) {}
+         }
+         return result;
+      }
+      auto ptrx = std::make_shared<packed_transaction>( pt );
+      return std::make_shared<transaction_metadata>( ptrx, ptrx->id(), signed_id );
+   }
+
+   void apply_block( const block_state_ptr& bsp, controller::block_status s ) { try {
       try {
+         const signed_block_ptr& b = bsp->block;
          EOS_ASSERT( b->block_extensions.size() == 0, block_validate_exception, "no supported extensions" );
          auto producer_block_id = b->id();
          start_block( b->timestamp, b->confirmed, s , producer_block_id);
 
-         std::vector<transaction_metadata_ptr> packed_transactions;
-         packed_transactions.reserve( b->transactions.size() );
-         for( const auto& receipt : b->transactions ) {
-            if( receipt.trx.contains<packed_transaction>()) {
-               auto& pt = receipt.trx.get<packed_transaction>();
-               auto mtrx = std::make_shared<transaction_metadata>( std::make_shared<packed_transaction>( pt ) );
-               if( !self.skip_auth_check() ) {
-                  transaction_metadata::start_recover_keys( mtrx, thread_pool, chain_id, microseconds::maximum() );
+         std::vector<transaction_metadata_ptr> packed_transactions = take_prepared_transactions( bsp );
+         if( packed_transactions.empty() ) {
+            packed_transactions.reserve( b->transactions.size() );
+            for( const auto& receipt : b->transactions ) {
+               if( receipt.trx.contains<packed_transaction>()) {
+                  packed_transactions.emplace_back( get_block_transaction_metadata( receipt.trx.get<packed_transaction>() ) );
                }
-               packed_transactions.emplace_back( std::move( mtrx ) );
             }
          }
+         std::future<key_recovery_report> key_recovery;
+         if( !self.skip_auth_check() ) {
+            key_recovery = transaction_metadata::start_recover_keys( packed_transactions, thread_pool, chain_id, conf.thread_pool_size );
+         }
 
          transaction_trace_ptr trace;
 
@@ -1233,6 +1451,11 @@ struct controller_impl {
                         ("producer_receipt", receipt)("validator_receipt", pending->_pending_block_state->block->transactions.back()) );
          }
 
+         // every transaction waited for its keys, so this only waits for the report itself
+         last_key_recovery = key_recovery.valid() ? key_recovery.get() : key_recovery_report();
+         if( last_key_recovery.signatures > 0 )
+            dlog( "block ${n} key recovery: ${r}", ("n", b->block_num())("r", last_key_recovery) );
+
          finalize_block();
 
          // this implicitly asserts that all header fields (less the signature) are identical
@@ -1303,7 +1526,7 @@ struct controller_impl {
       } FC_LOG_AND_RETHROW( )
    }
 
-   void replay_push_block( const signed_block_ptr& b, controller::block_status s ) {
+   void replay_push_block( const signed_block_ptr& b, controller::block_status s, vector<transaction_metadata_ptr> trxs = {} ) {
       self.validate_db_available_size();
       self.validate_reversible_available_size();
 
@@ -1316,6 +1539,7 @@ struct controller_impl {
          emit( self.pre_accepted_block, b );
          const bool skip_validate_signee = !conf.force_all_checks;
          auto new_header_state = fork_db.add( b, skip_validate_signee );
+         new_header_state->trxs = std::move( trxs );
 
          emit( self.accepted_block_header, new_header_state );
 
@@ -1335,7 +1559,7 @@ struct controller_impl {
 
       if( new_head->header.previous == head->id ) {
          try {
-            apply_block( new_head->block, s );
+            apply_block( new_head, s );
             fork_db.mark_in_current_chain( new_head, true );
             fork_db.set_validity( new_head, true );
             head = new_head;
@@ -1358,10 +1582,10 @@ struct controller_impl {
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr ) {
             optional<fc::exception> except;
             try {
-               apply_block( (*ritr)->block, (*ritr)->validated ? controller::block_status::validated : controller::block_status::complete );
+               apply_block( *ritr, (*ritr)->validated ? controller::block_status::validated : controller::block_status::complete );
                head = *ritr;
                fork_db.mark_in_current_chain( *ritr, true );
-               (*ritr)->validated = true;
+               fork_db.set_validity( *ritr, true );
             }
             catch (const fc::exception& e) { except = e; }
             if (except) {
@@ -1383,7 +1607,7 @@ struct controller_impl {
 
                // re-apply good blocks
                for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr ) {
-                  apply_block( (*ritr)->block, controller::block_status::validated /* we previously validated these blocks*/ );
+                  apply_block( *ritr, controller::block_status::validated /* we previously validated these blocks*/ );
                   head = *ritr;
                   fork_db.mark_in_current_chain( *ritr, true );
                }
@@ -1410,22 +1634,22 @@ struct controller_impl {
    }
 
    void set_action_merkle() {
-      vector<digest_type> action_digests;
-      action_digests.reserve( pending->_actions.size() );
-      for( const auto& a : pending->_actions )
-         action_digests.emplace_back( a.digest() );
-
-      pending->_pending_block_state->header.action_mroot = merkle( move(action_digests) );
+      // the receipt digests were taken as the actions ran
+      pending->_pending_block_state->header.action_mroot =
+            merkle( move(pending->_action_receipt_digests), thread_pool, conf.thread_pool_size );
    }
 
    void set_trx_merkle() {
-      vector<digest_type> trx_digests;
       const auto& trxs = pending->_pending_block_state->block->transactions;
-      trx_digests.reserve( trxs.size() );
-      for( const auto& a : trxs )
-         trx_digests.emplace_back( a.digest() );
+      vector<digest_type> trx_digests( trxs.size() );
+      run_in_ranges( thread_pool, trxs.size(), conf.thread_pool_size, config::merkle_pairs_per_chunk,
+                     [&trxs, &trx_digests]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            trx_digests[i] = trxs[i].digest();
+      });
 
-      pending->_pending_block_state->header.transaction_mroot = merkle( move(trx_digests) );
+      pending->_pending_block_state->header.transaction_mroot =
+            merkle( move(trx_digests), thread_pool, conf.thread_pool_size );
    }
 
 
@@ -1471,7 +1695,7 @@ struct controller_impl {
    } FC_CAPTURE_AND_RETHROW() }
 
    void update_producers_authority() {
-      const auto& producers = pending->_pending_block_state->active_schedule.producers;
+      const auto& producers = pending->_pending_block_state->active_schedule->producers;
 
       auto update_permission = [&]( auto& permission, auto threshold ) {
          auto auth = authority( threshold, {}, {});
@@ -1517,12 +1741,7 @@ struct controller_impl {
 
    void clear_expired_input_transactions() {
       //Look for expired transactions in the deduplication list, and remove them.
-      auto& transaction_idx = db.get_mutable_index<transaction_multi_index>();
-      const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-      auto now = self.pending_block_time();
-      while( (!dedupe_index.empty()) && ( now > fc::time_point(dedupe_index.begin()->expiration) ) ) {
-         transaction_idx.remove(*dedupe_index.begin());
-      }
+      trx_dedup.clear_expired( self.pending_block_time() );
    }
 
    bool sender_avoids_whitelist_blacklist_enforcement( account_name sender )const {
@@ -1751,8 +1970,12 @@ const chainbase::database& controller::db()const { return my->db; }
 
 chainbase::database& controller::mutable_db()const { return my->db; }
 
+transaction_dedup_store& controller::mutable_transaction_dedup_store()const { return my->trx_dedup; }
+
 const fork_database& controller::fork_db()const { return my->fork_db; }
 
+const transaction_dedup_store& controller::get_transaction_dedup_store()const { return my->trx_dedup; }
+
 
 void controller::start_block( block_timestamp_type when, uint16_t confirm_block_count) {
    validate_db_available_size();
@@ -1935,6 +2158,10 @@ signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  {
    return my->blog.read_block_by_num(block_num);
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+serialized_block_view controller::fetch_serialized_block_by_number( uint32_t block_num )const  { try {
+   return my->blog.read_serialized_block_by_num(block_num);
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 block_state_ptr controller::fetch_block_state_by_id( block_id_type id )const {
    auto state = my->fork_db.get_block(id);
    return state;
@@ -1990,13 +2217,13 @@ int64_t controller::set_proposed_producers( vector<producer_key> producers ) {
    decltype(sch.producers.cend()) end;
    decltype(end)                  begin;
 
-   if( my->pending->_pending_block_state->pending_schedule.producers.size() == 0 ) {
-      const auto& active_sch = my->pending->_pending_block_state->active_schedule;
+   if( my->pending->_pending_block_state->pending_schedule->producers.size() == 0 ) {
+      const producer_schedule_type& active_sch = my->pending->_pending_block_state->active_schedule;
       begin = active_sch.producers.begin();
       end   = active_sch.producers.end();
       sch.version = active_sch.version + 1;
    } else {
-      const auto& pending_sch = my->pending->_pending_block_state->pending_schedule;
+      const producer_schedule_type& pending_sch = my->pending->_pending_block_state->pending_schedule;
       begin = pending_sch.producers.begin();
       end   = pending_sch.producers.end();
       sch.version = pending_sch.version + 1;
@@ -2107,6 +2334,22 @@ wasm_interface& controller::get_wasm_interface() {
    return my->wasmif;
 }
 
+const wasm_interface& controller::get_wasm_interface()const {
+   return my->wasmif;
+}
+
+native_contract_registry& controller::get_native_contract_registry() {
+   return my->native_contracts;
+}
+
+const native_contract_registry& controller::get_native_contract_registry()const {
+   return my->native_contracts;
+}
+
+const key_recovery_report& controller::last_block_key_recovery()const {
+   return my->last_key_recovery;
+}
+
 const account_object& controller::get_account( account_name name )const
 { try {
    return my->db.get<account_object, by_name>(name);
@@ -2182,13 +2425,14 @@ void controller::validate_db_available_size() const {
 }
 
 void controller::validate_reversible_available_size() const {
-   const auto free = my->reversible_blocks.get_segment_manager()->get_free_memory();
+   const auto used = my->reversible_blocks.size_in_bytes();
+   const auto free = my->conf.reversible_cache_size > used ? my->conf.reversible_cache_size - used : 0;
    const auto guard = my->conf.reversible_guard_size;
    EOS_ASSERT(free >= guard, reversible_guard_exception, "reversible free: ${f}, guard size: ${g}", ("f", free)("g",guard));
 }
 
 bool controller::is_known_unexpired_transaction( const transaction_id_type& id) const {
-   return db().find<transaction_object, by_trx_id>(id);
+   return my->trx_dedup.contains(id);
 }
 
 void controller::set_subjective_cpu_leeway(fc::microseconds leeway) {
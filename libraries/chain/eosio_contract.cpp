@@ -12,6 +12,7 @@
 #include <eosio/chain/exceptions.hpp>
 
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/permission_object.hpp>
 #include <eosio/chain/permission_link_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
@@ -145,21 +146,28 @@ void apply_eosio_setcode(apply_context& context) {
    const auto& account = db.get<account_object,by_name>(act.account);
 
    int64_t code_size = (int64_t)act.code.size();
-   int64_t old_size  = (int64_t)account.code.size() * config::setcode_ram_bytes_multiplier;
+   int64_t old_size  = 0;
    int64_t new_size  = code_size * config::setcode_ram_bytes_multiplier;
 
    EOS_ASSERT( account.code_version != code_id, set_exact_code, "contract is already running this version of code" );
 
+   const digest_type old_code_id = account.code_version;
+   bool old_code_removed = false;
+
+   // every account is still billed for its own copy of the code, however many accounts share it
+   if( old_code_id != digest_type() ) {
+      old_size = (int64_t)db.get<code_object, by_code_hash>(old_code_id).code.size() * config::setcode_ram_bytes_multiplier;
+      old_code_removed = release_code_reference( db, old_code_id );
+   }
+   if( code_size > 0 ) {
+      add_code_reference( db, code_id, act.code.data(), code_size );
+   }
+
    db.modify( account, [&]( auto& a ) {
       /** TODO: consider whether a microsecond level local timestamp is sufficient to detect code version changes*/
       // TODO: update setcode message to include the hash, then validate it in validate
       a.last_code_update = context.control.pending_block_time();
       a.code_version = code_id;
-      if ( code_size > 0 ) {
-         a.code.assign(act.code.data(), code_size);
-      } else {
-         a.code.resize(0);
-      }
    });
 
    const auto& account_sequence = db.get<account_sequence_object, by_name>(act.account);
@@ -170,6 +178,11 @@ void apply_eosio_setcode(apply_context& context) {
    if (new_size != old_size) {
       context.add_ram_usage( act.account, new_size - old_size );
    }
+
+   // other accounts may still run the old code, in which case its compiled module stays cached
+   if( old_code_removed ) {
+      context.control.get_wasm_interface().code_released( old_code_id );
+   }
 }
 
 void apply_eosio_setabi(apply_context& context) {
@@ -7,12 +7,57 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <cstring>
 #include <fstream>
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
    using namespace boost::multi_index;
 
+   namespace detail {
+      /**
+       * The fork database is persisted as a log of the changes made to it, each appended (and flushed) as it is made:
+       *
+       * +--------------+-------------------+-------------+----------------------------+
+       * | size: uint32 | checksum: uint64  | type: uint8 | packed fields of the type  |
+       * +--------------+-------------------+-------------+----------------------------+
+       *
+       * The size and checksum cover the type and fields. A record cut short or not matching its checksum can only
+       * be the last one written before a crash; the log is read up to it and truncated there. When enough records
+       * have been written since the log was last rewritten it is compacted into one add_state record per block
+       * state followed by the head, written to a new file that replaces the log.
+       */
+      enum class fork_db_record_type : uint8_t {
+         add_state             = 0, ///< block_state
+         remove_state          = 1, ///< block_id_type
+         set_head              = 2, ///< block_id_type
+         set_flags             = 3, ///< fork_db_flags_record
+         set_bft_irreversible  = 4, ///< fork_db_bft_record
+         add_confirmation      = 5, ///< header_confirmation
+      };
+
+      struct fork_db_flags_record {
+         block_id_type id;
+         bool          validated = false;
+         bool          in_current_chain = false;
+      };
+
+      struct fork_db_bft_record {
+         block_id_type id;
+         uint32_t      bft_irreversible_blocknum = 0;
+      };
+
+      /// records written since the log was last rewritten before it is compacted, at least
+      const uint64_t fork_db_compaction_min_records = 1024;
+   }
+} }
+
+FC_REFLECT( eosio::chain::detail::fork_db_flags_record, (id)(validated)(in_current_chain) )
+FC_REFLECT( eosio::chain::detail::fork_db_bft_record, (id)(bft_irreversible_blocknum) )
+
+namespace eosio { namespace chain {
+   using detail::fork_db_record_type;
+
 
    struct by_block_id;
    struct by_block_num;
@@ -46,8 +91,153 @@ namespace eosio { namespace chain {
       fork_multi_index_type index;
       block_state_ptr       head;
       fc::path              datadir;
+      std::ofstream         log;          ///< only open while changes are to be recorded
+      uint64_t              log_records = 0; ///< records in the log, which replay to the current index
+
+      fc::path log_path()const { return datadir / config::forkdb_log_filename; }
+
+      template<typename T>
+      void write_record( fork_db_record_type type, const T& fields ) {
+         if( !log.is_open() ) return;
+
+         bytes payload( sizeof(uint8_t) + fc::raw::pack_size( fields ) );
+         fc::datastream<char*> ds( payload.data(), payload.size() );
+         fc::raw::pack( ds, static_cast<uint8_t>(type) );
+         fc::raw::pack( ds, fields );
+
+         const uint32_t size  = payload.size();
+         const uint64_t check = fc::sha256::hash( payload.data(), size )._hash[0];
+         log.write( (const char*)&size, sizeof(size) );
+         log.write( (const char*)&check, sizeof(check) );
+         log.write( payload.data(), size );
+         ++log_records;
+      }
+
+      void record_head() {
+         write_record( fork_db_record_type::set_head, head ? head->id : block_id_type() );
+      }
+
+      void record_flags( const block_state_ptr& s ) {
+         write_record( fork_db_record_type::set_flags, detail::fork_db_flags_record{ s->id, s->validated, s->in_current_chain } );
+      }
+
+      /// makes the changes recorded so far survive the process, called at the end of each change to the fork database
+      void flush_log() {
+         if( log.is_open() ) log.flush();
+      }
+
+      void read_log();
+      void apply_record( fc::datastream<const char*>& ds );
+      void compact_log();
+      void maybe_compact_log() {
+         if( log.is_open() && log_records > std::max<uint64_t>( detail::fork_db_compaction_min_records, 4 * (index.size() + 1) ) )
+            compact_log();
+      }
    };
 
+   void fork_database_impl::read_log() {
+      string content;
+      fc::read_file_contents( log_path(), content );
+
+      uint64_t pos = 0;
+      while( pos < content.size() ) {
+         uint32_t size = 0;
+         uint64_t check = 0;
+         if( content.size() - pos < sizeof(size) + sizeof(check) ) break;
+         memcpy( &size, content.data() + pos, sizeof(size) );
+         memcpy( &check, content.data() + pos + sizeof(size), sizeof(check) );
+         const uint64_t payload_pos = pos + sizeof(size) + sizeof(check);
+         if( size == 0 || content.size() - payload_pos < size ||
+             fc::sha256::hash( content.data() + payload_pos, size )._hash[0] != check )
+            break;
+
+         fc::datastream<const char*> ds( content.data() + payload_pos, size );
+         apply_record( ds );
+         ++log_records;
+         pos = payload_pos + size;
+      }
+
+      if( pos < content.size() ) {
+         wlog( "Fork database log ends in ${n} bytes of an incomplete record, truncating it", ("n", content.size() - pos) );
+         fc::resize_file( log_path(), pos );
+      }
+   }
+
+   void fork_database_impl::apply_record( fc::datastream<const char*>& ds ) {
+      uint8_t type = 0;
+      fc::raw::unpack( ds, type );
+      switch( static_cast<fork_db_record_type>(type) ) {
+         case fork_db_record_type::add_state: {
+            auto s = std::make_shared<block_state>();
+            fc::raw::unpack( ds, *s );
+            EOS_ASSERT( index.insert( s ).second, fork_database_exception,
+                        "fork database log adds block state ${id} twice", ("id", s->id) );
+            break;
+         }
+         case fork_db_record_type::remove_state: {
+            block_id_type id;
+            fc::raw::unpack( ds, id );
+            index.erase( id );
+            break;
+         }
+         case fork_db_record_type::set_head: {
+            block_id_type id;
+            fc::raw::unpack( ds, id );
+            auto itr = index.find( id );
+            head = itr != index.end() ? *itr : block_state_ptr();
+            break;
+         }
+         case fork_db_record_type::set_flags: {
+            detail::fork_db_flags_record r;
+            fc::raw::unpack( ds, r );
+            auto itr = index.find( r.id );
+            if( itr != index.end() ) {
+               index.modify( itr, [&]( auto& bsp ) {
+                  bsp->validated = r.validated;
+                  bsp->in_current_chain = r.in_current_chain;
+               });
+            }
+            break;
+         }
+         case fork_db_record_type::set_bft_irreversible: {
+            detail::fork_db_bft_record r;
+            fc::raw::unpack( ds, r );
+            auto itr = index.find( r.id );
+            if( itr != index.end() ) {
+               index.modify( itr, [&]( auto& bsp ) {
+                  bsp->bft_irreversible_blocknum = r.bft_irreversible_blocknum;
+               });
+            }
+            break;
+         }
+         case fork_db_record_type::add_confirmation: {
+            header_confirmation c;
+            fc::raw::unpack( ds, c );
+            auto itr = index.find( c.block_id );
+            if( itr != index.end() )
+               (*itr)->add_confirmation( c );
+            break;
+         }
+         default:
+            EOS_THROW( fork_database_exception, "unknown fork database log record type ${t}", ("t", type) );
+      }
+   }
+
+   /// rewrites the log as the block states it holds, oldest first, and the head; the new log replaces the old at once
+   void fork_database_impl::compact_log() {
+      const auto tmp_path = datadir / (string(config::forkdb_log_filename) + ".tmp");
+      log.close();
+      log.open( tmp_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+      log_records = 0;
+      for( const auto& s : index.get<by_block_num>() )
+         write_record( fork_db_record_type::add_state, *s );
+      record_head();
+      log.close();
+
+      fc::rename( tmp_path, log_path() );
+      log.open( log_path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+   }
+
 
    fork_database::fork_database( const fc::path& data_dir ):my( new fork_database_impl() ) {
       my->datadir = data_dir;
@@ -55,6 +245,15 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(my->datadir))
          fc::create_directories(my->datadir);
 
+      if( fc::exists( my->log_path() ) ) {
+         my->read_log();
+         if( !my->head && my->index.size() )
+            my->head = *my->index.get<by_lib_block_num>().begin();
+         my->log.open( my->log_path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+         return;
+      }
+
+      // the whole fork database written at shutdown by earlier versions, carried over into a new log
       auto fork_db_dat = my->datadir / config::forkdb_filename;
       if( fc::exists( fork_db_dat ) ) {
          string content;
@@ -71,26 +270,31 @@ namespace eosio { namespace chain {
          fc::raw::unpack( ds, head_id );
 
          my->head = get_block( head_id );
+      }
 
+      my->compact_log();
+      if( fc::exists( fork_db_dat ) )
          fc::remove( fork_db_dat );
-      }
+   }
+
+   void fork_database::suspend_log() {
+      if( !my->log.is_open() ) return;
+      my->log.close();
+      fc::remove( my->log_path() );
+   }
+
+   void fork_database::resume_log() {
+      if( my->log.is_open() ) return;
+      my->compact_log();
    }
 
    void fork_database::close() {
+      // every change is already in the log, which is left as it is now: the blocks pruned below stay in it so that
+      // the next block can still be built on the head once restarted
+      if( my->log.is_open() )
+         my->log.close();
       if( my->index.size() == 0 ) return;
 
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
-      for( const auto& s : my->index ) {
-         fc::raw::pack( out, *s );
-      }
-      if( my->head )
-         fc::raw::pack( out, my->head->id );
-      else
-         fc::raw::pack( out, block_id_type() );
-
       /// we don't normally indicate the head block as irreversible
       /// we cannot normally prune the lib if it is the head block because
       /// the next block needs to build off of the head block. We are exiting
@@ -116,11 +320,14 @@ namespace eosio { namespace chain {
          //FC_ASSERT( s->block_num == s->header.block_num() );
 
       EOS_ASSERT( result.second, fork_database_exception, "unable to insert block state, duplicate state detected" );
+      my->write_record( fork_db_record_type::add_state, *s );
       if( !my->head ) {
          my->head =  s;
       } else if( my->head->block_num < s->block_num ) {
          my->head =  s;
       }
+      my->record_head();
+      my->flush_log();
    }
 
    block_state_ptr fork_database::add( const block_state_ptr& n, bool skip_validate_previous ) {
@@ -135,15 +342,19 @@ namespace eosio { namespace chain {
 
       auto inserted = my->index.insert(n);
       EOS_ASSERT( inserted.second, fork_database_exception, "duplicate block added?" );
+      my->write_record( fork_db_record_type::add_state, *n );
 
       my->head = *my->index.get<by_lib_block_num>().begin();
+      my->record_head();
 
       auto lib    = my->head->dpos_irreversible_blocknum;
       auto oldest = *my->index.get<by_block_num>().begin();
 
       if( oldest->block_num < lib ) {
          prune( oldest );
+         my->maybe_compact_log();
       }
+      my->flush_log();
 
       return n;
    }
@@ -215,8 +426,10 @@ namespace eosio { namespace chain {
 
       for( uint32_t i = 0; i < remove_queue.size(); ++i ) {
          auto itr = my->index.find( remove_queue[i] );
-         if( itr != my->index.end() )
+         if( itr != my->index.end() ) {
             my->index.erase(itr);
+            my->write_record( fork_db_record_type::remove_state, remove_queue[i] );
+         }
 
          auto& previdx = my->index.get<by_prev>();
          auto  previtr = previdx.lower_bound(remove_queue[i]);
@@ -227,6 +440,8 @@ namespace eosio { namespace chain {
       }
       //wdump((my->index.size()));
       my->head = *my->index.get<by_lib_block_num>().begin();
+      my->record_head();
+      my->flush_log();
    }
 
    void fork_database::set_validity( const block_state_ptr& h, bool valid ) {
@@ -235,6 +450,10 @@ namespace eosio { namespace chain {
       } else {
          /// remove older than irreversible and mark block as valid
          h->validated = true;
+         if( my->index.find( h->id ) != my->index.end() ) {
+            my->record_flags( h );
+            my->flush_log();
+         }
       }
    }
 
@@ -249,6 +468,8 @@ namespace eosio { namespace chain {
       by_id_idx.modify( itr, [&]( auto& bsp ) { // Need to modify this way rather than directly so that Boost MultiIndex can re-sort
          bsp->in_current_chain = in_current_chain;
       });
+      my->record_flags( h );
+      my->flush_log();
    }
 
    void fork_database::prune( const block_state_ptr& h ) {
@@ -265,6 +486,7 @@ namespace eosio { namespace chain {
       if( itr != my->index.end() ) {
          irreversible(*itr);
          my->index.erase(itr);
+         my->write_record( fork_db_record_type::remove_state, h->id );
       }
 
       auto& numidx = my->index.get<by_block_num>();
@@ -301,11 +523,13 @@ namespace eosio { namespace chain {
       auto b = get_block( c.block_id );
       EOS_ASSERT( b, fork_db_block_not_found, "unable to find block id ${id}", ("id",c.block_id));
       b->add_confirmation( c );
+      my->write_record( fork_db_record_type::add_confirmation, c );
 
       if( b->bft_irreversible_blocknum < b->block_num &&
-         b->confirmations.size() >= ((b->active_schedule.producers.size() * 2) / 3 + 1) ) {
+         b->confirmations.size() >= ((b->active_schedule->producers.size() * 2) / 3 + 1) ) {
          set_bft_irreversible( c.block_id );
       }
+      my->flush_log();
    }
 
    /**
@@ -322,6 +546,7 @@ namespace eosio { namespace chain {
       idx.modify( itr, [&]( auto& bsp ) {
            bsp->bft_irreversible_blocknum = bsp->block_num;
       });
+      my->write_record( fork_db_record_type::set_bft_irreversible, detail::fork_db_bft_record{ id, block_num } );
 
       /** to prevent stack-overflow, we perform a bredth-first traversal of the
        * fork database. At each stage we iterate over the leafs from the prior stage
@@ -341,6 +566,7 @@ namespace eosio { namespace chain {
                  if( bsp->bft_irreversible_blocknum < block_num ) {
                     bsp->bft_irreversible_blocknum = block_num;
                     updated.push_back( bsp->id );
+                    my->write_record( fork_db_record_type::set_bft_irreversible, detail::fork_db_bft_record{ bsp->id, block_num } );
                  }
                });
                ++pitr;
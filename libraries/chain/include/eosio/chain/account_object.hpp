@@ -13,7 +13,7 @@
 namespace eosio { namespace chain {
 
    class account_object : public chainbase::object<account_object_type, account_object> {
-      OBJECT_CTOR(account_object,(code)(abi))
+      OBJECT_CTOR(account_object,(abi))
 
       id_type              id;
       account_name         name;
@@ -22,10 +22,9 @@ namespace eosio { namespace chain {
       bool                 privileged   = false;
 
       time_point           last_code_update;
-      digest_type          code_version;
+      digest_type          code_version; ///< hash of the code_object the account runs, empty when it has no code
       block_timestamp_type creation_date;
 
-      shared_blob    code;
       shared_blob    abi;
 
       void set_abi( const eosio::chain::abi_def& a ) {
@@ -75,11 +74,27 @@ namespace eosio { namespace chain {
       >
    >;
 
+   namespace legacy {
+      /// an account row of a version 1 snapshot, which still carried the account's code
+      struct snapshot_account_object_v1 {
+         account_name         name;
+         uint8_t              vm_type      = 0;
+         uint8_t              vm_version   = 0;
+         bool                 privileged   = false;
+         time_point           last_code_update;
+         digest_type          code_version;
+         block_timestamp_type creation_date;
+         blob                 code;
+         blob                 abi;
+      };
+   }
+
 } } // eosio::chain
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::account_object, eosio::chain::account_index)
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::account_sequence_object, eosio::chain::account_sequence_index)
 
 
-FC_REFLECT(eosio::chain::account_object, (name)(vm_type)(vm_version)(privileged)(last_code_update)(code_version)(creation_date)(code)(abi))
-FC_REFLECT(eosio::chain::account_sequence_object, (name)(recv_sequence)(auth_sequence)(code_sequence)(abi_sequence))
\ No newline at end of file
+FC_REFLECT(eosio::chain::account_object, (name)(vm_type)(vm_version)(privileged)(last_code_update)(code_version)(creation_date)(abi))
+FC_REFLECT(eosio::chain::account_sequence_object, (name)(recv_sequence)(auth_sequence)(code_sequence)(abi_sequence))
+FC_REFLECT(eosio::chain::legacy::snapshot_account_object_v1, (name)(vm_type)(vm_version)(privileged)(last_code_update)(code_version)(creation_date)(code)(abi))
@@ -7,9 +7,11 @@
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <fc/utility.hpp>
+#include <boost/container/small_vector.hpp>
 #include <sstream>
 #include <algorithm>
 #include <set>
+#include <unordered_map>
 
 namespace chainbase { class database; }
 
@@ -17,17 +19,20 @@ namespace eosio { namespace chain {
 
 class controller;
 class transaction_context;
+class code_object;
+
+namespace detail { struct contract_run_outcome; }
 
 class apply_context {
    private:
+      /**
+       * Every action carries six of these (one per index type) and most actions touch one or two of them, so nothing
+       * is allocated until a table or row is actually cached. Tables are few per action and kept in a flat map; rows
+       * can number in the thousands for a contract walking a table, so the reverse row lookup is hashed.
+       */
       template<typename T>
       class iterator_cache {
          public:
-            iterator_cache(){
-               _end_iterator_to_table.reserve(8);
-               _iterator_to_object.reserve(32);
-            }
-
             /// Returns end iterator of the table.
             int cache_table( const table_id_object& tobj ) {
                auto itr = _table_cache.find(tobj.id);
@@ -91,10 +96,10 @@ class apply_context {
             }
 
          private:
-            map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
+            flat_map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
             vector<const table_id_object*>                  _end_iterator_to_table;
             vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            unordered_map<const T*,int>                     _object_to_iterator;
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -444,6 +449,11 @@ class apply_context {
                secondary_key_helper_t::get(secondary, obj.secondary_key);
             }
 
+            /// forgets every table and row handed out, which is needed once they may have been moved
+            void clear_cache() {
+               itr_cache = iterator_cache<ObjectType>();
+            }
+
          private:
             apply_context&              context;
             iterator_cache<ObjectType>  itr_cache;
@@ -466,7 +476,6 @@ class apply_context {
       ,idx_double(*this)
       ,idx_long_double(*this)
       {
-         reset_console();
       }
 
 
@@ -481,6 +490,13 @@ class apply_context {
       bool cancel_deferred_transaction( const uint128_t& sender_id, account_name sender );
       bool cancel_deferred_transaction( const uint128_t& sender_id ) { return cancel_deferred_transaction(sender_id, receiver); }
 
+   private:
+
+      /// runs the receiver's code, or the native implementation registered for it
+      void run_contract( const account_object& a );
+      void run_contract_differential( const native_contract_registry::native_apply& native, const code_object& code );
+      void capture_outcome( detail::contract_run_outcome& outcome, int64_t except_code )const;
+
 
    /// Authorization methods:
    public:
@@ -518,12 +534,12 @@ class apply_context {
    public:
 
       void reset_console();
-      std::ostringstream& get_console_stream()            { return _pending_console_output; }
-      const std::ostringstream& get_console_stream()const { return _pending_console_output; }
+      std::ostringstream& get_console_stream();
+      string              get_pending_console_output()const;
 
       template<typename T>
       void console_append(T val) {
-         _pending_console_output << val;
+         get_console_stream() << val;
       }
 
       template<typename T, typename ...Ts>
@@ -558,6 +574,18 @@ class apply_context {
       const table_id_object& find_or_create_table( name code, name scope, name table, const account_name &payer );
       void                   remove_table( const table_id_object& tid );
 
+      /// A table looked up by this action; tid is nullptr for a table that did not exist when it was looked up
+      struct cached_table_id {
+         name                   code;
+         name                   scope;
+         name                   table;
+         const table_id_object* tid = nullptr;
+      };
+
+      cached_table_id*       find_cached_table_id( name code, name scope, name table );
+      void                   cache_table_id( name code, name scope, name table, const table_id_object* tid );
+      void                   clear_table_caches();
+
       int  db_store_i64( uint64_t code, uint64_t scope, uint64_t table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size );
 
 
@@ -599,10 +627,11 @@ class apply_context {
    private:
 
       iterator_cache<key_value_object>    keyval_cache;
-      vector<account_name>                _notified; ///< keeps track of new accounts to be notifed of current message
+      vector<cached_table_id>             _table_id_cache; ///< lookups of find_table, kept in step by find_or_create_table and remove_table
+      boost::container::small_vector<account_name, 4> _notified; ///< keeps track of new accounts to be notifed of current message
       vector<action>                      _inline_actions; ///< queued inline messages
       vector<action>                      _cfa_inline_actions; ///< queued inline messages
-      std::ostringstream                  _pending_console_output;
+      std::unique_ptr<std::ostringstream> _pending_console_output; ///< only created once something is printed
       flat_set<account_delta>             _account_ram_deltas; ///< flat_set of account_delta so json is an array of objects
 
       //bytes                               _cached_trx;
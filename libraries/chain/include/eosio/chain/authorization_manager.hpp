@@ -10,9 +10,12 @@
 
 #include <utility>
 #include <functional>
+#include <memory>
 
 namespace eosio { namespace chain {
 
+   namespace detail { struct satisfied_authority_cache; }
+
    class controller;
    struct updateauth;
    struct deleteauth;
@@ -25,6 +28,7 @@ namespace eosio { namespace chain {
          using permission_id_type = permission_object::id_type;
 
          explicit authorization_manager(controller& c, chainbase::database& d);
+         ~authorization_manager();
 
          void add_indices();
          void initialize_database();
@@ -118,10 +122,32 @@ namespace eosio { namespace chain {
 
          static std::function<void()> _noop_checktime;
 
+         struct satisfied_cache_stats {
+            uint64_t entries = 0;
+            uint64_t hits    = 0;
+            uint64_t misses  = 0;
+         };
+
+         satisfied_cache_stats get_satisfied_cache_stats()const;
+
       private:
          const controller&    _control;
          chainbase::database& _db;
 
+         /// permissions found satisfied by a set of keys, see check_satisfied
+         std::unique_ptr<detail::satisfied_authority_cache> _satisfied_cache;
+         /// the last label given to the permission table, see permission_version_object
+         uint64_t         _permission_versions_issued = 0;
+
+         uint64_t         permission_version()const;
+         void             bump_permission_version();
+
+         bool             check_satisfied( const permission_level& level,
+                                           fc::microseconds provided_delay,
+                                           const flat_set<public_key_type>& provided_keys,
+                                           const std::function<void()>& checktime,
+                                           flat_set<public_key_type>& used_keys )const;
+
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
          void             check_linkauth_authorization( const linkauth& link, const vector<permission_level>& auths )const;
@@ -135,3 +161,5 @@ namespace eosio { namespace chain {
    };
 
 } } /// namespace eosio::chain
+
+FC_REFLECT( eosio::chain::authorization_manager::satisfied_cache_stats, (entries)(hits)(misses) )
@@ -1,6 +1,7 @@
 #pragma once
 #include <eosio/chain/block_header.hpp>
 #include <eosio/chain/incremental_merkle.hpp>
+#include <eosio/chain/immutable_value.hpp>
 #include <future>
 
 namespace eosio { namespace chain {
@@ -8,6 +9,10 @@ namespace eosio { namespace chain {
 /**
  *  @struct block_header_state
  *  @brief defines the minimum state necessary to validate transaction headers
+ *
+ *  The schedules are immutable values shared with the parent state until a block changes them, so that the states of
+ *  a long run of reversible blocks do not each hold copies of them. The producer maps and the merkle change with
+ *  every block and are small, so each state has its own.
  */
 struct block_header_state {
     block_id_type                     id;
@@ -18,11 +23,11 @@ struct block_header_state {
     uint32_t                          bft_irreversible_blocknum = 0;
     uint32_t                          pending_schedule_lib_num = 0; /// last irr block num
     digest_type                       pending_schedule_hash;
-    producer_schedule_type            pending_schedule;
-    producer_schedule_type            active_schedule;
-    incremental_merkle                blockroot_merkle;
-    flat_map<account_name,uint32_t>   producer_to_last_produced;
-    flat_map<account_name,uint32_t>   producer_to_last_implied_irb;
+    immutable_value<producer_schedule_type>            pending_schedule;
+    immutable_value<producer_schedule_type>            active_schedule;
+    incremental_merkle                                 blockroot_merkle;
+    flat_map<account_name,uint32_t>                    producer_to_last_produced;
+    flat_map<account_name,uint32_t>                    producer_to_last_implied_irb;
     public_key_type                   block_signing_key;
     vector<uint8_t>                   confirm_count;
     vector<header_confirmation>       confirmations;
@@ -36,7 +41,7 @@ struct block_header_state {
     bool maybe_promote_pending();
 
 
-    bool                 has_pending_producers()const { return pending_schedule.producers.size(); }
+    bool                 has_pending_producers()const { return pending_schedule->producers.size(); }
     uint32_t             calc_dpos_last_irreversible()const;
     bool                 is_active_producer( account_name n )const;
 
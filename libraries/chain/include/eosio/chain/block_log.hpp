@@ -11,6 +11,42 @@ namespace eosio { namespace chain {
 
    namespace detail { class block_log_impl; }
 
+   /**
+    * The serialized bytes of a block as they are stored in the block log, read in place from a mapping of the log.
+    * The view holds on to that mapping (or, for a block of a compressed retained file, to the decompressed copy), so
+    * it stays valid however the log grows, is remapped or has files retained while it is held.
+    */
+   class serialized_block_view {
+      public:
+         serialized_block_view() = default;
+
+         const char* data()const { return _data; }
+         size_t      size()const { return _size; }
+         explicit operator bool()const { return _data != nullptr; }
+
+         signed_block_ptr unpack()const;
+
+      private:
+         friend class detail::block_log_impl;
+
+         std::shared_ptr<const void> _owner;
+         const char*                 _data = nullptr;
+         size_t                      _size = 0;
+   };
+
+   struct block_log_config {
+      /// blocks.log is moved to a retained file every this many blocks, the default never splits it
+      uint32_t stride = std::numeric_limits<uint32_t>::max();
+      /// retained files beyond this many, oldest first, are moved to archive_dir or removed when it is empty
+      uint32_t max_retained_files = std::numeric_limits<uint32_t>::max();
+      /// relative paths are relative to the blocks directory
+      fc::path archive_dir;
+      /// compress each block of retained files on its own, so they stay randomly readable
+      bool     compress_retained_files = false;
+      /// appended blocks are written by a thread of the log, at most this many waiting at a time; 0 writes them in append
+      uint32_t write_queue_size = 0;
+   };
+
    /* The block log is an external append only log of the blocks with a header. Blocks should only
     * be written to the log after they irreverisble as the log is append only. The log is a doubly
     * linked list of blocks. There is a secondary index file of only block positions that enables
@@ -34,15 +70,37 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Reads go through a read only memory mapping of both files rather than through the streams used to write them,
+    * so any number of threads can read blocks concurrently and without locking. A mapping covers the files as they
+    * were when it was made; a read past its end (a block appended since) replaces it with a fresh one. Reading is
+    * only safe alongside append, not alongside reset or reopening the log.
+    *
+    * With a stride configured, blocks.log is split as it grows: when the block after a multiple of the stride is
+    * appended, blocks.log and its index are first renamed to blocks-<first>-<last>.log/.index and blocks.log starts
+    * over with that block. The new blocks.log is written in full before the old one is renamed, so a crash during the
+    * switch is completed or undone when the log is opened. With compression, a thread of the log then rewrites the
+    * retained file with each block compressed and swaps it in. Retained files are read through their own mappings and
+    * found again when the log is opened; the oldest are archived or removed once there are more than
+    * max_retained_files of them. blocks.log holds the head block, except right after it started over, when the head is
+    * the last block of the newest retained file; reset keeps the retained files the new log carries on from.
+    *
+    * With a write queue size configured, append only packs the block and queues it for a writer thread, waiting
+    * while the queue is full. The writer writes everything queued as one batch and flushes once per batch. Queued
+    * blocks are read from the queue until they are flushed; head() is the last block appended and readable_head_num()
+    * the last one flushed. A crash loses the queued blocks, and a log left ending in a partly written block is cut back
+    * to its last complete block when it is opened, so a block must be kept elsewhere until it is readable.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         block_log(const fc::path& data_dir, const block_log_config& config = block_log_config());
          block_log(block_log&& other);
          ~block_log();
 
+         /// @return the position of the block, or npos if it was queued for the writer thread
          uint64_t append(const signed_block_ptr& b);
+         /// waits for the writer thread to write every queued block, if there is one
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block, uint32_t first_block_num = 1 );
 
@@ -53,12 +111,20 @@ namespace eosio { namespace chain {
          }
 
          /**
-          * Return offset of block in file, or block_log::npos if it does not exist.
+          * Return the serialized block as stored in the log without decoding it, or an empty view if it is not in the log.
+          */
+         serialized_block_view read_serialized_block_by_num(uint32_t block_num)const;
+
+         /**
+          * Return offset of block in blocks.log, or block_log::npos if it is not in it (including blocks in retained files).
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
+         /// the first block in the log, including retained files
          uint32_t                first_block_num() const;
+         /// the last block flushed to the files, behind head() while blocks are queued for the writer thread
+         uint32_t                readable_head_num() const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
@@ -77,3 +143,5 @@ namespace eosio { namespace chain {
    };
 
 } }
+
+FC_REFLECT( eosio::chain::block_log_config, (stride)(max_retained_files)(archive_dir)(compress_retained_files)(write_queue_size) )
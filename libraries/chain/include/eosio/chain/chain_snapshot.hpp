@@ -12,10 +12,11 @@ struct chain_snapshot_header {
    /**
     * Version history
     *   1: initial version
+    *   2: account code moved out of the account rows into a section of code_object rows
     */
 
    static constexpr uint32_t minimum_compatible_version = 1;
-   static constexpr uint32_t current_version = 1;
+   static constexpr uint32_t current_version = 2;
 
    uint32_t version = current_version;
 
@@ -0,0 +1,44 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/database_utils.hpp>
+
+#include "multi_index_includes.hpp"
+
+namespace eosio { namespace chain {
+
+   /**
+    * A contract's code, stored once however many accounts run it. Accounts refer to it by code_hash through their
+    * account_object::code_version, and the object goes away with the last account that refers to it.
+    */
+   class code_object : public chainbase::object<code_object_type, code_object> {
+      OBJECT_CTOR(code_object,(code))
+
+      id_type      id;
+      digest_type  code_hash;
+      shared_blob  code;
+      uint64_t     code_ref_count = 0;
+   };
+
+   struct by_code_hash;
+   using code_index = chainbase::shared_multi_index_container<
+      code_object,
+      indexed_by<
+         ordered_unique<tag<by_id>, member<code_object, code_object::id_type, &code_object::id>>,
+         ordered_unique<tag<by_code_hash>, member<code_object, digest_type, &code_object::code_hash>>
+      >
+   >;
+
+   /// adds a reference to the code hashing to code_hash, storing the code if no account refers to it yet
+   void add_code_reference( chainbase::database& db, const digest_type& code_hash, const char* code, size_t code_size );
+
+   /// drops a reference to the code hashing to code_hash, removing the code with its last reference; returns whether it did
+   bool release_code_reference( chainbase::database& db, const digest_type& code_hash );
+
+} } // eosio::chain
+
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::code_object, eosio::chain::code_index)
+
+FC_REFLECT(eosio::chain::code_object, (code_hash)(code)(code_ref_count))
@@ -0,0 +1,15 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /// compresses with zlib at its fastest level, which is what the block log and snapshots store
+   bytes zlib_compress( const char* data, size_t size );
+
+   bytes zlib_decompress( const char* data, size_t size );
+
+} } /// namespace eosio::chain
@@ -14,11 +14,17 @@ typedef __uint128_t uint128_t;
 
 const static auto default_blocks_dir_name    = "blocks";
 const static auto reversible_blocks_dir_name = "reversible";
+const static auto reversible_blocks_log_filename = "reversible_blocks.log";
 const static auto default_reversible_cache_size = 340*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
 const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
 
 const static auto default_state_dir_name     = "state";
+const static auto default_wasm_code_cache_dir_name = "code_cache";
 const static auto forkdb_filename            = "forkdb.dat";
+const static auto forkdb_log_filename        = "forkdb.log";
+const static auto trx_dedup_filename         = "trxdedup.dat";
+const static uint32_t snapshot_rows_per_part    = 64*1024;  ///< rows of an index in each part of its snapshot section
+const static uint32_t snapshot_tables_per_part  = 256;      ///< contract tables in each part of the contract_tables section
 const static auto default_state_size            = 1*1024*1024*1024ll;
 const static auto default_state_guard_size      =    128*1024*1024ll;
 
@@ -80,7 +86,10 @@ const static uint32_t   default_max_inline_action_size         = 4 * 1024;   //
 const static uint16_t   default_max_inline_action_depth        = 4;
 const static uint16_t   default_max_auth_depth                 = 6;
 const static uint32_t   default_sig_cpu_bill_pct               = 50 * percent_1; // billable percentage of signature recovery
+const static uint32_t   default_sig_recovery_cache_size        = 10000;
 const static uint16_t   default_controller_thread_pool_size    = 2;
+const static uint32_t   merkle_pairs_per_chunk                 = 1024; ///< smallest share of a merkle tree level hashed on a thread of its own
+const static uint16_t   default_replay_read_ahead_blocks       = 16;
 
 const static uint32_t   min_net_usage_delta_between_base_and_max_for_trx  = 10*1024;
 // Should be large enough to allow recovery from badly set blockchain parameters without a hard fork
@@ -94,8 +103,11 @@ const static uint32_t   overhead_per_account_ram_bytes     = 2*1024; ///< overhe
 const static uint32_t   setcode_ram_bytes_multiplier       = 10;     ///< multiplier on contract size to account for multiple copies and cached compilation
 
 const static uint32_t   hashing_checktime_block_size       = 10*1024;  /// call checktime from hashing intrinsic once per this number of bytes
+const static uint32_t   max_cached_table_ids_per_action    = 64;       ///< table lookups remembered by an apply_context, further tables go to the database
 
 const static eosio::chain::wasm_interface::vm_type default_wasm_runtime = eosio::chain::wasm_interface::vm_type::wabt;
+const static uint64_t   default_wasm_cache_size            = 512*1024*1024ll; ///< memory budget for instantiated contract code
+const static uint64_t   default_wasm_code_cache_size       = 1024*1024*1024ll; ///< disk budget for prepared contract code and its object code
 const static uint32_t   default_abi_serializer_max_time_ms = 15*1000; ///< default deadline for abi serialization methods
 
 /**
@@ -2,11 +2,13 @@
 #include <eosio/chain/block_state.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/genesis_state.hpp>
+#include <eosio/chain/block_log.hpp>
 #include <boost/signals2/signal.hpp>
 
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/native_contract_registry.hpp>
 
 namespace chainbase {
    class database;
@@ -36,6 +38,7 @@ namespace eosio { namespace chain {
    using unapplied_transactions_type = map<transaction_id_type, transaction_metadata_ptr>;
 
    class fork_database;
+   class transaction_dedup_store;
 
    enum class db_read_mode {
       SPECULATIVE,
@@ -61,13 +64,18 @@ namespace eosio { namespace chain {
             flat_set< pair<account_name, action_name> > action_blacklist;
             flat_set<public_key_type> key_blacklist;
             path                     blocks_dir             =  chain::config::default_blocks_dir_name;
+            block_log_config         blocks_log; ///< how the block log is split into retained files, never split by default
             path                     state_dir              =  chain::config::default_state_dir_name;
+            path                     wasm_code_cache_dir; ///< prepared contract code and its object code are persisted here across restarts, disabled when empty
+            uint64_t                 wasm_code_cache_size   =  chain::config::default_wasm_code_cache_size; ///< most bytes of entries kept in wasm_code_cache_dir
             uint64_t                 state_size             =  chain::config::default_state_size;
             uint64_t                 state_guard_size       =  chain::config::default_state_guard_size;
-            uint64_t                 reversible_cache_size  =  chain::config::default_reversible_cache_size;
+            uint64_t                 reversible_cache_size  =  chain::config::default_reversible_cache_size; ///< most bytes the reversible block log may hold
             uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             uint32_t                 sig_cpu_bill_pct       =  chain::config::default_sig_cpu_bill_pct;
+            uint32_t                 sig_recovery_cache_size = chain::config::default_sig_recovery_cache_size; ///< recovered keys kept across the process, 0 disables
             uint16_t                 thread_pool_size       =  chain::config::default_controller_thread_pool_size;
+            uint16_t                 replay_read_ahead_blocks = chain::config::default_replay_read_ahead_blocks; ///< blocks decoded ahead of the one being replayed, 0 disables
             bool                     read_only              =  false;
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
@@ -76,6 +84,9 @@ namespace eosio { namespace chain {
 
             genesis_state            genesis;
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
+            uint64_t                 wasm_cache_size        =  chain::config::default_wasm_cache_size;
+            wasm_interface::tiering_policy wasm_tiering; ///< only used by the tiered runtime
+            native_contract_registry::mode native_contract_mode = native_contract_registry::mode::disabled;
 
             db_read_mode             read_mode              = db_read_mode::SPECULATIVE;
             validation_mode          block_validation_mode  = validation_mode::FULL;
@@ -141,6 +152,8 @@ namespace eosio { namespace chain {
 
          const fork_database& fork_db()const;
 
+         const transaction_dedup_store& get_transaction_dedup_store()const;
+
          const account_object&                 get_account( account_name n )const;
          const global_property_object&         get_global_properties()const;
          const dynamic_global_property_object& get_dynamic_global_properties()const;
@@ -188,6 +201,8 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// the irreversible block as serialized in the block log, empty if it is not in the block log; safe to call from any thread
+         serialized_block_view fetch_serialized_block_by_number( uint32_t block_num )const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
@@ -255,6 +270,12 @@ namespace eosio { namespace chain {
 
          const apply_handler* find_apply_handler( account_name contract, scope_name scope, action_name act )const;
          wasm_interface& get_wasm_interface();
+         const wasm_interface& get_wasm_interface()const;
+         native_contract_registry& get_native_contract_registry();
+         const native_contract_registry& get_native_contract_registry()const;
+
+         /// what recovering the signing keys of the last block applied cost, empty when its signatures were not checked
+         const key_recovery_report& last_block_key_recovery()const;
 
 
          optional<abi_serializer> get_abi_serializer( account_name n, const fc::microseconds& max_serialization_time )const {
@@ -283,6 +304,7 @@ namespace eosio { namespace chain {
          friend class transaction_context;
 
          chainbase::database& mutable_db()const;
+         transaction_dedup_store& mutable_transaction_dedup_store()const;
 
          std::unique_ptr<controller_impl> my;
 
@@ -296,15 +318,23 @@ FC_REFLECT( eosio::chain::controller::config,
             (contract_whitelist)
             (contract_blacklist)
             (blocks_dir)
+            (blocks_log)
             (state_dir)
+            (wasm_code_cache_dir)
+            (wasm_code_cache_size)
             (state_size)
             (reversible_cache_size)
+            (sig_recovery_cache_size)
+            (replay_read_ahead_blocks)
             (read_only)
             (force_all_checks)
             (disable_replay_opts)
             (contracts_console)
             (genesis)
             (wasm_runtime)
+            (wasm_cache_size)
+            (wasm_tiering)
+            (native_contract_mode)
             (resource_greylist)
             (trusted_producers)
           )
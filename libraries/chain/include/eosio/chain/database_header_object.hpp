@@ -0,0 +1,51 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/database_utils.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include "multi_index_includes.hpp"
+
+namespace eosio { namespace chain {
+
+   /**
+    * The version of the layout of the objects in the state database. It is not part of snapshots: a database loaded
+    * from a snapshot or built by replaying the block log is always of the current version.
+    *
+    * Version history:
+    *   - none: account_object kept the code of its contract
+    *   - 1: contract code is kept once per hash in code_object rows
+    *   - 2: the ids of unexpired transactions are kept in the transaction_dedup_store instead of transaction_object
+    *        rows; the rows of a version 1 database are not carried over
+    */
+   class database_header_object : public chainbase::object<database_header_object_type, database_header_object> {
+      OBJECT_CTOR(database_header_object)
+
+      static constexpr uint32_t current_version = 2;
+      static constexpr uint32_t minimum_version = 2;
+
+      id_type   id;
+      uint32_t  version = current_version;
+
+      void validate()const {
+         EOS_ASSERT( version >= minimum_version && version <= current_version, bad_database_version_exception,
+                     "state database version ${version} is not supported, supported versions are ${min} to ${max}; "
+                     "restore from a snapshot or replay the blockchain",
+                     ("version", version)("min", minimum_version)("max", current_version) );
+      }
+   };
+
+   using database_header_multi_index = chainbase::shared_multi_index_container<
+      database_header_object,
+      indexed_by<
+         ordered_unique<tag<by_id>, member<database_header_object, database_header_object::id_type, &database_header_object::id>>
+      >
+   >;
+
+} } // eosio::chain
+
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::database_header_object, eosio::chain::database_header_multi_index)
+
+FC_REFLECT(eosio::chain::database_header_object, (version))
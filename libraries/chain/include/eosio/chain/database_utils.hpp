@@ -28,6 +28,38 @@ namespace eosio { namespace chain {
             }
          }
 
+         /// the number of parts of about rows_per_part rows each that walk_part divides the index into
+         static uint32_t part_count( const chainbase::database& db, uint64_t rows_per_part ) {
+            auto const& index = db.get_index<Index>().indices();
+            rows_per_part = std::max<uint64_t>( rows_per_part, 1 );
+            return std::max<uint64_t>( 1, std::min<uint64_t>( (index.size() + rows_per_part - 1) / rows_per_part,
+                                                              std::numeric_limits<uint32_t>::max() ) );
+         }
+
+         /**
+          * Walks one of the given number of parts the index is divided into, each a range of consecutive ids, which
+          * together walk the whole index in order. The parts may be walked at once from several threads as long as the
+          * database is not changed meanwhile.
+          */
+         template<typename F>
+         static void walk_part( const chainbase::database& db, uint32_t part, uint32_t parts, F function ) {
+            auto const& index = db.get_index<Index>().indices();
+            if( index.empty() ) {
+               return;
+            }
+            using id_type = typename Index::value_type::id_type;
+            const int64_t  first = index.begin()->id._id;
+            const uint64_t span  = uint64_t(index.rbegin()->id._id - first) + 1;
+            auto bound = [&]( uint64_t p ) {
+               return id_type( first + int64_t( (span / parts) * p + std::min<uint64_t>( span % parts, p ) ) );
+            };
+            auto itr = index.lower_bound( bound( part ) );
+            auto end = part + 1 < parts ? index.lower_bound( bound( part + 1 ) ) : index.end();
+            for( ; itr != end; ++itr ) {
+               function(*itr);
+            }
+         }
+
          template<typename Secondary, typename Key, typename F>
          static void walk_range( const chainbase::database& db, const Key& begin_key, const Key& end_key, F function ) {
             const auto& idx = db.get_index<Index, Secondary>();
@@ -18,6 +18,11 @@ namespace eosio { namespace chain {
     * database tracks the longest chain and the last irreversible block number. All
     * blocks older than the last irreversible block are freed after emitting the
     * irreversible signal.
+    *
+    * Every change is appended to a log in the data directory as it is made, so the
+    * fork database survives a crash and closing it writes nothing. The log is
+    * compacted as blocks become irreversible and replayed on construction, which
+    * loads every block state it holds; they are not loaded lazily.
     */
    class fork_database {
       public:
@@ -64,6 +69,14 @@ namespace eosio { namespace chain {
          void mark_in_current_chain( const block_state_ptr& h, bool in_current_chain );
          void prune( const block_state_ptr& h );
 
+         /**
+          * Stops recording changes, while replaying blocks from the block log. The log is removed, as it no
+          * longer describes the fork database once a block is replayed.
+          */
+         void suspend_log();
+         /// writes the fork database as one compacted log and records changes again
+         void resume_log();
+
          /**
           * This signal is emited when a block state becomes irreversible, once irreversible
           * it is removed unless it is the head block.
@@ -0,0 +1,87 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <fc/io/raw.hpp>
+#include <fc/variant.hpp>
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   /**
+    * A value that is never changed once made, held by reference count so that copies of it share one instance. Each
+    * block_header_state is made from its parent's, and the parts that did not change with the block (the producer
+    * schedules, most of the time) are then the very same objects in both rather than copies.
+    *
+    * Changing the value makes a new instance for this holder alone; every other holder keeps the one it had.
+    */
+   template<typename T>
+   class immutable_value {
+      public:
+         /// all default constructed values share a single instance
+         immutable_value() : _value( default_instance() ) {}
+         immutable_value( const T& v ) : _value( std::make_shared<const T>( v ) ) {}
+         immutable_value( T&& v ) : _value( std::make_shared<const T>( std::move( v ) ) ) {}
+
+         immutable_value& operator=( const T& v ) {
+            _value = std::make_shared<const T>( v );
+            return *this;
+         }
+         immutable_value& operator=( T&& v ) {
+            _value = std::make_shared<const T>( std::move( v ) );
+            return *this;
+         }
+
+         const T& operator*()const  { return *_value; }
+         const T* operator->()const { return _value.get(); }
+         operator const T&()const   { return *_value; }
+
+         /// replaces the value with a copy of it changed by f
+         template<typename Function>
+         void modify( Function&& f ) {
+            auto v = std::make_shared<T>( *_value );
+            f( *v );
+            _value = std::move( v );
+         }
+
+         bool shares_instance_with( const immutable_value& other )const { return _value == other._value; }
+
+      private:
+         static const std::shared_ptr<const T>& default_instance() {
+            static const std::shared_ptr<const T> instance = std::make_shared<const T>();
+            return instance;
+         }
+
+         std::shared_ptr<const T> _value;
+   };
+
+} } /// namespace eosio::chain
+
+namespace fc {
+   template<typename T>
+   void to_variant( const eosio::chain::immutable_value<T>& v, fc::variant& vo ) {
+      to_variant( *v, vo );
+   }
+
+   template<typename T>
+   void from_variant( const fc::variant& v, eosio::chain::immutable_value<T>& iv ) {
+      T value;
+      from_variant( v, value );
+      iv = std::move( value );
+   }
+
+   namespace raw {
+      template<typename Stream, typename T>
+      void pack( Stream& s, const eosio::chain::immutable_value<T>& v ) {
+         fc::raw::pack( s, *v );
+      }
+
+      template<typename Stream, typename T>
+      void unpack( Stream& s, eosio::chain::immutable_value<T>& v ) {
+         T value;
+         fc::raw::unpack( s, value );
+         v = std::move( value );
+      }
+   }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/types.hpp>
+#include <boost/asio/thread_pool.hpp>
 
 namespace eosio { namespace chain {
 
@@ -19,4 +20,10 @@ namespace eosio { namespace chain {
     */
    digest_type merkle( vector<digest_type> ids );
 
+   /**
+    *  Same root as merkle( ids ), with the levels large enough to be worth it hashed in up to max_chunks ranges
+    *  spread over thread_pool. Must not be called from a thread of thread_pool.
+    */
+   digest_type merkle( vector<digest_type> ids, boost::asio::thread_pool& thread_pool, uint32_t max_chunks );
+
 } } /// eosio::chain
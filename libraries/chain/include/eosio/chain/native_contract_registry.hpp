@@ -0,0 +1,55 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <functional>
+#include <istream>
+
+namespace eosio { namespace chain {
+
+   class apply_context;
+
+   /**
+    * Native C++ implementations of contracts, each keyed by the hash of the exact code it stands in for. An
+    * implementation only ever runs in place of that code, so redeploying or upgrading a contract silently falls back
+    * to WASM. Implementations must leave the same state and produce the same trace as the code they replace.
+    *
+    * In differential mode both run: the native implementation first, in an undo session it leaves nothing behind
+    * from, then the WASM code, whose outcome is the one kept. Any difference in their outcomes (state changes,
+    * notifications, inline actions, RAM deltas, console output, failure) is logged and counted.
+    */
+   class native_contract_registry {
+      public:
+         enum class mode {
+            disabled,     ///< always run the WASM code
+            enabled,      ///< run a matching native implementation instead of the WASM code
+            differential  ///< run both and compare, keeping the WASM outcome
+         };
+
+         using native_apply = std::function<void(apply_context&)>;
+
+         /// registering a second implementation for the same code is an error
+         void register_contract( const digest_type& code_id, native_apply apply );
+
+         /// @return the implementation standing in for code_id, nullptr when there is none or the registry is disabled
+         const native_apply* find( const digest_type& code_id )const;
+
+         void     set_mode( mode m ) { _mode = m; }
+         mode     get_mode()const    { return _mode; }
+
+         uint64_t mismatches()const  { return _mismatches; }
+         void     record_mismatch()  { ++_mismatches; }
+
+      private:
+         flat_map<digest_type, native_apply> _contracts;
+         mode                                _mode = mode::disabled;
+         uint64_t                            _mismatches = 0;
+   };
+
+   std::istream& operator>>( std::istream& in, native_contract_registry::mode& m );
+
+} } // eosio::chain
+
+FC_REFLECT_ENUM( eosio::chain::native_contract_registry::mode, (disabled)(enabled)(differential) )
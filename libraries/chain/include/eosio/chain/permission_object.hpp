@@ -112,6 +112,25 @@ namespace eosio { namespace chain {
       >
    >;
 
+   /**
+    * Labels the current contents of the permission table for the satisfied authority cache of authorization_manager.
+    * Creating, modifying or removing a permission gives it a label that was never used before, while undoing the
+    * change restores the label the permissions had. It is kept out of snapshots and the integrity hash.
+    */
+   class permission_version_object : public chainbase::object<permission_version_object_type, permission_version_object> {
+      OBJECT_CTOR(permission_version_object)
+
+      id_type           id;
+      uint64_t          version = 0;
+   };
+
+   using permission_version_index = chainbase::shared_multi_index_container<
+      permission_version_object,
+      indexed_by<
+         ordered_unique<tag<by_id>, member<permission_version_object, permission_version_object::id_type, &permission_version_object::id>>
+      >
+   >;
+
    namespace config {
       template<>
       struct billable_size<permission_object> { // Also counts memory usage of the associated permission_usage_object
@@ -123,8 +142,10 @@ namespace eosio { namespace chain {
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::permission_object, eosio::chain::permission_index)
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::permission_usage_object, eosio::chain::permission_usage_index)
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::permission_version_object, eosio::chain::permission_version_index)
 
 FC_REFLECT(eosio::chain::permission_object, (usage_id)(parent)(owner)(name)(last_updated)(auth))
 FC_REFLECT(eosio::chain::snapshot_permission_object, (parent)(owner)(name)(last_updated)(last_used)(auth))
 
 FC_REFLECT(eosio::chain::permission_usage_object, (last_used))
+FC_REFLECT(eosio::chain::permission_version_object, (version))
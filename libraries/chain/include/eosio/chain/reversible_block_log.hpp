@@ -0,0 +1,85 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/block.hpp>
+#include <fc/filesystem.hpp>
+#include <deque>
+#include <fstream>
+
+namespace eosio { namespace chain {
+
+   /**
+    * @class reversible_block_log
+    * @brief the blocks that have been applied but are not yet irreversible, in block number order
+    *
+    * The blocks are appended (and flushed) to a single file as they are committed. When blocks become irreversible
+    * a small record saying so is appended rather than the blocks being removed, and popping blocks off the head cuts
+    * the file back to where they started. Once the blocks no longer held take up more of the file than those held,
+    * the file is rewritten with only the blocks held.
+    *
+    * Opening the log reads the record headers only, so it does not depend on the size of the blocks; a record cut
+    * short by a crash is dropped and the file truncated before it. The checksum of a block is verified when it is read.
+    *
+    * A reversible block database of earlier versions found in the directory is carried over into a new log.
+    */
+   class reversible_block_log {
+      public:
+         explicit reversible_block_log( const fc::path& data_dir, bool read_only = false );
+         ~reversible_block_log();
+
+         /// the block must follow the last block held, unless the log is empty
+         void append( const signed_block_ptr& b );
+
+         /// removes the block with the given number and any after it
+         void truncate_from( uint32_t block_num );
+
+         /// removes the block with the given number and any before it, called when they become irreversible
+         void remove_through( uint32_t block_num );
+
+         /// @return the block with the given number, or a null pointer if it is not held
+         signed_block_ptr read_block_by_num( uint32_t block_num )const;
+
+         bool     empty()const           { return _entries.empty(); }
+         uint32_t size()const            { return _entries.size(); }
+         /// 0 when the log is empty
+         uint32_t first_block_num()const { return _first_block_num; }
+         /// 0 when the log is empty
+         uint32_t last_block_num()const  { return empty() ? 0 : _first_block_num + size() - 1; }
+         /// bytes of the file taken by the blocks held
+         uint64_t size_in_bytes()const   { return _live_bytes; }
+
+         /// true if opening the log found an incomplete or corrupted record at its end and dropped it
+         bool repaired()const            { return _repaired; }
+
+         void flush();
+
+      private:
+         struct entry {
+            uint64_t pos = 0;       ///< of the record in the file
+            uint32_t size = 0;      ///< of the packed block
+            uint64_t checksum = 0;  ///< of the packed block
+         };
+
+         fc::path log_path()const;
+         void     open_log();
+         void     scan();
+         void     migrate_database();
+         void     write_record( uint32_t block_num, uint64_t checksum, const char* data, uint32_t size );
+         void     truncate_file( uint64_t pos );
+         void     maybe_compact();
+         void     compact();
+
+         fc::path            _data_dir;
+         bool                _read_only = false;
+         bool                _repaired = false;
+         std::ofstream       _log;               ///< not open when read only
+         std::deque<entry>   _entries;
+         uint32_t            _first_block_num = 0;
+         uint64_t            _file_size = 0;
+         uint64_t            _live_bytes = 0;    ///< records of the blocks held
+         uint64_t            _first_record_pos = 0; ///< of the first block record in the file, 0 if there is none
+   };
+
+} } /// namespace eosio::chain
@@ -0,0 +1,61 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/config.hpp>
+#include <atomic>
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   namespace detail { struct signature_recovery_cache_shard; }
+
+   /**
+    * Public keys recovered from transaction signatures, so that a transaction seen more than once (when it is
+    * received and again when it is included in a block) only pays for the recovery the first time.
+    *
+    * Entries are spread by transaction id over independently locked shards, so that the key recovery workers of the
+    * controller thread pool seldom contend with each other. Each shard holds its share of the capacity and evicts its
+    * oldest entry when an insertion overflows it.
+    */
+   class signature_recovery_cache {
+      public:
+         struct stats {
+            uint64_t capacity  = 0;
+            uint64_t entries   = 0;
+            uint64_t hits      = 0;
+            uint64_t misses    = 0;
+            uint64_t evictions = 0;
+         };
+
+         static const uint32_t shard_count = 64;
+
+         explicit signature_recovery_cache( uint64_t capacity = config::default_sig_recovery_cache_size );
+         ~signature_recovery_cache();
+
+         /// the cache used by transaction::get_signature_keys
+         static signature_recovery_cache& instance();
+
+         /// a capacity of 0 disables the cache, a lowered capacity is enforced as the shards are inserted into
+         void     set_capacity( uint64_t capacity );
+         uint64_t capacity()const { return _capacity; }
+
+         bool find( const transaction_id_type& trx_id, const signature_type& sig,
+                    public_key_type& key, fc::microseconds& cpu_usage );
+         void add( const transaction_id_type& trx_id, const signature_type& sig,
+                   const public_key_type& key, fc::microseconds cpu_usage );
+
+         stats get_stats()const;
+
+      private:
+         detail::signature_recovery_cache_shard& shard_for( const transaction_id_type& trx_id )const;
+
+         std::unique_ptr<detail::signature_recovery_cache_shard[]> _shards;
+         std::atomic<uint64_t>                                     _capacity;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::signature_recovery_cache::stats, (capacity)(entries)(hits)(misses)(evictions) )
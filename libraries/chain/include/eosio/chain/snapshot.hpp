@@ -8,14 +8,24 @@
 #include <eosio/chain/exceptions.hpp>
 #include <fc/variant_object.hpp>
 #include <boost/core/demangle.hpp>
+#include <functional>
+#include <memory>
 #include <ostream>
 
 namespace eosio { namespace chain {
    /**
+    * Versions of the snapshot file format, the container the sections are stored in. They are independent of
+    * chain_snapshot_header::version, which is the version of the rows held in the sections.
+    *
     * History:
     * Version 1: initial version with string identified sections and rows
+    * Version 2: the rows of each section held as chunks, optionally zlib compressed, located through a directory of
+    *            the sections at the end of the snapshot
     */
-   static const uint32_t current_snapshot_version = 1;
+   static const uint32_t chunked_snapshot_format_version = 2;
+
+   /// the format the variant and the plain binary snapshots are written in, they hold each section as one run of rows
+   static const uint32_t unchunked_snapshot_format_version = 1;
 
    namespace detail {
       template<typename T>
@@ -71,9 +81,29 @@ namespace eosio { namespace chain {
          std::ostream& inner;
       };
 
+      /**
+       * Appends to a byte buffer, in place of the ostream_wrapper when the rows of a section are gathered into chunks
+       */
+      struct buffer_wrapper {
+         explicit buffer_wrapper(bytes& b)
+         :inner(b) {
+
+         }
+
+         void write( const char* d, size_t s ) {
+            inner.insert(inner.end(), d, d + s);
+         }
+
+         void put(char c) {
+            inner.push_back(c);
+         }
+
+         bytes& inner;
+      };
 
       struct abstract_snapshot_row_writer {
          virtual void write(ostream_wrapper& out) const = 0;
+         virtual void write(buffer_wrapper& out) const = 0;
          virtual void write(fc::sha256::encoder& out) const = 0;
          virtual variant to_variant() const = 0;
          virtual std::string row_type_name() const = 0;
@@ -93,6 +123,10 @@ namespace eosio { namespace chain {
             write_stream(out);
          }
 
+         void write(buffer_wrapper& out) const override {
+            write_stream(out);
+         }
+
          void write(fc::sha256::encoder& out) const override {
             write_stream(out);
          }
@@ -148,9 +182,41 @@ namespace eosio { namespace chain {
             write_section(detail::snapshot_section_traits<T>::section_name(), f);
          }
 
+         /**
+          * Writes a section whose rows are produced by f(part, section) for each part from 0 to parts - 1, the rows of
+          * all the parts making up the section in the order of the parts. A writer may call f for several parts at
+          * once from other threads, so f must only read shared state and each part must stand on its own.
+          */
+         template<typename F>
+         void write_section_parts(const std::string section_name, uint32_t parts, F f) {
+            write_start_section(section_name);
+            write_parts(parts, [&f]( uint32_t part, section_writer& section ) {
+               f(part, section);
+            });
+            write_end_section();
+         }
+
+         template<typename T, typename F>
+         void write_section_parts(uint32_t parts, F f) {
+            write_section_parts(detail::snapshot_section_traits<T>::section_name(), parts, f);
+         }
+
       virtual ~snapshot_writer(){};
 
       protected:
+         /// produces the parts of a section in order on the calling thread
+         virtual void write_parts( uint32_t parts, const std::function<void(uint32_t, section_writer&)>& f ) {
+            auto section = section_writer(*this);
+            for( uint32_t part = 0; part < parts; ++part ) {
+               f(part, section);
+            }
+         }
+
+         /// a section writer adding rows to the given writer, for writers gathering the rows of each part in a writer of its own
+         static section_writer make_section_writer( snapshot_writer& writer ) {
+            return section_writer(writer);
+         }
+
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
          virtual void write_end_section() = 0;
@@ -161,6 +227,7 @@ namespace eosio { namespace chain {
    namespace detail {
       struct abstract_snapshot_row_reader {
          virtual void provide(std::istream& in) const = 0;
+         virtual void provide(fc::datastream<const char*>& in) const = 0;
          virtual void provide(const fc::variant&) const = 0;
          virtual std::string row_type_name() const = 0;
       };
@@ -206,6 +273,12 @@ namespace eosio { namespace chain {
             });
          }
 
+         void provide(fc::datastream<const char*>& in) const override {
+            row_validation_helper::apply(data, [&in,this](){
+               fc::raw::unpack(in, data);
+            });
+         }
+
          void provide(const fc::variant& var) const override {
             row_validation_helper::apply(data, [&var,this]() {
                fc::from_variant(var, data);
@@ -366,6 +439,63 @@ namespace eosio { namespace chain {
          uint64_t       cur_row;
    };
 
+   struct sectioned_snapshot_writer_impl;
+   struct sectioned_snapshot_reader_impl;
+
+   /**
+    * Writes a version 2 snapshot: the rows of each section are gathered into chunks of about chunk_size bytes, each
+    * compressed on its own when compression is on, and a directory of the sections and their chunks is written at the
+    * end. Compression runs on a pool of the given number of threads while rows are gathered, and sections written in
+    * parts have their parts produced and compressed on the pool as well. A thread of the writer writes the chunks to
+    * the stream as they are sealed, compressing them itself when there is no pool, so the calling thread only reads
+    * the rows out of the state; the stream must not be touched until finalize returns.
+    *
+    * The stream must be seekable as the position of the directory is filled into the header by finalize.
+    */
+   class sectioned_snapshot_writer : public snapshot_writer {
+      public:
+         explicit sectioned_snapshot_writer(std::ostream& snapshot, uint32_t threads = 1, bool compress = false,
+                                            uint64_t chunk_size = default_chunk_size);
+         ~sectioned_snapshot_writer();
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         static const uint64_t default_chunk_size = 1024*1024;
+
+      protected:
+         void write_parts( uint32_t parts, const std::function<void(uint32_t, section_writer&)>& f ) override;
+
+      private:
+         std::unique_ptr<sectioned_snapshot_writer_impl> my;
+   };
+
+   /**
+    * Reads a version 2 snapshot. Each section is located through the directory rather than by walking the snapshot,
+    * and the chunks of the section being read are read ahead and decompressed on a pool of the given number of threads
+    * while the rows are handed out on the calling thread.
+    */
+   class sectioned_snapshot_reader : public snapshot_reader {
+      public:
+         explicit sectioned_snapshot_reader(std::istream& snapshot, uint32_t threads = 1);
+         ~sectioned_snapshot_reader();
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+
+      private:
+         std::unique_ptr<sectioned_snapshot_reader_impl> my;
+   };
+
+   /// a reader of the binary snapshot in the stream, whichever version it was written as
+   snapshot_reader_ptr make_istream_snapshot_reader( std::istream& snapshot, uint32_t threads = 1 );
+
    class integrity_hash_snapshot_writer : public snapshot_writer {
       public:
          explicit integrity_hash_snapshot_writer(fc::sha256::encoder&  enc);
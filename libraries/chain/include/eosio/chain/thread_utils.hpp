@@ -6,8 +6,11 @@
 
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <algorithm>
+#include <exception>
 #include <future>
 #include <memory>
+#include <vector>
 
 namespace eosio { namespace chain {
 
@@ -19,6 +22,45 @@ namespace eosio { namespace chain {
       return task->get_future();
    }
 
+   /**
+    * Calls f(begin, end) over consecutive ranges covering [0, size), using at most max_chunks ranges of at least
+    * min_range elements each. The calling thread takes the first range and the others are posted to thread_pool, so
+    * this must not be called from a thread of that pool. Returns once every range is done, rethrowing the first
+    * failure if any.
+    */
+   template<typename F>
+   void run_in_ranges( boost::asio::thread_pool& thread_pool, size_t size, size_t max_chunks, size_t min_range, F&& f ) {
+      if( size == 0 )
+         return;
+      const size_t chunks    = std::max<size_t>( 1, std::min<size_t>( max_chunks, size / std::max<size_t>( min_range, 1 ) ) );
+      const size_t per_chunk = (size + chunks - 1) / chunks;
+
+      std::vector<std::future<void>> others;
+      others.reserve( chunks - 1 );
+      for( size_t begin = per_chunk; begin < size; begin += per_chunk ) {
+         const size_t end = std::min( size, begin + per_chunk );
+         others.emplace_back( async_thread_pool( thread_pool, [&f, begin, end]() { f( begin, end ); } ) );
+      }
+
+      // every range refers to the caller's data, so all of them have to finish before anything is rethrown
+      std::exception_ptr failure;
+      try {
+         f( 0, std::min( size, per_chunk ) );
+      } catch( ... ) {
+         failure = std::current_exception();
+      }
+      for( auto& other : others ) {
+         try {
+            other.get();
+         } catch( ... ) {
+            if( !failure )
+               failure = std::current_exception();
+         }
+      }
+      if( failure )
+         std::rethrow_exception( failure );
+   }
+
 } } // eosio::chain
 
 
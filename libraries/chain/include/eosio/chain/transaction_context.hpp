@@ -1,6 +1,7 @@
 #pragma once
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/transaction_dedup_store.hpp>
 #include <signal.h>
 
 namespace eosio { namespace chain {
@@ -12,6 +13,7 @@ namespace eosio { namespace chain {
          void start(fc::time_point tp);
          void stop();
 
+         /// also read by running contract code in place of its poll flag (see wavm), so it lives as long as the process
          static volatile sig_atomic_t expired;
       private:
          static void timer_expired(int);
@@ -80,13 +82,14 @@ namespace eosio { namespace chain {
          const signed_transaction&     trx;
          transaction_id_type           id;
          optional<chainbase::database::session>  undo_session;
+         optional<transaction_dedup_store::session> dedup_undo_session;
          transaction_trace_ptr         trace;
          fc::time_point                start;
 
          fc::time_point                published;
 
 
-         vector<action_receipt>        executed;
+         vector<digest_type>           executed_action_digests; ///< digests of the receipts of the actions run so far, in order
          flat_set<account_name>        bill_to_accounts;
          flat_set<account_name>        validate_ram_usage;
 
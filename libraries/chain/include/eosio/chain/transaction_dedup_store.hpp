@@ -0,0 +1,138 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_set>
+
+namespace eosio { namespace chain {
+
+   /**
+    * The ids of the transactions included in blocks that have not expired yet, which is what new transactions are
+    * checked against to reject duplicates. Ids are grouped in buckets by the second they expire in: recording one is
+    * a hash insertion and an append to its bucket, and expiring them drops whole buckets. None of it lives in the
+    * chain state database, so that it neither grows that database nor goes through its undo sessions.
+    *
+    * Changes are tracked in undo sessions of its own, with the same semantics as chainbase ones. The controller
+    * starts, squashes, undoes and commits them alongside its database sessions so that both always sit at the same
+    * revision. The contents, pending sessions included, are written to a file in the state directory on close and
+    * read back (and the file removed) on construction, the same way as the fork database.
+    */
+   class transaction_dedup_store {
+      public:
+         class session {
+            public:
+               session( session&& s );
+               session& operator=( session&& s );
+               session( const session& ) = delete;
+               session& operator=( const session& ) = delete;
+               ~session();
+
+               /// keeps the changes, leaving them to be undone or committed through the store
+               void push();
+               void squash();
+               void undo();
+
+               int64_t revision()const { return _revision; }
+
+            private:
+               friend class transaction_dedup_store;
+               session( transaction_dedup_store& store, int64_t revision );
+
+               transaction_dedup_store* _store = nullptr;
+               bool                     _apply = false;
+               int64_t                  _revision = -1;
+         };
+
+         /// a recorded transaction, with the sequence number of its addition
+         struct entry {
+            uint64_t            seq = 0;
+            transaction_id_type id;
+         };
+
+         struct stats {
+            uint64_t transactions = 0;
+            uint64_t buckets = 0;
+            uint64_t undo_sessions = 0;
+            uint64_t undo_changes = 0;
+         };
+
+         /// a store without a data directory is neither read from nor written to a file
+         explicit transaction_dedup_store( const fc::path& data_dir = fc::path() );
+         ~transaction_dedup_store();
+
+         void close();
+
+         session start_undo_session( bool enabled );
+
+         /// @return false if id is already recorded, in which case nothing changes
+         bool add( const transaction_id_type& id, time_point_sec expiration );
+         bool contains( const transaction_id_type& id )const;
+
+         /// drops every transaction that expires before now
+         void clear_expired( time_point now );
+
+         void    undo();
+         void    squash();
+         void    commit( int64_t revision );
+         void    undo_all();
+         int64_t revision()const { return _revision; }
+         void    set_revision( int64_t revision );
+
+         stats get_stats()const;
+
+         /**
+          * visits each recorded transaction as (id, expiration) in the order they were added, which is the order the
+          * transaction_object rows of the chain state database were kept in, so snapshots list them the same way
+          */
+         template<typename Function>
+         void walk( Function&& f )const {
+            vector<std::pair<const entry*, uint32_t>> ordered;
+            ordered.reserve( _ids.size() );
+            for( const auto& b : _buckets ) {
+               for( const auto& e : b.second )
+                  ordered.emplace_back( &e, b.first );
+            }
+            std::sort( ordered.begin(), ordered.end(), []( const auto& a, const auto& b ) {
+               return a.first->seq < b.first->seq;
+            });
+            for( const auto& o : ordered )
+               f( o.first->id, time_point_sec( o.second ) );
+         }
+
+      private:
+         struct id_hash {
+            size_t operator()( const transaction_id_type& id )const { return id._hash[0]; }
+         };
+
+         /// an added id when expired is empty, otherwise a whole bucket dropped by clear_expired
+         struct change {
+            uint32_t                    expiration = 0;
+            transaction_id_type         id;
+            vector<entry>               expired;
+         };
+
+         struct undo_state {
+            int64_t        revision = 0;
+            vector<change> changes;
+         };
+
+         void record( change&& c );
+         void revert( change& c );
+
+         std::map<uint32_t, vector<entry>>                   _buckets;
+         std::unordered_set<transaction_id_type, id_hash>    _ids;
+         std::deque<undo_state>                              _stack;
+         int64_t                                             _revision = 0;
+         uint64_t                                            _next_seq = 0;
+         fc::path                                            _datadir;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::transaction_dedup_store::entry, (seq)(id) )
+FC_REFLECT( eosio::chain::transaction_dedup_store::stats, (transactions)(buckets)(undo_sessions)(undo_changes) )
@@ -19,6 +19,14 @@ using signing_keys_future_value_type = std::tuple<chain_id_type, fc::microsecond
 using signing_keys_future_type = std::shared_future<signing_keys_future_value_type>;
 using recovery_keys_type = std::pair<fc::microseconds, const flat_set<public_key_type>&>;
 
+/// what recovering the keys of a batch of transactions (typically those of a block) cost
+struct key_recovery_report {
+   uint32_t          transactions = 0;
+   uint32_t          signatures = 0;
+   fc::microseconds  cpu_time;  ///< summed over the worker threads
+   fc::microseconds  wall_time; ///< from the start of the batch until its last key was recovered
+};
+
 /**
  *  This data structure should store context-free cached data about a transaction such as
  *  packed/unpacked/compressed and recovered keys
@@ -29,6 +37,7 @@ class transaction_metadata {
       transaction_id_type                                        signed_id;
       packed_transaction_ptr                                     packed_trx;
       signing_keys_future_type                                   signing_keys_future;
+      optional<chain_id_type>                                    signing_keys_chain_id; ///< what signing_keys_future recovers for, known without waiting on it
       bool                                                       accepted = false;
       bool                                                       implicit = false;
       bool                                                       scheduled = false;
@@ -51,11 +60,26 @@ class transaction_metadata {
          signed_id = digest_type::hash(*packed_trx);
       }
 
+      /// for a transaction whose ids are already known, so that they are not computed again
+      transaction_metadata( const packed_transaction_ptr& ptrx, const transaction_id_type& id, const transaction_id_type& signed_id )
+      :id(id), signed_id(signed_id), packed_trx(ptrx) {
+      }
+
       // must be called from main application thread
       static signing_keys_future_type
       start_recover_keys( const transaction_metadata_ptr& mtrx, boost::asio::thread_pool& thread_pool,
                           const chain_id_type& chain_id, fc::microseconds time_limit );
 
+      /**
+       * Recovers the keys of all trxs in max_chunks tasks on the thread pool rather than one task per transaction.
+       * Transactions are dealt out in turn so that those applied first are recovered first. Transactions whose keys
+       * are already recovered, or being recovered, for chain_id are left alone.
+       * Must be called from main application thread.
+       */
+      static std::future<key_recovery_report>
+      start_recover_keys( const vector<transaction_metadata_ptr>& trxs, boost::asio::thread_pool& thread_pool,
+                          const chain_id_type& chain_id, uint32_t max_chunks );
+
       // start_recover_keys must be called first
       recovery_keys_type recover_keys( const chain_id_type& chain_id );
 
@@ -63,3 +87,5 @@ class transaction_metadata {
 };
 
 } } // eosio::chain
+
+FC_REFLECT( eosio::chain::key_recovery_report, (transactions)(signatures)(cpu_time)(wall_time) )
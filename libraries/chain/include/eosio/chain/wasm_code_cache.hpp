@@ -0,0 +1,94 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/wasm_interface.hpp>
+#include <fc/filesystem.hpp>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Contract code after it has been run through the eosio injections, along with the initial linear memory image
+    * built from its data segments. This is what the runtimes are handed on instantiation.
+    */
+   struct wasm_prepared_code {
+      digest_type          code_id;
+      std::vector<uint8_t> code;
+      std::vector<uint8_t> initial_memory;
+      std::vector<uint8_t> object_code; ///< generated by the native runtime from code, empty until it has been
+   };
+
+   /**
+    * On disk cache of prepared contract code and the object code WAVM generated for it. Entries are keyed by the
+    * code hash, the injection version, the runtime and the version of the runtime's code generator, so bumping any
+    * of the latter transparently invalidates everything previously written.
+    *
+    * Each entry lives in its own file which is written to a temporary name and then renamed into place, so a
+    * crash can at worst leave a stray temporary behind. Entries carry a checksum; anything that fails to load or
+    * validate is removed and rebuilt from the code in the chain state.
+    *
+    * Entries are written by a thread of the cache's own, never on the thread applying the action that prepared
+    * them, and the least recently used entries are removed once the entries take up more than the given size.
+    * Reading them is left to the caller, see wasm_interface_impl for which thread does.
+    *
+    * An empty directory disables the cache.
+    */
+   class wasm_code_cache {
+      public:
+         static const uint32_t format_version;
+
+         wasm_code_cache( const fc::path& dir, wasm_interface::vm_type vm, const string& runtime_version,
+                          uint64_t max_size = std::numeric_limits<uint64_t>::max() );
+         ~wasm_code_cache();
+
+         bool enabled()const { return !_dir.empty(); }
+
+         /// whether there is an entry for the code, without reading it
+         bool                         contains( const digest_type& code_id )const;
+         optional<wasm_prepared_code> find( const digest_type& code_id );
+         /// queues the entry to be written, a later find may not see it until it has been
+         void                         add( const wasm_prepared_code& prepared );
+
+         /// reads the entries, most recently used first, until f returns false
+         void                         for_each_recent( const std::function<bool(wasm_prepared_code&&)>& f );
+
+         /// waits for the entries queued so far to be written
+         void                         flush();
+
+         /// bytes of the entries on disk
+         uint64_t                     size()const;
+
+      private:
+         struct lru_entry {
+            fc::path path;
+            uint64_t size = 0;
+         };
+
+         fc::path entry_path( const digest_type& code_id )const;
+         optional<wasm_prepared_code> read_entry( const fc::path& path, const digest_type* code_id );
+         void     write_entry( const fc::path& path, const bytes& content );
+         void     touch( const fc::path& path );
+         void     evict();
+
+         fc::path                                       _dir;
+         wasm_interface::vm_type                        _vm;
+         string                                         _runtime_version;
+         uint64_t                                       _max_size;
+
+         mutable std::mutex                             _mtx;          ///< guards the entries below
+         std::list<lru_entry>                           _lru;          ///< most recently used first
+         std::map<string, std::list<lru_entry>::iterator> _entries; ///< by generic path
+         uint64_t                                       _size = 0;
+
+         std::unique_ptr<boost::asio::thread_pool>      _writer;       ///< one thread, entries are written in order
+   };
+
+} } // eosio::chain
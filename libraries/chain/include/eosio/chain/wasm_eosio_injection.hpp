@@ -19,6 +19,10 @@
 
 namespace eosio { namespace chain { namespace wasm_injections {
    using namespace IR;
+
+   // must be bumped whenever the code emitted by the injectors below changes, it keys cached prepared code
+   constexpr uint32_t injection_version = 2;
+
    // helper functions for injection
 
    struct injector_utils {
@@ -235,25 +239,55 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static size_t fcnt;
    };
 
+   /**
+    * checktime is only called once the poll flag, an injected mutable global, is set. The flag starts out set so a
+    * runtime that leaves it alone calls checktime at every injection point. A runtime that can read it from the
+    * deadline timer's expired flag instead (see wavm) only pays for a global load in loops until the deadline may
+    * have passed.
+    */
    struct checktime_injection {
       static constexpr bool kills = false;
       static constexpr bool post = true;
       static void init() {
          idx = 0;
          chktm_idx = 0;
+         poll_global_idx = -1;
       }
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          auto mapped_index = injector_utils::injected_index_mapping.find(chktm_idx);
+         emit_checktime( arg.new_code, mapped_index->second );
+      }
+
+      static void add_poll_flag( Module& mod ) {
+         mod.globals.defs.push_back({{ValueType::i32, true}, {(I32) 1}});
+         poll_global_idx = mod.globals.size()-1;
+      }
+
+      static void emit_checktime( wasm_ops::instruction_stream* code, uint32_t checktime_index ) {
+         wasm_ops::op_types<>::get_global_t get_poll;
+         wasm_ops::op_types<>::if__t        if_inst;
+         wasm_ops::op_types<>::call_t       call_checktime;
+         wasm_ops::op_types<>::end_t        end_inst;
+
+         get_poll.field = poll_global_idx;
+         call_checktime.field = checktime_index;
 
-         wasm_ops::op_types<>::call_t chktm; 
-         chktm.field = mapped_index->second;
-         chktm.pack(arg.new_code);
+         get_poll.pack(code);
+         if_inst.pack(code);
+         call_checktime.pack(code);
+         end_inst.pack(code);
       }
 
       static int32_t idx;
       static int32_t chktm_idx;
+      static int32_t poll_global_idx;
    };
 
+   /// The poll flag is always the last global of injected code
+   inline uint32_t deadline_poll_global_index( const IR::Module& mod ) {
+      return mod.globals.size()-1;
+   }
+
    struct fix_call_index {
       static constexpr bool kills = false;
       static constexpr bool post = false;
@@ -279,18 +313,15 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static void init() {
          global_idx = -1;
       }
+      static void add_global( Module& mod ) {
+         mod.globals.defs.push_back({{ValueType::i32, true}, {(I32) eosio::chain::wasm_constraints::maximum_call_depth}});
+         global_idx = mod.globals.size()-1;
+      }
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
-         if ( global_idx == -1 ) {
-            arg.module->globals.defs.push_back({{ValueType::i32, true}, {(I32) eosio::chain::wasm_constraints::maximum_call_depth}});
-         }
-
-         global_idx = arg.module->globals.size()-1;
-
          int32_t assert_idx;
          injector_utils::add_import<ResultType::none>(*(arg.module), "call_depth_assert", assert_idx);
 
          wasm_ops::op_types<>::call_t call_assert;
-         wasm_ops::op_types<>::call_t call_checktime;
          wasm_ops::op_types<>::get_global_t get_global_inst; 
          wasm_ops::op_types<>::set_global_t set_global_inst;
 
@@ -302,7 +333,6 @@ namespace eosio { namespace chain { namespace wasm_injections {
          wasm_ops::op_types<>::else__t else_inst; 
 
          call_assert.field = assert_idx;
-         call_checktime.field = checktime_injection::chktm_idx;
          get_global_inst.field = global_idx;
          set_global_inst.field = global_idx;
          const_inst.field = -1;
@@ -336,7 +366,7 @@ namespace eosio { namespace chain { namespace wasm_injections {
          INSERT_INJECTED(const_inst);
          INSERT_INJECTED(add_inst);
          INSERT_INJECTED(set_global_inst);
-         INSERT_INJECTED(call_checktime);
+         checktime_injection::emit_checktime( arg.new_code, checktime_injection::chktm_idx );
 
 #undef INSERT_INJECTED
       }
@@ -795,6 +825,9 @@ namespace eosio { namespace chain { namespace wasm_injections {
             _module_injectors.inject( *_module );
             // inject checktime first
             injector_utils::add_import<ResultType::none>( *_module, u8"checktime", checktime_injection::chktm_idx );
+            // both globals are added up front, in this order, so that the poll flag is always the last global
+            call_depth_check_and_insert_checktime::add_global( *_module );
+            checktime_injection::add_poll_flag( *_module );
 
             for ( auto& fd : _module->functions.defs ) {
                wasm_ops::EOSIO_OperatorDecoderStream<pre_op_injectors> pre_decoder(fd.code);
@@ -818,9 +851,8 @@ namespace eosio { namespace chain { namespace wasm_injections {
                wasm_ops::EOSIO_OperatorDecoderStream<post_op_injectors> post_decoder(fd.code);
                wasm_ops::instruction_stream post_code(fd.code.size()*2);
 
-               wasm_ops::op_types<>::call_t chktm; 
-               chktm.field = injector_utils::injected_index_mapping.find(checktime_injection::chktm_idx)->second;
-               chktm.pack(&post_code);
+               checktime_injection::emit_checktime( &post_code,
+                                                    injector_utils::injected_index_mapping.find(checktime_injection::chktm_idx)->second );
 
                while ( post_decoder ) {
                   auto op = post_decoder.decodeOp();
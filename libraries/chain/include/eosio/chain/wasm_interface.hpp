@@ -53,10 +53,34 @@ namespace eosio { namespace chain {
       public:
          enum class vm_type {
             wavm,
-            wabt
+            wabt,
+            tiered ///< interpret with wabt until a wavm compile done in the background is ready
          };
 
-         wasm_interface(vm_type vm);
+         struct tiering_policy {
+            uint32_t compile_after_calls   = 1;       ///< interpreted calls of a module before its native compile is scheduled
+            uint64_t sync_compile_max_size = 16*1024; ///< prepared code up to this size is compiled before its first call instead
+         };
+
+         struct cache_stats {
+            uint64_t          entries = 0;
+            uint64_t          size = 0;      ///< bytes of prepared code and initial memory held by cached modules
+            uint64_t          max_size = 0;
+            uint64_t          hits = 0;
+            uint64_t          misses = 0;
+            uint64_t          evictions = 0;
+            uint64_t          preloads = 0;  ///< misses served by a module the startup preload instantiated from the code cache
+            fc::microseconds  compile_time;  ///< total time spent preparing and instantiating modules on misses
+            uint64_t          interpreted_calls = 0;
+            uint64_t          native_calls = 0;
+            uint64_t          tier_ups = 0;  ///< interpreted modules replaced by their native compile
+            fc::microseconds  background_compile_time;
+         };
+
+         wasm_interface(vm_type vm, const fc::path& code_cache_dir = fc::path(),
+                        uint64_t code_cache_max_size = std::numeric_limits<uint64_t>::max(),
+                        uint64_t max_cache_size = std::numeric_limits<uint64_t>::max(),
+                        const tiering_policy& tiering = tiering_policy());
          ~wasm_interface();
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
@@ -68,6 +92,14 @@ namespace eosio { namespace chain {
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         //Indicates an account stopped running this code; its cached module becomes the first candidate for eviction
+         void code_released(const digest_type& code_id);
+
+         cache_stats get_cache_stats()const;
+
+         //Blocks until the startup preload from the code cache and the background compiles scheduled in tiered mode have finished
+         void wait_for_pending_compiles()const;
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -79,4 +111,7 @@ namespace eosio{ namespace chain {
    std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime);
 }}
 
-FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt) )
+FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt)(tiered) )
+FC_REFLECT( eosio::chain::wasm_interface::tiering_policy, (compile_after_calls)(sync_compile_max_size) )
+FC_REFLECT( eosio::chain::wasm_interface::cache_stats, (entries)(size)(max_size)(hits)(misses)(evictions)(preloads)(compile_time)
+            (interpreted_calls)(native_calls)(tier_ups)(background_compile_time) )
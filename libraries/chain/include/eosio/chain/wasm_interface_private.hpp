@@ -1,14 +1,23 @@
 #pragma once
 
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/wasm_code_cache.hpp>
 #include <eosio/chain/webassembly/wavm.hpp>
 #include <eosio/chain/webassembly/wabt.hpp>
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <atomic>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -23,13 +32,78 @@ using namespace Runtime;
 namespace eosio { namespace chain {
 
    struct wasm_interface_impl {
-      wasm_interface_impl(wasm_interface::vm_type vm) {
+      struct compiled_module {
+         std::unique_ptr<wasm_instantiated_module_interface>  module;
+         fc::microseconds                                     compile_time;
+      };
+
+      struct wasm_cache_entry {
+         digest_type                                          code_id;
+         std::unique_ptr<wasm_instantiated_module_interface>  module;
+         wasm_runtime_interface*                              runtime = nullptr; ///< the runtime that instantiated module
+         uint64_t                                             size = 0;
+
+         // only used while a tiered module is still interpreted
+         bool                                                 cached = false; ///< the code cache has its object code
+         uint32_t                                             calls = 0;
+         std::shared_ptr<const wasm_prepared_code>            pending_code; ///< released once the compile is scheduled
+         std::future<compiled_module>                         compiling;
+      };
+      struct by_hash;
+
+      /**
+       * Instantiated modules in least recently used order, oldest at the front
+       */
+      typedef boost::multi_index_container<
+         wasm_cache_entry,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique<boost::multi_index::tag<by_hash>,
+               boost::multi_index::member<wasm_cache_entry, digest_type, &wasm_cache_entry::code_id>,
+               std::hash<digest_type>
+            >
+         >
+      > wasm_cache_index;
+
+      struct preloaded_module {
+         std::unique_ptr<wasm_instantiated_module_interface>  module;
+         uint64_t                                             size = 0;
+      };
+
+      wasm_interface_impl(wasm_interface::vm_type vm, const fc::path& code_cache_dir, uint64_t code_cache_max_size,
+                          uint64_t max_cache_size, const wasm_interface::tiering_policy& tiering)
+      : vm(vm),
+        code_cache(code_cache_dir, vm,
+                   vm == wasm_interface::vm_type::wabt ? string() : webassembly::wavm::wavm_runtime::object_code_version(),
+                   code_cache_max_size),
+        tiering(tiering) {
+         stats.max_size = max_cache_size;
+
          if(vm == wasm_interface::vm_type::wavm)
             runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
          else if(vm == wasm_interface::vm_type::wabt)
             runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+         else if(vm == wasm_interface::vm_type::tiered) {
+            runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
+            interpreter = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+         }
          else
             EOS_THROW(wasm_exception, "wasm_interface_impl fall through");
+
+         if(vm != wasm_interface::vm_type::wabt) {
+            // a single thread as WAVM instantiation (LLVM included) is serialized anyway
+            compile_pool = std::make_unique<boost::asio::thread_pool>(1);
+            if(code_cache.enabled())
+               preloading = async_thread_pool(*compile_pool, [this]() { preload(); });
+         }
+      }
+
+      ~wasm_interface_impl() {
+         stopping = true;
+         if(compile_pool) {
+            compile_pool->stop();
+            compile_pool->join();
+         }
       }
 
       std::vector<uint8_t> parse_initial_memory(const Module& module) {
@@ -50,47 +124,248 @@ namespace eosio { namespace chain {
          return mem_image;
       }
 
-      std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_id,
-                                                                                    const shared_string& code,
-                                                                                    transaction_context& trx_context )
+      wasm_prepared_code prepare_code( const digest_type& code_id, const shared_string& code ) {
+         IR::Module module;
+         try {
+            Serialization::MemoryInputStream stream((const U8*)code.data(), code.size());
+            WASM::serialize(stream, module);
+            module.userSections.clear();
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+
+         wasm_injections::wasm_binary_injection injector(module);
+         injector.inject();
+
+         wasm_prepared_code prepared;
+         prepared.code_id = code_id;
+         try {
+            Serialization::ArrayOutputStream outstream;
+            WASM::serialize(outstream, module);
+            prepared.code = outstream.getBytes();
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+         prepared.initial_memory = parse_initial_memory(module);
+         return prepared;
+      }
+
+      wasm_instantiated_module_interface& get_instantiated_module( const digest_type& code_id,
+                                                                   const shared_string& code,
+                                                                   transaction_context& trx_context )
       {
-         auto it = instantiation_cache.find(code_id);
-         if(it == instantiation_cache.end()) {
-            auto timer_pause = fc::make_scoped_exit([&](){
-               trx_context.resume_billing_timer();
-            });
-            trx_context.pause_billing_timer();
-            IR::Module module;
-            try {
-               Serialization::MemoryInputStream stream((const U8*)code.data(), code.size());
-               WASM::serialize(stream, module);
-               module.userSections.clear();
-            } catch(const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch(const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         auto& by_hash_idx = instantiation_cache.get<by_hash>();
+         auto it = by_hash_idx.find(code_id);
+         if(it != by_hash_idx.end()) {
+            ++stats.hits;
+            instantiation_cache.relocate(instantiation_cache.end(), instantiation_cache.project<0>(it));
+            if(it->runtime == interpreter.get())
+               tier_up(instantiation_cache.project<0>(it));
+            return running(*it);
+         }
+
+         ++stats.misses;
+         auto timer_pause = fc::make_scoped_exit([&](){
+            trx_context.resume_billing_timer();
+         });
+         trx_context.pause_billing_timer();
+
+         const auto start = fc::time_point::now();
+         wasm_cache_entry entry;
+         entry.code_id = code_id;
+         auto preloaded = take_preloaded(code_id);
+         if(preloaded.module) {
+            entry.runtime = runtime_interface.get();
+            entry.module = std::move(preloaded.module);
+            entry.size = preloaded.size;
+            ++stats.preloads;
+         } else if(interpreter) {
+            // the interpreter is handed freshly prepared code rather than waiting for the code cache to be read; the
+            // cached entry, object code included, is read on the compile thread
+            auto prepared = prepare_code(code_id, code);
+            entry.cached = code_cache.contains(code_id);
+            // the prepared code stands in for the size of the generated code, which the runtimes do not report
+            entry.size = prepared.code.size() + prepared.initial_memory.size();
+            if(!entry.cached && prepared.code.size() <= tiering.sync_compile_max_size) {
+               entry.runtime = runtime_interface.get();
+               entry.module = instantiate_native(prepared);
+            } else {
+               entry.runtime = interpreter.get();
+               entry.module = interpreter->instantiate_module((const char*)prepared.code.data(), prepared.code.size(), prepared.initial_memory, {});
+               entry.pending_code = std::make_shared<const wasm_prepared_code>(std::move(prepared));
             }
+         } else {
+            // nothing else can run the contract, so the code cache is read here; its object code saves the compile
+            auto prepared = code_cache.find(code_id);
+            if( !prepared )
+               prepared = prepare_code(code_id, code);
+            entry.size = prepared->code.size() + prepared->initial_memory.size();
+            entry.runtime = runtime_interface.get();
+            entry.module = instantiate_native(*prepared);
+         }
+         stats.compile_time += fc::time_point::now() - start;
 
-            wasm_injections::wasm_binary_injection injector(module);
-            injector.inject();
+         instantiation_cache.push_back( std::move(entry) );
+         stats.size += instantiation_cache.back().size;
+         evict();
+         if(instantiation_cache.back().runtime == interpreter.get())
+            tier_up(std::prev(instantiation_cache.end()));
+         return running(instantiation_cache.back());
+      }
+
+      /// counts the call towards scheduling a native compile of an interpreted module, and switches to the native
+      /// module once its compile has finished
+      /// only called on the main thread between calls, so the interpreted module replaced here is never running
+      void tier_up( wasm_cache_index::iterator it ) {
+         instantiation_cache.modify(it, [&](wasm_cache_entry& e) {
+            if(e.compiling.valid()) {
+               if(e.compiling.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                  return;
+               try {
+                  auto compiled = e.compiling.get();
+                  e.module = std::move(compiled.module);
+                  e.runtime = runtime_interface.get();
+                  stats.background_compile_time += compiled.compile_time;
+                  ++stats.tier_ups;
+               } catch(const fc::exception& ex) {
+                  wlog("native compile of ${id} failed, continuing with the interpreter: ${e}", ("id", e.code_id)("e", ex.to_detail_string()));
+               } catch(const std::exception& ex) {
+                  wlog("native compile of ${id} failed, continuing with the interpreter: ${e}", ("id", e.code_id)("e", ex.what()));
+               }
+               return;
+            }
+            // loading cached object code is cheap, so that is not held back like a compile
+            if(!e.pending_code || (!e.cached && ++e.calls < tiering.compile_after_calls))
+               return;
 
-            std::vector<U8> bytes;
+            auto code = std::move(e.pending_code);
+            e.compiling = async_thread_pool(*compile_pool, [this, code]() {
+               const auto start = fc::time_point::now();
+               compiled_module result;
+               auto prepared = code_cache.find(code->code_id);
+               if( !prepared )
+                  prepared = *code;
+               result.module = instantiate_native(*prepared);
+               result.compile_time = fc::time_point::now() - start;
+               return result;
+            });
+         });
+      }
+
+      /// instantiates with the native runtime, from the object code if prepared has any the runtime can use, and
+      /// persists the object code the runtime generated otherwise. Called on the apply thread and the compile thread
+      std::unique_ptr<wasm_instantiated_module_interface> instantiate_native( wasm_prepared_code& prepared ) {
+         auto module = runtime_interface->instantiate_module((const char*)prepared.code.data(), prepared.code.size(),
+                                                             prepared.initial_memory, prepared.object_code);
+         auto generated = module->take_object_code();
+         if( !generated.empty() ) {
+            prepared.object_code = std::move(generated);
+            code_cache.add(prepared);
+         }
+         return module;
+      }
+
+      /// runs on the compile thread at startup: instantiates the most recently used entries of the code cache that
+      /// have object code, as many as fit the instantiation cache, so the contracts used before a restart are ready
+      /// without compiling them or reading the cache on the apply thread
+      void preload() {
+         uint64_t size = 0;
+         code_cache.for_each_recent([&](wasm_prepared_code&& prepared) {
+            if(stopping)
+               return false;
+            const uint64_t entry_size = prepared.code.size() + prepared.initial_memory.size();
+            if(size + entry_size > stats.max_size)
+               return false;
+            if(prepared.object_code.empty())
+               return true;
+            size += entry_size;
             try {
-               Serialization::ArrayOutputStream outstream;
-               WASM::serialize(outstream, module);
-               bytes = outstream.getBytes();
-            } catch(const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch(const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+               auto module = instantiate_native(prepared);
+               std::lock_guard<std::mutex> g(preloaded_mtx);
+               preloaded[prepared.code_id] = preloaded_module{ std::move(module), entry_size };
+            } catch(const fc::exception& e) {
+               wlog("preloading ${id} failed: ${e}", ("id", prepared.code_id)("e", e.to_detail_string()));
+            } catch(const std::exception& e) {
+               wlog("preloading ${id} failed: ${e}", ("id", prepared.code_id)("e", e.what()));
             }
-            it = instantiation_cache.emplace(code_id, runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module))).first;
+            return true;
+         });
+      }
+
+      /// the module is null if the code was not preloaded
+      preloaded_module take_preloaded( const digest_type& code_id ) {
+         preloaded_module result;
+         std::lock_guard<std::mutex> g(preloaded_mtx);
+         auto it = preloaded.find(code_id);
+         if(it != preloaded.end()) {
+            result = std::move(it->second);
+            preloaded.erase(it);
+         }
+         return result;
+      }
+
+      /// blocks until the preload and every scheduled background compile have finished; each module switches to its
+      /// native compile on its next call
+      void wait_for_pending_compiles()const {
+         if(preloading.valid())
+            preloading.wait();
+         for(const auto& e : instantiation_cache) {
+            if(e.compiling.valid())
+               e.compiling.wait();
          }
-         return it->second;
       }
 
+      wasm_instantiated_module_interface& running( const wasm_cache_entry& e ) {
+         current_runtime = e.runtime;
+         if(e.runtime == interpreter.get() || vm == wasm_interface::vm_type::wabt)
+            ++stats.interpreted_calls;
+         else
+            ++stats.native_calls;
+         return *e.module;
+      }
+
+      /// moves the module to the front of the eviction order, it will be reinstantiated on demand if still needed
+      void demote( const digest_type& code_id ) {
+         auto& by_hash_idx = instantiation_cache.get<by_hash>();
+         auto it = by_hash_idx.find(code_id);
+         if(it != by_hash_idx.end())
+            instantiation_cache.relocate(instantiation_cache.begin(), instantiation_cache.project<0>(it));
+      }
+
+      /// the most recently used module is always kept, even if it alone exceeds the limit, since the caller is about to run it
+      void evict() {
+         while( stats.size > stats.max_size && instantiation_cache.size() > 1 ) {
+            stats.size -= instantiation_cache.front().size;
+            instantiation_cache.pop_front();
+            ++stats.evictions;
+         }
+      }
+
+      wasm_interface::cache_stats get_cache_stats()const {
+         auto result = stats;
+         result.entries = instantiation_cache.size();
+         return result;
+      }
+
+      wasm_interface::vm_type vm;
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
-      map<digest_type, std::unique_ptr<wasm_instantiated_module_interface>> instantiation_cache;
+      std::unique_ptr<wasm_runtime_interface> interpreter; ///< first tier in tiered mode, otherwise null
+      wasm_runtime_interface* current_runtime = nullptr;
+      wasm_code_cache code_cache;
+      wasm_interface::tiering_policy tiering;
+      wasm_interface::cache_stats stats;
+      wasm_cache_index instantiation_cache;
+
+      std::mutex preloaded_mtx; ///< guards preloaded, which the compile thread fills
+      std::map<digest_type, preloaded_module> preloaded; ///< moved to instantiation_cache on the first call
+      std::atomic<bool> stopping{false};
+
+      std::unique_ptr<boost::asio::thread_pool> compile_pool; ///< null in wabt mode
+      std::future<void> preloading;
    };
 
 #define _REGISTER_INTRINSIC_EXPLICIT(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
@@ -10,12 +10,19 @@ class wasm_instantiated_module_interface {
    public:
       virtual void apply(apply_context& context) = 0;
 
+      //the object code the runtime generated for the module, handed out once so it can be persisted. Empty when the
+      // runtime generates none or the module was instantiated from object code
+      virtual std::vector<uint8_t> take_object_code() { return {}; }
+
       virtual ~wasm_instantiated_module_interface();
 };
 
 class wasm_runtime_interface {
    public:
-      virtual std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) = 0;
+      //object_code is what take_object_code returned for an earlier instantiation of the same code, runtimes that
+      // generate none ignore it, as does one that finds it unusable
+      virtual std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory,
+                                                                                     const std::vector<uint8_t>& object_code) = 0;
 
       //immediately exit the currently running wasm_instantiated_module_interface. Yep, this assumes only one can possibly run at a time.
       virtual void immediately_exit_currently_running_module() = 0;
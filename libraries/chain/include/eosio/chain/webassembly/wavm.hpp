@@ -20,10 +20,14 @@ class wavm_runtime : public eosio::chain::wasm_runtime_interface {
    public:
       wavm_runtime();
       ~wavm_runtime();
-      std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) override;
+      std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory,
+                                                                             const std::vector<uint8_t>& object_code) override;
 
       void immediately_exit_currently_running_module() override;
 
+      //the version of the code generator, object code is only reused by a runtime of the same version
+      static std::string object_code_version();
+
       struct runtime_guard {
          runtime_guard();
          ~runtime_guard();
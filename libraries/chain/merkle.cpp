@@ -1,4 +1,6 @@
 #include <eosio/chain/merkle.hpp>
+#include <eosio/chain/config.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/io/raw.hpp>
 
 namespace eosio { namespace chain {
@@ -49,4 +51,26 @@ digest_type merkle(vector<digest_type> ids) {
    return ids.front();
 }
 
+digest_type merkle(vector<digest_type> ids, boost::asio::thread_pool& thread_pool, uint32_t max_chunks) {
+   const size_t min_parallel_pairs = 2 * config::merkle_pairs_per_chunk;
+
+   // ranges hashed concurrently would read what the others overwrite in place, so each level goes to its own buffer
+   vector<digest_type> next;
+   while( ids.size() / 2 >= min_parallel_pairs && max_chunks > 1 ) {
+      if( ids.size() % 2 )
+         ids.push_back(ids.back());
+
+      next.resize( ids.size() / 2 );
+      run_in_ranges( thread_pool, next.size(), max_chunks, config::merkle_pairs_per_chunk,
+                     [&ids, &next]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i ) {
+            next[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+         }
+      });
+      ids.swap( next );
+   }
+
+   return merkle( move(ids) );
+}
+
 } } // eosio::chain
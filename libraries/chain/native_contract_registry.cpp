@@ -0,0 +1,37 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/native_contract_registry.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+namespace eosio { namespace chain {
+
+   void native_contract_registry::register_contract( const digest_type& code_id, native_apply apply ) {
+      EOS_ASSERT( static_cast<bool>(apply), misc_exception, "native contract implementation cannot be empty" );
+      auto res = _contracts.emplace( code_id, std::move(apply) );
+      EOS_ASSERT( res.second, misc_exception, "a native implementation of code ${id} is already registered", ("id", code_id) );
+   }
+
+   const native_contract_registry::native_apply* native_contract_registry::find( const digest_type& code_id )const {
+      if( _mode == mode::disabled || _contracts.empty() )
+         return nullptr;
+      auto itr = _contracts.find( code_id );
+      return itr != _contracts.end() ? &itr->second : nullptr;
+   }
+
+   std::istream& operator>>( std::istream& in, native_contract_registry::mode& m ) {
+      std::string s;
+      in >> s;
+      if( s == "disabled" )
+         m = native_contract_registry::mode::disabled;
+      else if( s == "enabled" )
+         m = native_contract_registry::mode::enabled;
+      else if( s == "differential" )
+         m = native_contract_registry::mode::differential;
+      else
+         in.setstate( std::ios_base::failbit );
+      return in;
+   }
+
+} } // eosio::chain
@@ -67,8 +67,9 @@ void resource_limits_manager::initialize_database() {
 
 void resource_limits_manager::add_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
    resource_index_set::walk_indices([this, &snapshot]( auto utils ){
-      snapshot->write_section<typename decltype(utils)::index_t::value_type>([this]( auto& section ){
-         decltype(utils)::walk(_db, [this, &section]( const auto &row ) {
+      const auto parts = decltype(utils)::part_count(_db, config::snapshot_rows_per_part);
+      snapshot->write_section_parts<typename decltype(utils)::index_t::value_type>(parts, [this, parts]( uint32_t part, auto& section ){
+         decltype(utils)::walk_part(_db, part, parts, [this, &section]( const auto &row ) {
             section.add_row(row, _db);
          });
       });
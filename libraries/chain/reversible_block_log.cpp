@@ -0,0 +1,344 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/reversible_block_log.hpp>
+#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
+#include <fc/scoped_exit.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      /**
+       * The log starts with its version, followed by records of the form:
+       *
+       * +--------------+-------------------+-------------------+------------------------+
+       * | size: uint32 | checksum: uint64  | block_num: uint32 | packed signed_block    |
+       * +--------------+-------------------+-------------------+------------------------+
+       *
+       * The checksum covers the packed block. A record of size 0 has no block and says that the blocks through
+       * block_num have become irreversible.
+       */
+      const uint32_t reversible_block_log_version = 1;
+      const uint64_t reversible_block_record_header_size = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+      /// bytes of blocks no longer held before the log is rewritten, at least
+      const uint64_t reversible_block_log_min_compaction_bytes = 16*1024*1024;
+
+      static uint64_t block_checksum( const char* data, uint32_t size ) {
+         return fc::sha256::hash( data, size )._hash[0];
+      }
+
+      static void write_record( std::ostream& out, uint32_t block_num, uint64_t checksum, const char* data, uint32_t size ) {
+         out.write( (const char*)&size, sizeof(size) );
+         out.write( (const char*)&checksum, sizeof(checksum) );
+         out.write( (const char*)&block_num, sizeof(block_num) );
+         if( size > 0 )
+            out.write( data, size );
+      }
+   }
+
+   reversible_block_log::reversible_block_log( const fc::path& data_dir, bool read_only )
+   :_data_dir(data_dir)
+   ,_read_only(read_only)
+   {
+      if( !_read_only ) {
+         if( !fc::is_directory( _data_dir ) )
+            fc::create_directories( _data_dir );
+         migrate_database();
+      }
+
+      if( fc::exists( log_path() ) ) {
+         scan();
+         open_log();
+         return;
+      }
+
+      if( _read_only ) return;
+
+      std::ofstream out( log_path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+      out.write( (const char*)&detail::reversible_block_log_version, sizeof(detail::reversible_block_log_version) );
+      out.close();
+      _file_size = sizeof(detail::reversible_block_log_version);
+      open_log();
+   }
+
+   reversible_block_log::~reversible_block_log() {
+      flush();
+   }
+
+   fc::path reversible_block_log::log_path()const {
+      return _data_dir / config::reversible_blocks_log_filename;
+   }
+
+   void reversible_block_log::open_log() {
+      if( _read_only || _log.is_open() ) return;
+      _log.open( log_path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+   }
+
+   void reversible_block_log::scan() {
+      std::ifstream in( log_path().generic_string().c_str(), std::ios::in | std::ios::binary );
+      in.seekg( 0, std::ios::end );
+      const uint64_t file_size = in.tellg();
+      in.seekg( 0 );
+
+      uint32_t version = 0;
+      uint64_t pos = 0;
+      if( file_size >= sizeof(version) ) {
+         in.read( (char*)&version, sizeof(version) );
+         EOS_ASSERT( version == detail::reversible_block_log_version, reversible_blocks_exception,
+                     "reversible block log '${p}' has unsupported version ${v}", ("p", log_path())("v", version) );
+         pos = sizeof(version);
+      }
+
+      while( file_size - pos >= detail::reversible_block_record_header_size ) {
+         uint32_t size = 0;
+         uint64_t checksum = 0;
+         uint32_t block_num = 0;
+         in.seekg( pos );
+         in.read( (char*)&size, sizeof(size) );
+         in.read( (char*)&checksum, sizeof(checksum) );
+         in.read( (char*)&block_num, sizeof(block_num) );
+
+         if( size == 0 ) {
+            while( !_entries.empty() && _first_block_num <= block_num ) {
+               _live_bytes -= detail::reversible_block_record_header_size + _entries.front().size;
+               _entries.pop_front();
+               ++_first_block_num;
+            }
+            pos += detail::reversible_block_record_header_size;
+            continue;
+         }
+
+         if( file_size - pos - detail::reversible_block_record_header_size < size ) break;
+         if( !_entries.empty() && block_num != last_block_num() + 1 ) {
+            wlog( "Reversible block log has block ${n} following block ${last}, dropping it and everything after it",
+                  ("n", block_num)("last", last_block_num()) );
+            break;
+         }
+
+         if( _entries.empty() ) _first_block_num = block_num;
+         if( _first_record_pos == 0 ) _first_record_pos = pos;
+         _entries.push_back( entry{ pos, size, checksum } );
+         _live_bytes += detail::reversible_block_record_header_size + size;
+         pos += detail::reversible_block_record_header_size + size;
+      }
+
+      // only the last block written can have been left partially written by a crash
+      bytes data;
+      while( !_entries.empty() ) {
+         const auto& e = _entries.back();
+         data.resize( e.size );
+         in.clear();
+         in.seekg( e.pos + detail::reversible_block_record_header_size );
+         in.read( data.data(), e.size );
+         if( in && detail::block_checksum( data.data(), e.size ) == e.checksum ) break;
+
+         pos = e.pos;
+         _live_bytes -= detail::reversible_block_record_header_size + e.size;
+         _entries.pop_back();
+      }
+      if( _entries.empty() ) _first_block_num = 0;
+
+      _file_size = file_size;
+      if( pos < file_size || version == 0 ) {
+         _repaired = true;
+         wlog( "Reversible block log ends in ${n} bytes of an incomplete record", ("n", file_size - pos) );
+         if( !_read_only )
+            truncate_file( pos );
+      }
+   }
+
+   /**
+    * Moves the blocks of a reversible block database of an earlier version into a new log. The log is written aside
+    * and renamed into place once complete, so a failure leaves no log behind and the database is moved again on the
+    * next start. The database is removed only after the rename.
+    */
+   void reversible_block_log::migrate_database() {
+      const auto shared_memory = _data_dir / "shared_memory.bin";
+      if( !fc::exists( shared_memory ) ) return;
+
+      if( !fc::exists( log_path() ) ) {
+         ilog( "Moving the blocks of the reversible block database in '${d}' into a reversible block log", ("d", _data_dir) );
+         const auto tmp_path = _data_dir / (string(config::reversible_blocks_log_filename) + ".tmp");
+         auto remove_tmp = fc::make_scoped_exit([&tmp_path]() {
+            if( fc::exists( tmp_path ) )
+               fc::remove( tmp_path );
+         });
+
+         try {
+            std::ofstream out( tmp_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+            out.write( (const char*)&detail::reversible_block_log_version, sizeof(detail::reversible_block_log_version) );
+
+            chainbase::database legacy( _data_dir, chainbase::database::read_only );
+            legacy.add_index<reversible_block_index>();
+            uint32_t last_block_num = 0;
+            for( const auto& o : legacy.get_index<reversible_block_index,by_num>() ) {
+               if( last_block_num != 0 && o.blocknum != last_block_num + 1 ) {
+                  wlog( "gap in reversible block database between ${end} and ${blocknum}, dropping the blocks after it",
+                        ("end", last_block_num)("blocknum", o.blocknum) );
+                  break;
+               }
+               const auto data = fc::raw::pack( *o.get_block() );
+               const uint32_t size = data.size();
+               detail::write_record( out, o.blocknum, detail::block_checksum( data.data(), size ), data.data(), size );
+               last_block_num = o.blocknum;
+            }
+
+            out.close();
+            EOS_ASSERT( out, reversible_blocks_exception, "failed to write reversible block log '${p}'", ("p", tmp_path) );
+         } catch( const std::exception& e ) {
+            EOS_THROW( reversible_blocks_exception,
+                       "reversible block database of an earlier version in '${d}' could not be opened: ${e}",
+                       ("d", _data_dir)("e", e.what()) );
+         }
+
+         fc::rename( tmp_path, log_path() );
+      }
+
+      fc::remove( shared_memory );
+      if( fc::exists( _data_dir / "shared_memory.meta" ) )
+         fc::remove( _data_dir / "shared_memory.meta" );
+   }
+
+   void reversible_block_log::write_record( uint32_t block_num, uint64_t checksum, const char* data, uint32_t size ) {
+      detail::write_record( _log, block_num, checksum, data, size );
+      _log.flush();
+      _file_size += detail::reversible_block_record_header_size + size;
+   }
+
+   /// cuts the file back to pos, keeping the blocks before the first one held irreversible
+   void reversible_block_log::truncate_file( uint64_t pos ) {
+      if( _entries.empty() ) {
+         pos = 0;
+         _first_record_pos = 0;
+      }
+
+      _log.close();
+      if( pos <= sizeof(detail::reversible_block_log_version) ) {
+         std::ofstream out( log_path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+         out.write( (const char*)&detail::reversible_block_log_version, sizeof(detail::reversible_block_log_version) );
+         pos = sizeof(detail::reversible_block_log_version);
+      } else {
+         fc::resize_file( log_path(), pos );
+      }
+      _file_size = pos;
+      open_log();
+
+      if( !_entries.empty() && _entries.front().pos != _first_record_pos )
+         write_record( _first_block_num - 1, 0, nullptr, 0 );
+   }
+
+   void reversible_block_log::append( const signed_block_ptr& b ) {
+      EOS_ASSERT( !_read_only, reversible_blocks_exception, "reversible block log '${p}' is open read only", ("p", log_path()) );
+
+      const uint32_t block_num = b->block_num();
+      EOS_ASSERT( empty() || block_num == last_block_num() + 1, gap_in_reversible_blocks_db,
+                  "block ${n} does not follow the last reversible block ${last}", ("n", block_num)("last", last_block_num()) );
+
+      const auto data = fc::raw::pack( *b );
+      const uint32_t size = data.size();
+      const uint64_t checksum = detail::block_checksum( data.data(), size );
+
+      if( empty() ) _first_block_num = block_num;
+      if( _first_record_pos == 0 ) _first_record_pos = _file_size;
+      _entries.push_back( entry{ _file_size, size, checksum } );
+      _live_bytes += detail::reversible_block_record_header_size + size;
+      write_record( block_num, checksum, data.data(), size );
+   }
+
+   void reversible_block_log::truncate_from( uint32_t block_num ) {
+      EOS_ASSERT( !_read_only, reversible_blocks_exception, "reversible block log '${p}' is open read only", ("p", log_path()) );
+      if( empty() || block_num > last_block_num() ) return;
+
+      const auto first = block_num > _first_block_num ? _entries.begin() + (block_num - _first_block_num) : _entries.begin();
+      const uint64_t pos = first->pos;
+      for( auto itr = first; itr != _entries.end(); ++itr )
+         _live_bytes -= detail::reversible_block_record_header_size + itr->size;
+      _entries.erase( first, _entries.end() );
+      if( _entries.empty() ) _first_block_num = 0;
+
+      truncate_file( pos );
+   }
+
+   void reversible_block_log::remove_through( uint32_t block_num ) {
+      EOS_ASSERT( !_read_only, reversible_blocks_exception, "reversible block log '${p}' is open read only", ("p", log_path()) );
+      if( empty() || block_num < _first_block_num ) return;
+
+      while( !_entries.empty() && _first_block_num <= block_num ) {
+         _live_bytes -= detail::reversible_block_record_header_size + _entries.front().size;
+         _entries.pop_front();
+         ++_first_block_num;
+      }
+
+      if( _entries.empty() ) {
+         _first_block_num = 0;
+         truncate_file( 0 );
+         return;
+      }
+
+      write_record( block_num, 0, nullptr, 0 );
+      maybe_compact();
+   }
+
+   signed_block_ptr reversible_block_log::read_block_by_num( uint32_t block_num )const {
+      if( empty() || block_num < _first_block_num || block_num > last_block_num() ) return signed_block_ptr();
+
+      const auto& e = _entries[block_num - _first_block_num];
+      bytes data( e.size );
+      std::ifstream in( log_path().generic_string().c_str(), std::ios::in | std::ios::binary );
+      in.seekg( e.pos + detail::reversible_block_record_header_size );
+      in.read( data.data(), e.size );
+      EOS_ASSERT( in && detail::block_checksum( data.data(), e.size ) == e.checksum, reversible_blocks_exception,
+                  "reversible block ${n} is corrupted in '${p}'", ("n", block_num)("p", log_path()) );
+
+      auto b = std::make_shared<signed_block>();
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      fc::raw::unpack( ds, *b );
+      EOS_ASSERT( b->block_num() == block_num, reversible_blocks_exception,
+                  "reversible block log '${p}' holds block ${b} in place of block ${n}",
+                  ("p", log_path())("b", b->block_num())("n", block_num) );
+      return b;
+   }
+
+   void reversible_block_log::maybe_compact() {
+      const uint64_t dead_bytes = _file_size - sizeof(detail::reversible_block_log_version) - _live_bytes;
+      if( dead_bytes > std::max( _live_bytes, detail::reversible_block_log_min_compaction_bytes ) )
+         compact();
+   }
+
+   /// rewrites the log as the records of the blocks it holds; the new log replaces the old at once
+   void reversible_block_log::compact() {
+      const auto tmp_path = _data_dir / (string(config::reversible_blocks_log_filename) + ".tmp");
+      uint64_t pos = sizeof(detail::reversible_block_log_version);
+      {
+         std::ifstream in( log_path().generic_string().c_str(), std::ios::in | std::ios::binary );
+         std::ofstream out( tmp_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+         out.write( (const char*)&detail::reversible_block_log_version, sizeof(detail::reversible_block_log_version) );
+
+         bytes record;
+         for( auto& e : _entries ) {
+            record.resize( detail::reversible_block_record_header_size + e.size );
+            in.seekg( e.pos );
+            in.read( record.data(), record.size() );
+            out.write( record.data(), record.size() );
+            e.pos = pos;
+            pos += record.size();
+         }
+         EOS_ASSERT( in && out, reversible_blocks_exception, "failed to rewrite reversible block log '${p}'", ("p", log_path()) );
+      }
+
+      _log.close();
+      fc::rename( tmp_path, log_path() );
+      _file_size = pos;
+      _first_record_pos = _entries.empty() ? 0 : _entries.front().pos;
+      open_log();
+   }
+
+   void reversible_block_log::flush() {
+      if( _log.is_open() ) _log.flush();
+   }
+
+} } /// namespace eosio::chain
@@ -0,0 +1,118 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <mutex>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      using namespace boost::multi_index;
+
+      struct cached_pub_key {
+         transaction_id_type trx_id;
+         public_key_type pub_key;
+         signature_type sig;
+         fc::microseconds cpu_usage;
+         cached_pub_key(const cached_pub_key&) = delete;
+         cached_pub_key() = delete;
+         cached_pub_key& operator=(const cached_pub_key&) = delete;
+         cached_pub_key(cached_pub_key&&) = default;
+      };
+      struct by_sig{};
+
+      typedef multi_index_container<
+         cached_pub_key,
+         indexed_by<
+            sequenced<>,
+            hashed_unique<
+               tag<by_sig>,
+               member<cached_pub_key,
+                      signature_type,
+                      &cached_pub_key::sig>
+            >
+         >
+      > recovery_cache_type;
+
+      // counters live with the entries they describe so that workers hitting different shards share nothing
+      struct signature_recovery_cache_shard {
+         std::mutex          mtx;
+         recovery_cache_type cache;
+         uint64_t            hits = 0;
+         uint64_t            misses = 0;
+         uint64_t            evictions = 0;
+      };
+   }
+
+   signature_recovery_cache::signature_recovery_cache( uint64_t capacity )
+   :_shards( new detail::signature_recovery_cache_shard[shard_count] )
+   ,_capacity( capacity )
+   {}
+
+   signature_recovery_cache::~signature_recovery_cache() {}
+
+   signature_recovery_cache& signature_recovery_cache::instance() {
+      static signature_recovery_cache the_cache;
+      return the_cache;
+   }
+
+   void signature_recovery_cache::set_capacity( uint64_t capacity ) {
+      _capacity = capacity;
+   }
+
+   detail::signature_recovery_cache_shard& signature_recovery_cache::shard_for( const transaction_id_type& trx_id )const {
+      // transaction ids are hashes already, any of their words spreads evenly
+      return _shards[trx_id._hash[0] % shard_count];
+   }
+
+   bool signature_recovery_cache::find( const transaction_id_type& trx_id, const signature_type& sig,
+                                        public_key_type& key, fc::microseconds& cpu_usage ) {
+      auto& shard = shard_for( trx_id );
+      std::lock_guard<std::mutex> lock( shard.mtx );
+      auto it = shard.cache.get<detail::by_sig>().find( sig );
+      if( it == shard.cache.get<detail::by_sig>().end() || it->trx_id != trx_id ) {
+         ++shard.misses;
+         return false;
+      }
+      key = it->pub_key;
+      cpu_usage = it->cpu_usage;
+      ++shard.hits;
+      return true;
+   }
+
+   void signature_recovery_cache::add( const transaction_id_type& trx_id, const signature_type& sig,
+                                       const public_key_type& key, fc::microseconds cpu_usage ) {
+      const uint64_t capacity = _capacity;
+      if( capacity == 0 )
+         return;
+      const uint64_t shard_capacity = (capacity + shard_count - 1) / shard_count;
+
+      auto& shard = shard_for( trx_id );
+      std::lock_guard<std::mutex> lock( shard.mtx );
+      shard.cache.emplace_back( detail::cached_pub_key{trx_id, key, sig, cpu_usage} ); //could fail on dup signatures; not a problem
+      while( shard.cache.size() > shard_capacity ) {
+         shard.cache.pop_front();
+         ++shard.evictions;
+      }
+   }
+
+   signature_recovery_cache::stats signature_recovery_cache::get_stats()const {
+      stats s;
+      s.capacity = _capacity;
+      for( uint32_t i = 0; i < shard_count; ++i ) {
+         std::lock_guard<std::mutex> lock( _shards[i].mtx );
+         s.entries   += _shards[i].cache.size();
+         s.hits      += _shards[i].hits;
+         s.misses    += _shards[i].misses;
+         s.evictions += _shards[i].evictions;
+      }
+      return s;
+   }
+
+} } // eosio::chain
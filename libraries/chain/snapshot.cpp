@@ -1,14 +1,43 @@
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/compression.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace eosio { namespace chain { namespace detail {
+
+   /// where the rows of a chunk of a section are in a version 2 snapshot
+   struct snapshot_chunk_entry {
+      uint64_t pos       = 0;  ///< from the start of the snapshot
+      uint64_t size      = 0;  ///< as stored
+      uint64_t raw_size  = 0;  ///< of the packed rows, the same as size unless the snapshot is compressed
+      uint64_t row_count = 0;
+   };
+
+   struct snapshot_section_entry {
+      std::string                       name;
+      uint64_t                          row_count = 0;
+      std::vector<snapshot_chunk_entry> chunks;
+   };
+
+} } } /// namespace eosio::chain::detail
+
+FC_REFLECT(eosio::chain::detail::snapshot_chunk_entry, (pos)(size)(raw_size)(row_count))
+FC_REFLECT(eosio::chain::detail::snapshot_section_entry, (name)(row_count)(chunks))
+
 namespace eosio { namespace chain {
 
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
 : snapshot(snapshot)
 {
    snapshot.set("sections", fc::variants());
-   snapshot.set("version", current_snapshot_version );
+   snapshot.set("version", unchunked_snapshot_format_version );
 }
 
 void variant_snapshot_writer::write_start_section( const std::string& section_name ) {
@@ -46,9 +75,9 @@ void variant_snapshot_reader::validate() const {
    EOS_ASSERT(version.is_integer(), snapshot_validation_exception,
          "Variant snapshot version is not an integer");
 
-   EOS_ASSERT(version.as_uint64() == (uint64_t)current_snapshot_version, snapshot_validation_exception,
+   EOS_ASSERT(version.as_uint64() == (uint64_t)unchunked_snapshot_format_version, snapshot_validation_exception,
          "Variant snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
-         ("expected", current_snapshot_version)("actual",o["version"].as_uint64()));
+         ("expected", unchunked_snapshot_format_version)("actual",o["version"].as_uint64()));
 
    EOS_ASSERT(o.contains("sections"), snapshot_validation_exception,
          "Variant snapshot has no sections");
@@ -125,7 +154,7 @@ ostream_snapshot_writer::ostream_snapshot_writer(std::ostream& snapshot)
    snapshot.write((char*)&totem, sizeof(totem));
 
    // write version
-   auto version = current_snapshot_version;
+   auto version = unchunked_snapshot_format_version;
    snapshot.write((char*)&version, sizeof(version));
 }
 
@@ -212,7 +241,7 @@ void istream_snapshot_reader::validate() const {
                  "Binary snapshot has unexpected magic number!");
 
       // validate version
-      auto expected_version = current_snapshot_version;
+      auto expected_version = unchunked_snapshot_format_version;
       decltype(expected_version) actual_version;
       snapshot.read((char*)&actual_version, sizeof(actual_version));
       EOS_ASSERT(actual_version == expected_version, snapshot_exception,
@@ -246,7 +275,7 @@ bool istream_snapshot_reader::has_section( const string& section_name ) {
       snapshot.seekg(pos);
    });
 
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(unchunked_snapshot_format_version);
 
    auto next_section_pos = header_pos + header_size;
 
@@ -284,7 +313,7 @@ void istream_snapshot_reader::set_section( const string& section_name ) {
       snapshot.seekg(pos);
    });
 
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(unchunked_snapshot_format_version);
 
    auto next_section_pos = header_pos + header_size;
 
@@ -336,6 +365,611 @@ void istream_snapshot_reader::clear_section() {
    cur_row = 0;
 }
 
+namespace detail {
+   enum class snapshot_compression : uint32_t {
+      none = 0,
+      zlib = 1
+   };
+
+   /// magic number, version, compression and the position of the directory
+   const std::streamoff sectioned_header_size = sizeof(uint32_t) * 3 + sizeof(uint64_t);
+
+   /// packed rows of a section, compressed once sealed if the snapshot is
+   struct snapshot_chunk {
+      bytes    data;
+      uint64_t raw_size  = 0;
+      uint64_t row_count = 0;
+   };
+
+   static snapshot_chunk seal_chunk( snapshot_chunk&& chunk, bool compress ) {
+      chunk.raw_size = chunk.data.size();
+      if( compress ) {
+         chunk.data = zlib_compress( chunk.data.data(), chunk.data.size() );
+      }
+      return std::move(chunk);
+   }
+
+   static bytes unseal_chunk( bytes&& stored, uint64_t raw_size, bool compressed ) {
+      if( !compressed ) {
+         return std::move(stored);
+      }
+      auto raw = zlib_decompress( stored.data(), stored.size() );
+      EOS_ASSERT(raw.size() == raw_size, snapshot_exception,
+                 "Binary snapshot chunk decompressed to ${actual} bytes instead of ${expected}",
+                 ("actual", raw.size())("expected", raw_size));
+      return raw;
+   }
+
+   /// gathers rows into a chunk until it reaches the chunk size
+   struct snapshot_chunk_builder {
+      snapshot_chunk_builder( uint64_t chunk_size )
+      :chunk_size(chunk_size)
+      {
+      }
+
+      void add_row( const abstract_snapshot_row_writer& row_writer ) {
+         auto restore = current.data.size();
+         try {
+            buffer_wrapper out(current.data);
+            row_writer.write(out);
+         } catch (...) {
+            current.data.resize(restore);
+            throw;
+         }
+         ++current.row_count;
+      }
+
+      bool full() const  { return current.data.size() >= chunk_size; }
+      bool empty() const { return current.row_count == 0; }
+
+      snapshot_chunk take() {
+         snapshot_chunk result = std::move(current);
+         current = snapshot_chunk();
+         return result;
+      }
+
+      uint64_t       chunk_size;
+      snapshot_chunk current;
+   };
+
+   /**
+    * Collects the rows of one part of a section into sealed chunks, on whichever thread produces the part
+    */
+   class snapshot_part_writer : public snapshot_writer {
+      public:
+         snapshot_part_writer( bool compress, uint64_t chunk_size )
+         :compress(compress)
+         ,rows(chunk_size)
+         {
+         }
+
+         std::vector<snapshot_chunk> finish() {
+            if( !rows.empty() ) {
+               chunks.emplace_back( seal_chunk( rows.take(), compress ) );
+            }
+            return std::move(chunks);
+         }
+
+      protected:
+         void write_start_section( const std::string& ) override {
+            EOS_THROW(snapshot_exception, "Attempting to write a new section within a part of a section");
+         }
+
+         void write_row( const abstract_snapshot_row_writer& row_writer ) override {
+            rows.add_row(row_writer);
+            if( rows.full() ) {
+               chunks.emplace_back( seal_chunk( rows.take(), compress ) );
+            }
+         }
+
+         void write_end_section( ) override {
+            EOS_THROW(snapshot_exception, "Attempting to close a section within a part of a section");
+         }
+
+      private:
+         bool                        compress;
+         snapshot_chunk_builder      rows;
+         std::vector<snapshot_chunk> chunks;
+   };
+}
+
+struct sectioned_snapshot_writer_impl {
+   sectioned_snapshot_writer_impl( std::ostream& snapshot, uint32_t threads, bool compress, uint64_t chunk_size )
+   :snapshot(snapshot)
+   ,header_pos(snapshot.tellp())
+   ,threads(threads)
+   ,compress(compress)
+   ,rows(std::max<uint64_t>(chunk_size, 1))
+   {
+      if( threads > 1 ) {
+         thread_pool = std::make_unique<boost::asio::thread_pool>( threads );
+      }
+   }
+
+   ~sectioned_snapshot_writer_impl() {
+      if( output.joinable() ) {
+         {
+            std::lock_guard<std::mutex> g( output_mtx );
+            queued.clear();
+            stop_output = true;
+         }
+         output_cv.notify_all();
+         output.join();
+      }
+      if( thread_pool ) {
+         thread_pool->join();
+      }
+   }
+
+   /// a chunk of the section at index section, sealed already or left to the output thread to seal
+   struct queued_chunk {
+      size_t                               section = 0;
+      std::future<detail::snapshot_chunk>  chunk;
+      bool                                 sealed = false;
+   };
+
+   /// chunks or parts in flight at once, enough to keep every thread busy while the earliest one is written out
+   size_t window() const {
+      return 2 * std::max<uint32_t>( threads, 1 );
+   }
+
+   static std::future<detail::snapshot_chunk> ready( detail::snapshot_chunk&& chunk ) {
+      std::promise<detail::snapshot_chunk> p;
+      p.set_value( std::move(chunk) );
+      return p.get_future();
+   }
+
+   void start_output() {
+      output = std::thread( [this]() { run_output(); } );
+   }
+
+   /**
+    * Writes the queued chunks to the stream in order, each once it is sealed, and records them in the directory. The
+    * rows are only ever read from the state on the calling thread; sealing what is left unsealed and all of the
+    * writing happen here, alongside it.
+    */
+   void run_output() {
+      std::unique_lock<std::mutex> lk( output_mtx );
+      while( true ) {
+         output_cv.wait( lk, [this]() { return !queued.empty() || stop_output; } );
+         if( queued.empty() ) {
+            return;
+         }
+         queued_chunk next = std::move( queued.front() );
+         queued.pop_front();
+         output_cv.notify_all();
+         lk.unlock();
+
+         try {
+            auto chunk = next.chunk.get();
+            if( !next.sealed ) {
+               chunk = detail::seal_chunk( std::move(chunk), compress );
+            }
+
+            detail::snapshot_chunk_entry entry;
+            entry.pos       = snapshot.tellp() - header_pos;
+            entry.size      = chunk.data.size();
+            entry.raw_size  = chunk.raw_size;
+            entry.row_count = chunk.row_count;
+            snapshot.write(chunk.data.data(), chunk.data.size());
+
+            lk.lock();
+            auto& section = sections[next.section];
+            section.row_count += chunk.row_count;
+            section.chunks.emplace_back(entry);
+         } catch( ... ) {
+            if( !lk.owns_lock() ) {
+               lk.lock();
+            }
+            output_error = std::current_exception();
+            queued.clear();
+            output_cv.notify_all();
+            return;
+         }
+      }
+   }
+
+   /// hands a chunk of the current section to the output thread, waiting while the window is full
+   void queue_chunk( std::future<detail::snapshot_chunk>&& chunk, bool sealed ) {
+      std::unique_lock<std::mutex> lk( output_mtx );
+      output_cv.wait( lk, [this]() { return queued.size() < window() || output_error; } );
+      if( output_error ) {
+         std::rethrow_exception( output_error );
+      }
+      queued.push_back( queued_chunk{ sections.size() - 1, std::move(chunk), sealed } );
+      output_cv.notify_all();
+   }
+
+   /// waits for every queued chunk to be written and stops the output thread
+   void stop_writing() {
+      if( !output.joinable() ) {
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> g( output_mtx );
+         stop_output = true;
+      }
+      output_cv.notify_all();
+      output.join();
+      if( output_error ) {
+         std::rethrow_exception( output_error );
+      }
+   }
+
+   /// hands over the rows gathered so far, to be compressed on the pool or else by the output thread
+   void seal_rows() {
+      if( rows.empty() ) {
+         return;
+      }
+
+      if( !thread_pool || !compress ) {
+         queue_chunk( ready( rows.take() ), false );
+         return;
+      }
+
+      queue_chunk( async_thread_pool( *thread_pool, [chunk = rows.take()]() mutable {
+         return detail::seal_chunk( std::move(chunk), true );
+      }), true );
+   }
+
+   detail::ostream_wrapper                          snapshot;
+   std::streampos                                   header_pos;
+   uint32_t                                         threads;
+   bool                                             compress;
+   detail::snapshot_chunk_builder                   rows;
+   bool                                             in_section = false;
+   std::unique_ptr<boost::asio::thread_pool>        thread_pool;
+
+   std::thread                                      output;
+   std::mutex                                       output_mtx; ///< guards the members below
+   std::condition_variable                          output_cv;  ///< signalled when a chunk is queued or taken, or output is to stop
+   std::deque<queued_chunk>                         queued;
+   std::vector<detail::snapshot_section_entry>      sections;
+   bool                                             stop_output = false;
+   std::exception_ptr                               output_error;
+};
+
+sectioned_snapshot_writer::sectioned_snapshot_writer(std::ostream& snapshot, uint32_t threads, bool compress, uint64_t chunk_size)
+:my(std::make_unique<sectioned_snapshot_writer_impl>(snapshot, threads, compress, chunk_size))
+{
+   // write magic number
+   auto totem = ostream_snapshot_writer::magic_number;
+   snapshot.write((char*)&totem, sizeof(totem));
+
+   // write version
+   auto version = chunked_snapshot_format_version;
+   snapshot.write((char*)&version, sizeof(version));
+
+   // write compression
+   auto compression = compress ? detail::snapshot_compression::zlib : detail::snapshot_compression::none;
+   snapshot.write((char*)&compression, sizeof(compression));
+
+   // write a placeholder for the position of the directory
+   uint64_t placeholder = std::numeric_limits<uint64_t>::max();
+   snapshot.write((char*)&placeholder, sizeof(placeholder));
+
+   // the stream belongs to the output thread from here until finalize
+   my->start_output();
+}
+
+sectioned_snapshot_writer::~sectioned_snapshot_writer() = default;
+
+void sectioned_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(!my->in_section, snapshot_exception, "Attempting to write a new section without closing the previous section");
+   {
+      std::lock_guard<std::mutex> g( my->output_mtx );
+      my->sections.emplace_back();
+      my->sections.back().name = section_name;
+   }
+   my->in_section = true;
+}
+
+void sectioned_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   my->rows.add_row(row_writer);
+   if( my->rows.full() ) {
+      my->seal_rows();
+   }
+}
+
+void sectioned_snapshot_writer::write_end_section( ) {
+   my->seal_rows();
+   my->in_section = false;
+}
+
+void sectioned_snapshot_writer::write_parts( uint32_t parts, const std::function<void(uint32_t, section_writer&)>& f ) {
+   if( !my->thread_pool || parts < 2 ) {
+      snapshot_writer::write_parts(parts, f);
+      return;
+   }
+
+   // rows added to the section before its parts come ahead of them
+   my->seal_rows();
+
+   const bool compress = my->compress;
+   const uint64_t chunk_size = my->rows.chunk_size;
+   auto produce = [&f, compress, chunk_size]( uint32_t part ) {
+      detail::snapshot_part_writer part_writer( compress, chunk_size );
+      auto section = make_section_writer( part_writer );
+      f( part, section );
+      return part_writer.finish();
+   };
+
+   std::deque<std::future<std::vector<detail::snapshot_chunk>>> produced;
+
+   // the parts refer to f and whatever it reads, so none may be left running if handing them over fails
+   auto wait_for_parts = fc::make_scoped_exit([&produced](){
+      for( auto& p : produced ) {
+         if( p.valid() ) {
+            p.wait();
+         }
+      }
+   });
+
+   uint32_t next_part = 0;
+   while( next_part < parts || !produced.empty() ) {
+      while( next_part < parts && produced.size() < my->window() ) {
+         produced.emplace_back( async_thread_pool( *my->thread_pool, [&produce, part = next_part]() {
+            return produce( part );
+         }));
+         ++next_part;
+      }
+
+      auto chunks = produced.front().get();
+      produced.pop_front();
+      for( auto& chunk : chunks ) {
+         my->queue_chunk( my->ready( std::move(chunk) ), true );
+      }
+   }
+}
+
+void sectioned_snapshot_writer::finalize() {
+   EOS_ASSERT(!my->in_section, snapshot_exception, "Attempting to finalize a snapshot without closing the last section");
+   my->stop_writing();
+
+   auto& snapshot = my->snapshot;
+   uint64_t directory_pos = snapshot.tellp() - my->header_pos;
+
+   // write the directory
+   auto directory = fc::raw::pack( my->sections );
+   snapshot.write(directory.data(), directory.size());
+
+   // fill in its position
+   auto restore = snapshot.tellp();
+   snapshot.seekp(my->header_pos + std::streamoff(sizeof(uint32_t) * 3));
+   snapshot.write((char*)&directory_pos, sizeof(directory_pos));
+   snapshot.seekp(restore);
+}
+
+struct sectioned_snapshot_reader_impl {
+   sectioned_snapshot_reader_impl( std::istream& snapshot, uint32_t threads )
+   :snapshot(snapshot)
+   ,header_pos(snapshot.tellg())
+   ,threads(threads)
+   {
+      if( threads > 1 ) {
+         thread_pool = std::make_unique<boost::asio::thread_pool>( threads );
+      }
+   }
+
+   ~sectioned_snapshot_reader_impl() {
+      if( thread_pool ) {
+         thread_pool->join();
+      }
+   }
+
+   /// reads the header and the directory the first time either is needed
+   void load_directory() {
+      if( loaded ) {
+         return;
+      }
+
+      auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg(),ex=snapshot.exceptions()](){
+         snapshot.seekg(pos);
+         snapshot.exceptions(ex);
+      });
+
+      snapshot.exceptions(std::istream::failbit|std::istream::eofbit);
+
+      try {
+         snapshot.seekg(header_pos);
+
+         // validate totem
+         auto expected_totem = ostream_snapshot_writer::magic_number;
+         decltype(expected_totem) actual_totem;
+         snapshot.read((char*)&actual_totem, sizeof(actual_totem));
+         EOS_ASSERT(actual_totem == expected_totem, snapshot_exception,
+                    "Binary snapshot has unexpected magic number!");
+
+         // validate version
+         auto expected_version = chunked_snapshot_format_version;
+         decltype(expected_version) actual_version;
+         snapshot.read((char*)&actual_version, sizeof(actual_version));
+         EOS_ASSERT(actual_version == expected_version, snapshot_exception,
+                    "Binary snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+                    ("expected", expected_version)("actual", actual_version));
+
+         detail::snapshot_compression compression;
+         snapshot.read((char*)&compression, sizeof(compression));
+         EOS_ASSERT(compression == detail::snapshot_compression::none || compression == detail::snapshot_compression::zlib,
+                    snapshot_exception, "Binary snapshot has unknown compression ${c}", ("c", (uint32_t)compression));
+
+         snapshot.read((char*)&directory_pos, sizeof(directory_pos));
+         EOS_ASSERT(directory_pos != std::numeric_limits<uint64_t>::max(), snapshot_exception,
+                    "Binary snapshot was not finalized, it has no directory");
+
+         snapshot.seekg(header_pos + std::streamoff(directory_pos));
+         fc::raw::unpack(snapshot, sections);
+
+         compressed = compression == detail::snapshot_compression::zlib;
+         loaded = true;
+      } catch( const std::exception& e ) {
+         snapshot_exception fce(FC_LOG_MESSAGE( warn, "Binary snapshot directory could not be read (${what})",("what",e.what())));
+         throw fce;
+      }
+   }
+
+   const detail::snapshot_section_entry* find_section( const std::string& section_name ) {
+      load_directory();
+      for( const auto& section : sections ) {
+         if( section.name == section_name ) {
+            return &section;
+         }
+      }
+      return nullptr;
+   }
+
+   /// chunks read ahead of the one being read from at once, enough to keep every thread decompressing
+   size_t window() const {
+      return thread_pool ? 2 * threads : 1;
+   }
+
+   /// reads the next chunks of the section, handing their decompression to the pool
+   void read_ahead() {
+      while( next_read < cur_section->chunks.size() && pending.size() < window() ) {
+         const auto& entry = cur_section->chunks[next_read++];
+
+         bytes stored(entry.size);
+         snapshot.seekg(header_pos + std::streamoff(entry.pos));
+         snapshot.read(stored.data(), stored.size());
+         EOS_ASSERT(snapshot.good(), snapshot_exception, "Binary snapshot chunk in section ${n} could not be read",
+                    ("n", cur_section->name));
+
+         if( thread_pool && compressed ) {
+            pending.emplace_back( async_thread_pool( *thread_pool, [stored = std::move(stored), raw_size = entry.raw_size]() mutable {
+               return detail::unseal_chunk( std::move(stored), raw_size, true );
+            }));
+         } else {
+            std::promise<bytes> ready;
+            ready.set_value( detail::unseal_chunk( std::move(stored), entry.raw_size, compressed ) );
+            pending.emplace_back( ready.get_future() );
+         }
+      }
+   }
+
+   void next_chunk() {
+      EOS_ASSERT(!pending.empty(), snapshot_exception, "Binary snapshot section ${n} has fewer rows than recorded",
+                 ("n", cur_section->name));
+
+      cur_data = pending.front().get();
+      pending.pop_front();
+      chunk_rows_left = cur_section->chunks[cur_chunk++].row_count;
+      cur_stream = fc::datastream<const char*>(cur_data.data(), cur_data.size());
+
+      read_ahead();
+   }
+
+   void clear_section() {
+      cur_section = nullptr;
+      pending.clear();
+      cur_data.clear();
+      cur_stream = fc::datastream<const char*>(nullptr, 0);
+      next_read = 0;
+      cur_chunk = 0;
+      chunk_rows_left = 0;
+      cur_row = 0;
+   }
+
+   std::istream&                                 snapshot;
+   std::streampos                                header_pos;
+   uint32_t                                      threads;
+   bool                                          loaded = false;
+   bool                                          compressed = false;
+   uint64_t                                      directory_pos = 0;
+   std::vector<detail::snapshot_section_entry>   sections;
+
+   const detail::snapshot_section_entry*         cur_section = nullptr;
+   std::deque<std::future<bytes>>                pending;
+   bytes                                         cur_data;
+   fc::datastream<const char*>                   cur_stream{nullptr, 0};
+   size_t                                        next_read = 0;       ///< next chunk to read from the stream
+   size_t                                        cur_chunk = 0;       ///< next chunk to read rows from
+   uint64_t                                      chunk_rows_left = 0;
+   uint64_t                                      cur_row = 0;
+
+   std::unique_ptr<boost::asio::thread_pool>     thread_pool;
+};
+
+sectioned_snapshot_reader::sectioned_snapshot_reader(std::istream& snapshot, uint32_t threads)
+:my(std::make_unique<sectioned_snapshot_reader_impl>(snapshot, threads))
+{
+}
+
+sectioned_snapshot_reader::~sectioned_snapshot_reader() = default;
+
+void sectioned_snapshot_reader::validate() const {
+   my->load_directory();
+
+   const uint64_t data_begin = detail::sectioned_header_size;
+   for( const auto& section : my->sections ) {
+      uint64_t row_count = 0;
+      for( const auto& chunk : section.chunks ) {
+         EOS_ASSERT(chunk.pos >= data_begin && chunk.pos <= my->directory_pos && chunk.size <= my->directory_pos - chunk.pos,
+                    snapshot_exception, "Binary snapshot chunk in section ${n} lies outside of the rows", ("n", section.name));
+         EOS_ASSERT(my->compressed || chunk.size == chunk.raw_size, snapshot_exception,
+                    "Binary snapshot chunk in section ${n} has mismatched sizes", ("n", section.name));
+         EOS_ASSERT(chunk.row_count > 0, snapshot_exception, "Binary snapshot chunk in section ${n} has no rows", ("n", section.name));
+         row_count += chunk.row_count;
+      }
+      EOS_ASSERT(row_count == section.row_count, snapshot_exception,
+                 "Binary snapshot section ${n} records ${expected} rows but its chunks hold ${actual}",
+                 ("n", section.name)("expected", section.row_count)("actual", row_count));
+   }
+}
+
+bool sectioned_snapshot_reader::has_section( const string& section_name ) {
+   return my->find_section(section_name) != nullptr;
+}
+
+void sectioned_snapshot_reader::set_section( const string& section_name ) {
+   const auto* section = my->find_section(section_name);
+   EOS_ASSERT(section != nullptr, snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+
+   my->clear_section();
+   my->cur_section = section;
+   my->read_ahead();
+}
+
+bool sectioned_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   if( my->chunk_rows_left == 0 ) {
+      my->next_chunk();
+   }
+
+   row_reader.provide(my->cur_stream);
+
+   if( --my->chunk_rows_left == 0 ) {
+      EOS_ASSERT(my->cur_stream.remaining() == 0, snapshot_exception,
+                 "Binary snapshot chunk in section ${n} holds more than its rows", ("n", my->cur_section->name));
+   }
+   return ++my->cur_row < my->cur_section->row_count;
+}
+
+bool sectioned_snapshot_reader::empty ( ) {
+   return my->cur_section->row_count == 0;
+}
+
+void sectioned_snapshot_reader::clear_section() {
+   my->clear_section();
+}
+
+snapshot_reader_ptr make_istream_snapshot_reader( std::istream& snapshot, uint32_t threads ) {
+   auto pos = snapshot.tellg();
+
+   uint32_t totem = 0;
+   uint32_t version = 0;
+   snapshot.read((char*)&totem, sizeof(totem));
+   snapshot.read((char*)&version, sizeof(version));
+   const bool sectioned = snapshot.good() && totem == ostream_snapshot_writer::magic_number && version == chunked_snapshot_format_version;
+
+   snapshot.clear();
+   snapshot.seekg(pos);
+
+   if( sectioned ) {
+      return std::make_shared<sectioned_snapshot_reader>(snapshot, threads);
+   }
+   // anything else is left to the reader of version 1 snapshots to validate and report
+   return std::make_shared<istream_snapshot_reader>(snapshot);
+}
+
 integrity_hash_snapshot_writer::integrity_hash_snapshot_writer(fc::sha256::encoder& enc)
 :enc(enc)
 {
@@ -4,7 +4,6 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
-#include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 
 #pragma push_macro("N")
@@ -153,6 +152,7 @@ namespace bacc = boost::accumulators;
    ,trx(t)
    ,id(trx_id)
    ,undo_session()
+   ,dedup_undo_session()
    ,trace(std::make_shared<transaction_trace>())
    ,start(s)
    ,net_usage(trace->net_usage)
@@ -160,12 +160,13 @@ namespace bacc = boost::accumulators;
    {
       if (!c.skip_db_sessions()) {
          undo_session = c.mutable_db().start_undo_session(true);
+         dedup_undo_session = c.mutable_transaction_dedup_store().start_undo_session(true);
       }
       trace->id = id;
       trace->block_num = c.pending_block_state()->block_num;
       trace->block_time = c.pending_block_time();
       trace->producer_block_id = c.pending_producer_block_id();
-      executed.reserve( trx.total_actions() );
+      executed_action_digests.reserve( trx.total_actions() );
       EOS_ASSERT( trx.transaction_extensions.size() == 0, unsupported_feature, "we don't support any extensions yet" );
    }
 
@@ -405,10 +406,12 @@ namespace bacc = boost::accumulators;
 
    void transaction_context::squash() {
       if (undo_session) undo_session->squash();
+      if (dedup_undo_session) dedup_undo_session->squash();
    }
 
    void transaction_context::undo() {
       if (undo_session) undo_session->undo();
+      if (dedup_undo_session) dedup_undo_session->undo();
    }
 
    void transaction_context::check_net_usage()const {
@@ -601,17 +604,8 @@ namespace bacc = boost::accumulators;
    }
 
    void transaction_context::record_transaction( const transaction_id_type& id, fc::time_point_sec expire ) {
-      try {
-          control.mutable_db().create<transaction_object>([&](transaction_object& transaction) {
-              transaction.trx_id = id;
-              transaction.expiration = expire;
-          });
-      } catch( const boost::interprocess::bad_alloc& ) {
-         throw;
-      } catch ( ... ) {
-          EOS_ASSERT( false, tx_duplicate,
-                     "duplicate transaction ${id}", ("id", id ) );
-      }
+      EOS_ASSERT( control.mutable_transaction_dedup_store().add( id, expire ), tx_duplicate,
+                  "duplicate transaction ${id}", ("id", id ) );
    } /// record_transaction
 
    void transaction_context::validate_referenced_accounts( const transaction& trx, bool enforce_actor_whitelist_blacklist )const {
@@ -0,0 +1,241 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/transaction_dedup_store.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
+#include <fc/io/fstream.hpp>
+#include <fstream>
+#include <iterator>
+
+namespace eosio { namespace chain {
+
+   transaction_dedup_store::session::session( transaction_dedup_store& store, int64_t revision )
+   :_store(&store)
+   ,_apply(revision != -1)
+   ,_revision(revision)
+   {}
+
+   transaction_dedup_store::session::session( session&& s )
+   :_store(s._store)
+   ,_apply(s._apply)
+   ,_revision(s._revision)
+   {
+      s._apply = false;
+   }
+
+   transaction_dedup_store::session& transaction_dedup_store::session::operator=( session&& s ) {
+      if( this == &s ) return *this;
+      if( _apply ) undo();
+      _store    = s._store;
+      _apply    = s._apply;
+      _revision = s._revision;
+      s._apply  = false;
+      return *this;
+   }
+
+   transaction_dedup_store::session::~session() {
+      if( _apply ) undo();
+   }
+
+   void transaction_dedup_store::session::push() {
+      _apply = false;
+   }
+
+   void transaction_dedup_store::session::squash() {
+      if( _apply ) _store->squash();
+      _apply = false;
+   }
+
+   void transaction_dedup_store::session::undo() {
+      if( _apply ) _store->undo();
+      _apply = false;
+   }
+
+   transaction_dedup_store::transaction_dedup_store( const fc::path& data_dir )
+   :_datadir(data_dir)
+   {
+      if( _datadir.empty() ) return;
+
+      if( !fc::is_directory( _datadir ) )
+         fc::create_directories( _datadir );
+
+      auto dedup_dat = _datadir / config::trx_dedup_filename;
+      if( fc::exists( dedup_dat ) ) {
+         string content;
+         fc::read_file_contents( dedup_dat, content );
+
+         fc::datastream<const char*> ds( content.data(), content.size() );
+         fc::raw::unpack( ds, _revision );
+         fc::raw::unpack( ds, _next_seq );
+
+         unsigned_int num_buckets; fc::raw::unpack( ds, num_buckets );
+         for( uint32_t i = 0, n = num_buckets.value; i < n; ++i ) {
+            uint32_t expiration;
+            fc::raw::unpack( ds, expiration );
+            auto& bucket = _buckets[expiration];
+            fc::raw::unpack( ds, bucket );
+            for( const auto& e : bucket )
+               _ids.insert( e.id );
+         }
+
+         unsigned_int num_sessions; fc::raw::unpack( ds, num_sessions );
+         for( uint32_t i = 0, n = num_sessions.value; i < n; ++i ) {
+            _stack.emplace_back();
+            auto& state = _stack.back();
+            fc::raw::unpack( ds, state.revision );
+
+            unsigned_int num_changes; fc::raw::unpack( ds, num_changes );
+            state.changes.resize( num_changes.value );
+            for( auto& c : state.changes ) {
+               fc::raw::unpack( ds, c.expiration );
+               fc::raw::unpack( ds, c.id );
+               fc::raw::unpack( ds, c.expired );
+            }
+         }
+
+         fc::remove( dedup_dat );
+      }
+   }
+
+   transaction_dedup_store::~transaction_dedup_store() {
+      close();
+   }
+
+   void transaction_dedup_store::close() {
+      if( _datadir.empty() ) return;
+
+      auto dedup_dat = _datadir / config::trx_dedup_filename;
+      std::ofstream out( dedup_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+      fc::raw::pack( out, _revision );
+      fc::raw::pack( out, _next_seq );
+
+      fc::raw::pack( out, unsigned_int{static_cast<uint32_t>(_buckets.size())} );
+      for( const auto& b : _buckets ) {
+         fc::raw::pack( out, b.first );
+         fc::raw::pack( out, b.second );
+      }
+
+      fc::raw::pack( out, unsigned_int{static_cast<uint32_t>(_stack.size())} );
+      for( const auto& state : _stack ) {
+         fc::raw::pack( out, state.revision );
+         fc::raw::pack( out, unsigned_int{static_cast<uint32_t>(state.changes.size())} );
+         for( const auto& c : state.changes ) {
+            fc::raw::pack( out, c.expiration );
+            fc::raw::pack( out, c.id );
+            fc::raw::pack( out, c.expired );
+         }
+      }
+
+      _datadir = fc::path();
+   }
+
+   transaction_dedup_store::session transaction_dedup_store::start_undo_session( bool enabled ) {
+      if( !enabled )
+         return session( *this, -1 );
+
+      _stack.emplace_back();
+      _stack.back().revision = ++_revision;
+      return session( *this, _revision );
+   }
+
+   bool transaction_dedup_store::add( const transaction_id_type& id, time_point_sec expiration ) {
+      if( !_ids.insert( id ).second )
+         return false;
+
+      const uint32_t sec = expiration.sec_since_epoch();
+      _buckets[sec].push_back( entry{ _next_seq++, id } );
+      record( change{ sec, id, {} } );
+      return true;
+   }
+
+   bool transaction_dedup_store::contains( const transaction_id_type& id )const {
+      return _ids.find( id ) != _ids.end();
+   }
+
+   void transaction_dedup_store::clear_expired( time_point now ) {
+      while( !_buckets.empty() && now > fc::time_point( time_point_sec( _buckets.begin()->first ) ) ) {
+         auto itr = _buckets.begin();
+         for( const auto& e : itr->second )
+            _ids.erase( e.id );
+         record( change{ itr->first, transaction_id_type(), std::move( itr->second ) } );
+         _buckets.erase( itr );
+      }
+   }
+
+   void transaction_dedup_store::record( change&& c ) {
+      if( !_stack.empty() )
+         _stack.back().changes.emplace_back( std::move( c ) );
+   }
+
+   void transaction_dedup_store::revert( change& c ) {
+      if( c.expired.empty() ) {
+         // changes are reverted newest first, so an added id is always the last one of its bucket
+         auto itr = _buckets.find( c.expiration );
+         EOS_ASSERT( itr != _buckets.end() && !itr->second.empty() && itr->second.back().id == c.id, database_exception,
+                     "transaction deduplication undo state is inconsistent for ${id}", ("id", c.id) );
+         itr->second.pop_back();
+         if( itr->second.empty() )
+            _buckets.erase( itr );
+         _ids.erase( c.id );
+      } else {
+         for( const auto& e : c.expired )
+            _ids.insert( e.id );
+         auto res = _buckets.emplace( c.expiration, std::move( c.expired ) );
+         EOS_ASSERT( res.second, database_exception,
+                     "transaction deduplication undo state is inconsistent for expiration ${e}", ("e", c.expiration) );
+      }
+   }
+
+   void transaction_dedup_store::undo() {
+      if( _stack.empty() ) return;
+
+      auto& state = _stack.back();
+      for( auto itr = state.changes.rbegin(); itr != state.changes.rend(); ++itr )
+         revert( *itr );
+
+      _stack.pop_back();
+      --_revision;
+   }
+
+   void transaction_dedup_store::squash() {
+      if( _stack.empty() ) return;
+
+      if( _stack.size() > 1 ) {
+         auto& state = _stack.back();
+         auto& prev  = _stack[_stack.size() - 2];
+         prev.changes.reserve( prev.changes.size() + state.changes.size() );
+         std::move( state.changes.begin(), state.changes.end(), std::back_inserter( prev.changes ) );
+      }
+
+      _stack.pop_back();
+      --_revision;
+   }
+
+   void transaction_dedup_store::commit( int64_t revision ) {
+      while( !_stack.empty() && _stack.front().revision <= revision )
+         _stack.pop_front();
+   }
+
+   void transaction_dedup_store::undo_all() {
+      while( !_stack.empty() )
+         undo();
+   }
+
+   void transaction_dedup_store::set_revision( int64_t revision ) {
+      EOS_ASSERT( _stack.empty(), database_exception, "cannot set revision while there is an existing undo stack" );
+      _revision = revision;
+   }
+
+   transaction_dedup_store::stats transaction_dedup_store::get_stats()const {
+      stats s;
+      s.transactions  = _ids.size();
+      s.buckets       = _buckets.size();
+      s.undo_sessions = _stack.size();
+      for( const auto& state : _stack )
+         s.undo_changes += state.changes.size();
+      return s;
+   }
+
+} } // eosio::chain
@@ -1,16 +1,15 @@
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <boost/asio/thread_pool.hpp>
+#include <atomic>
 
 namespace eosio { namespace chain {
 
 recovery_keys_type transaction_metadata::recover_keys( const chain_id_type& chain_id ) {
    // Unlikely for more than one chain_id to be used in one nodeos instance
-   if( signing_keys_future.valid() ) {
+   if( signing_keys_future.valid() && signing_keys_chain_id && *signing_keys_chain_id == chain_id ) {
       const std::tuple<chain_id_type, fc::microseconds, flat_set<public_key_type>>& sig_keys = signing_keys_future.get();
-      if( std::get<0>( sig_keys ) == chain_id ) {
-         return std::make_pair( std::get<1>( sig_keys ), std::cref( std::get<2>( sig_keys ) ) );
-      }
+      return std::make_pair( std::get<1>( sig_keys ), std::cref( std::get<2>( sig_keys ) ) );
    }
 
    // shared_keys_future not created or different chain_id
@@ -20,6 +19,7 @@ recovery_keys_type transaction_metadata::recover_keys( const chain_id_type& chai
    fc::microseconds cpu_usage = trn.get_signature_keys( chain_id, fc::time_point::maximum(), recovered_pub_keys );
    p.set_value( std::make_tuple( chain_id, cpu_usage, std::move( recovered_pub_keys ) ) );
    signing_keys_future = p.get_future().share();
+   signing_keys_chain_id = chain_id;
 
    const std::tuple<chain_id_type, fc::microseconds, flat_set<public_key_type>>& sig_keys = signing_keys_future.get();
    return std::make_pair( std::get<1>( sig_keys ), std::cref( std::get<2>( sig_keys ) ) );
@@ -30,7 +30,7 @@ signing_keys_future_type transaction_metadata::start_recover_keys( const transac
                                                                    const chain_id_type& chain_id,
                                                                    fc::microseconds time_limit )
 {
-   if( mtrx->signing_keys_future.valid() && std::get<0>( mtrx->signing_keys_future.get() ) == chain_id ) // already created
+   if( mtrx->signing_keys_future.valid() && mtrx->signing_keys_chain_id && *mtrx->signing_keys_chain_id == chain_id ) // already created
       return mtrx->signing_keys_future;
 
    std::weak_ptr<transaction_metadata> mtrx_wp = mtrx;
@@ -46,9 +46,85 @@ signing_keys_future_type transaction_metadata::start_recover_keys( const transac
       }
       return std::make_tuple( chain_id, cpu_usage, std::move( recovered_pub_keys ));
    } );
+   mtrx->signing_keys_chain_id = chain_id;
 
    return mtrx->signing_keys_future;
 }
 
+std::future<key_recovery_report> transaction_metadata::start_recover_keys( const vector<transaction_metadata_ptr>& trxs,
+                                                                           boost::asio::thread_pool& thread_pool,
+                                                                           const chain_id_type& chain_id,
+                                                                           uint32_t max_chunks )
+{
+   struct batch {
+      vector<transaction_metadata_ptr>                      trxs;
+      vector<std::promise<signing_keys_future_value_type>>  keys;
+      fc::time_point                                        start = fc::time_point::now();
+      std::atomic<uint32_t>                                 remaining_chunks{0};
+      std::atomic<uint32_t>                                 signatures{0};
+      std::atomic<int64_t>                                  cpu_time_us{0};
+      std::promise<key_recovery_report>                     report;
+   };
+
+   auto b = std::make_shared<batch>();
+   b->trxs.reserve( trxs.size() );
+   for( const auto& mtrx : trxs ) {
+      if( mtrx->signing_keys_future.valid() && mtrx->signing_keys_chain_id && *mtrx->signing_keys_chain_id == chain_id ) {
+         // already created; only an attempt known to have failed is recovered again, without waiting on one running
+         if( mtrx->signing_keys_future.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+            continue;
+         try {
+            mtrx->signing_keys_future.get();
+            continue;
+         } catch( ... ) {}
+      }
+      b->trxs.push_back( mtrx );
+   }
+   b->keys.resize( b->trxs.size() );
+   for( size_t i = 0; i < b->trxs.size(); ++i ) {
+      b->trxs[i]->signing_keys_future = b->keys[i].get_future().share();
+      b->trxs[i]->signing_keys_chain_id = chain_id;
+   }
+
+   auto result = b->report.get_future();
+   const uint32_t chunks = std::min<size_t>( std::max<uint32_t>( max_chunks, 1 ), b->trxs.size() );
+   if( chunks == 0 ) {
+      b->report.set_value( key_recovery_report() );
+      return result;
+   }
+
+   b->remaining_chunks = chunks;
+   for( uint32_t chunk = 0; chunk < chunks; ++chunk ) {
+      boost::asio::post( thread_pool, [b, chain_id, chunk, chunks]() {
+         auto chunk_start = fc::time_point::now();
+         uint32_t signatures = 0;
+         for( size_t i = chunk; i < b->trxs.size(); i += chunks ) {
+            try {
+               flat_set<public_key_type> recovered_pub_keys;
+               const signed_transaction& trn = b->trxs[i]->packed_trx->get_signed_transaction();
+               fc::microseconds cpu_usage = trn.get_signature_keys( chain_id, fc::time_point::maximum(), recovered_pub_keys );
+               signatures += trn.signatures.size();
+               b->keys[i].set_value( std::make_tuple( chain_id, cpu_usage, std::move( recovered_pub_keys ) ) );
+            } catch( ... ) {
+               b->keys[i].set_exception( std::current_exception() );
+            }
+         }
+         b->signatures += signatures;
+         b->cpu_time_us += (fc::time_point::now() - chunk_start).count();
+
+         if( --b->remaining_chunks == 0 ) {
+            key_recovery_report r;
+            r.transactions = b->trxs.size();
+            r.signatures   = b->signatures;
+            r.cpu_time     = fc::microseconds( b->cpu_time_us );
+            r.wall_time    = fc::time_point::now() - b->start;
+            b->report.set_value( r );
+         }
+      } );
+   }
+
+   return result;
+}
+
 
 } } // eosio::chain
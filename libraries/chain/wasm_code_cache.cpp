@@ -0,0 +1,284 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/wasm_code_cache.hpp>
+#include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/asio/post.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      struct wasm_code_cache_entry {
+         uint32_t             format_version = 0;
+         digest_type          code_id;
+         uint32_t             injection_version = 0;
+         uint8_t              vm = 0;
+         string               runtime_version;
+         std::vector<uint8_t> code;
+         std::vector<uint8_t> initial_memory;
+         std::vector<uint8_t> object_code;
+         digest_type          checksum; ///< sha256 of all the fields above
+
+         digest_type compute_checksum()const {
+            digest_type::encoder enc;
+            fc::raw::pack( enc, format_version );
+            fc::raw::pack( enc, code_id );
+            fc::raw::pack( enc, injection_version );
+            fc::raw::pack( enc, vm );
+            fc::raw::pack( enc, runtime_version );
+            fc::raw::pack( enc, code );
+            fc::raw::pack( enc, initial_memory );
+            fc::raw::pack( enc, object_code );
+            return enc.result();
+         }
+      };
+   }
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::detail::wasm_code_cache_entry,
+            (format_version)(code_id)(injection_version)(vm)(runtime_version)(code)(initial_memory)(object_code)(checksum) )
+
+namespace eosio { namespace chain {
+
+   /**
+    * History:
+    * Version 1: initial format, one entry per file
+    * Version 2: adds the runtime version and the object code generated by the runtime
+    */
+   const uint32_t wasm_code_cache::format_version = 2;
+
+   wasm_code_cache::wasm_code_cache( const fc::path& dir, wasm_interface::vm_type vm, const string& runtime_version,
+                                     uint64_t max_size )
+   :_dir(dir), _vm(vm), _runtime_version(runtime_version), _max_size(max_size)
+   {
+      if( !enabled() )
+         return;
+
+      if( !fc::is_directory( _dir ) )
+         fc::create_directories( _dir );
+
+      // the entries written last were the ones used last as far as a new process can tell
+      std::vector<std::pair<std::time_t, lru_entry>> found;
+      for( boost::filesystem::directory_iterator itr( _dir ), end; itr != end; ++itr ) {
+         const fc::path path = itr->path();
+         if( !boost::filesystem::is_regular_file( itr->path() ) )
+            continue;
+         if( itr->path().extension() == ".tmp" ) {
+            fc::remove( path );
+         } else if( itr->path().extension() == ".wasm" ) {
+            found.emplace_back( boost::filesystem::last_write_time( itr->path() ), lru_entry{ path, fc::file_size( path ) } );
+         }
+      }
+      std::sort( found.begin(), found.end(), []( const auto& a, const auto& b ) { return a.first > b.first; } );
+      for( auto& f : found ) {
+         _size += f.second.size;
+         _lru.push_back( std::move( f.second ) );
+         _entries[_lru.back().path.generic_string()] = std::prev( _lru.end() );
+      }
+      evict();
+
+      _writer = std::make_unique<boost::asio::thread_pool>( 1 );
+   }
+
+   wasm_code_cache::~wasm_code_cache() {
+      if( _writer )
+         _writer->join();
+   }
+
+   fc::path wasm_code_cache::entry_path( const digest_type& code_id )const {
+      digest_type::encoder enc;
+      fc::raw::pack( enc, code_id );
+      fc::raw::pack( enc, wasm_injections::injection_version );
+      fc::raw::pack( enc, static_cast<uint8_t>(_vm) );
+      fc::raw::pack( enc, _runtime_version );
+      return _dir / (enc.result().str() + ".wasm");
+   }
+
+   bool wasm_code_cache::contains( const digest_type& code_id )const {
+      if( !enabled() )
+         return false;
+
+      const auto path = entry_path( code_id );
+      std::lock_guard<std::mutex> g( _mtx );
+      return _entries.find( path.generic_string() ) != _entries.end();
+   }
+
+   optional<wasm_prepared_code> wasm_code_cache::find( const digest_type& code_id ) {
+      if( !contains( code_id ) )
+         return optional<wasm_prepared_code>();
+
+      const auto path = entry_path( code_id );
+      auto prepared = read_entry( path, &code_id );
+      if( prepared )
+         touch( path );
+      return prepared;
+   }
+
+   void wasm_code_cache::for_each_recent( const std::function<bool(wasm_prepared_code&&)>& f ) {
+      if( !enabled() )
+         return;
+
+      std::vector<fc::path> paths;
+      {
+         std::lock_guard<std::mutex> g( _mtx );
+         paths.reserve( _lru.size() );
+         for( const auto& e : _lru )
+            paths.push_back( e.path );
+      }
+      // not touched, reading them all says nothing about which are used
+      for( const auto& path : paths ) {
+         auto prepared = read_entry( path, nullptr );
+         if( prepared && !f( std::move(*prepared) ) )
+            break;
+      }
+   }
+
+   /// code_id is checked against the entry if given, otherwise the entry has to be the one path is the key of
+   optional<wasm_prepared_code> wasm_code_cache::read_entry( const fc::path& path, const digest_type* code_id ) {
+      try {
+         string content;
+         fc::read_file_contents( path, content );
+
+         detail::wasm_code_cache_entry entry;
+         fc::datastream<const char*> ds( content.data(), content.size() );
+         fc::raw::unpack( ds, entry );
+
+         EOS_ASSERT( entry.format_version == format_version &&
+                     (code_id ? entry.code_id == *code_id : entry_path( entry.code_id ) == path) &&
+                     entry.injection_version == wasm_injections::injection_version &&
+                     entry.vm == static_cast<uint8_t>(_vm) &&
+                     entry.runtime_version == _runtime_version &&
+                     entry.checksum == entry.compute_checksum(),
+                     wasm_exception, "code cache entry does not match its key" );
+
+         return wasm_prepared_code{ entry.code_id, std::move(entry.code), std::move(entry.initial_memory),
+                                    std::move(entry.object_code) };
+      } catch( const fc::exception& e ) {
+         wlog( "discarding unreadable code cache entry ${p}: ${e}", ("p", path.generic_string())("e", e.to_string()) );
+      } catch( const std::exception& e ) {
+         wlog( "discarding unreadable code cache entry ${p}: ${e}", ("p", path.generic_string())("e", e.what()) );
+      }
+
+      // removed on the writer thread so that it cannot race a rewrite of the same entry
+      boost::asio::post( *_writer, [this, path]() {
+         std::lock_guard<std::mutex> g( _mtx );
+         auto itr = _entries.find( path.generic_string() );
+         if( itr != _entries.end() ) {
+            _size -= itr->second->size;
+            _lru.erase( itr->second );
+            _entries.erase( itr );
+         }
+         try {
+            fc::remove( path );
+         } FC_LOG_AND_DROP();
+      });
+      return optional<wasm_prepared_code>();
+   }
+
+   void wasm_code_cache::add( const wasm_prepared_code& prepared ) {
+      if( !enabled() )
+         return;
+
+      detail::wasm_code_cache_entry entry;
+      entry.format_version    = format_version;
+      entry.code_id           = prepared.code_id;
+      entry.injection_version = wasm_injections::injection_version;
+      entry.vm                = static_cast<uint8_t>(_vm);
+      entry.runtime_version   = _runtime_version;
+      entry.code              = prepared.code;
+      entry.initial_memory    = prepared.initial_memory;
+      entry.object_code       = prepared.object_code;
+      entry.checksum          = entry.compute_checksum();
+
+      boost::asio::post( *_writer, [this, path = entry_path( prepared.code_id ), content = fc::raw::pack( entry )]() {
+         write_entry( path, content );
+      });
+   }
+
+   void wasm_code_cache::flush() {
+      if( !enabled() )
+         return;
+
+      std::promise<void> written;
+      auto future = written.get_future();
+      boost::asio::post( *_writer, [&written]() { written.set_value(); } );
+      future.wait();
+   }
+
+   uint64_t wasm_code_cache::size()const {
+      std::lock_guard<std::mutex> g( _mtx );
+      return _size;
+   }
+
+   void wasm_code_cache::write_entry( const fc::path& path, const bytes& content ) {
+      auto tmp_path = path;
+      tmp_path.replace_extension( ".tmp" );
+
+      // a failure to persist only costs a recompile on the next restart
+      try {
+         {
+            std::ofstream out( tmp_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+            out.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+            out.write( content.data(), content.size() );
+         }
+         fc::rename( tmp_path, path );
+      } catch( ... ) {
+         try {
+            fc::remove( tmp_path );
+         } FC_LOG_AND_DROP();
+         wlog( "failed to write code cache entry ${p}", ("p", path.generic_string()) );
+         return;
+      }
+
+      std::lock_guard<std::mutex> g( _mtx );
+      auto itr = _entries.find( path.generic_string() );
+      if( itr != _entries.end() ) {
+         _size -= itr->second->size;
+         _lru.erase( itr->second );
+         _entries.erase( itr );
+      }
+      _lru.push_front( lru_entry{ path, content.size() } );
+      _entries[path.generic_string()] = _lru.begin();
+      _size += content.size();
+      evict();
+   }
+
+   void wasm_code_cache::touch( const fc::path& path ) {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto itr = _entries.find( path.generic_string() );
+      if( itr == _entries.end() )
+         return;
+      _lru.splice( _lru.begin(), _lru, itr->second );
+
+      // so that the next process finds the entries in the order they were last used
+      boost::asio::post( *_writer, [path]() {
+         boost::system::error_code ec;
+         boost::filesystem::last_write_time( path, std::time( nullptr ), ec );
+      });
+   }
+
+   /// called with the entries locked
+   void wasm_code_cache::evict() {
+      while( _size > _max_size && !_lru.empty() ) {
+         const auto& victim = _lru.back();
+         try {
+            fc::remove( victim.path );
+         } FC_LOG_AND_DROP();
+         _size -= victim.size;
+         _entries.erase( victim.path.generic_string() );
+         _lru.pop_back();
+      }
+   }
+
+} } // eosio::chain
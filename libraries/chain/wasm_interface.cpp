@@ -28,7 +28,9 @@ namespace eosio { namespace chain {
    using namespace webassembly;
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm) : my( new wasm_interface_impl(vm) ) {}
+   wasm_interface::wasm_interface(vm_type vm, const fc::path& code_cache_dir, uint64_t code_cache_max_size, uint64_t max_cache_size,
+                                  const tiering_policy& tiering)
+   : my( new wasm_interface_impl(vm, code_cache_dir, code_cache_max_size, max_cache_size, tiering) ) {}
 
    wasm_interface::~wasm_interface() {}
 
@@ -55,11 +57,23 @@ namespace eosio { namespace chain {
 	 }
 
    void wasm_interface::apply( const digest_type& code_id, const shared_string& code, apply_context& context ) {
-      my->get_instantiated_module(code_id, code, context.trx_context)->apply(context);
+      my->get_instantiated_module(code_id, code, context.trx_context).apply(context);
    }
 
    void wasm_interface::exit() {
-      my->runtime_interface->immediately_exit_currently_running_module();
+      my->current_runtime->immediately_exit_currently_running_module();
+   }
+
+   void wasm_interface::code_released( const digest_type& code_id ) {
+      my->demote(code_id);
+   }
+
+   wasm_interface::cache_stats wasm_interface::get_cache_stats()const {
+      return my->get_cache_stats();
+   }
+
+   void wasm_interface::wait_for_pending_compiles()const {
+      my->wait_for_pending_compiles();
    }
 
    wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
@@ -1911,6 +1925,8 @@ std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime) {
       runtime = eosio::chain::wasm_interface::vm_type::wavm;
    else if (s == "wabt")
       runtime = eosio::chain::wasm_interface::vm_type::wabt;
+   else if (s == "tiered")
+      runtime = eosio::chain::wasm_interface::vm_type::tiered;
    else
       in.setstate(std::ios_base::failbit);
    return in;
@@ -2,6 +2,7 @@
 #include <eosio/chain/wasm_eosio_constraints.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
 
 #include "IR/Module.h"
@@ -13,6 +14,7 @@
 #include "Runtime/Intrinsics.h"
 
 #include <mutex>
+#include <set>
 
 using namespace IR;
 using namespace Runtime;
@@ -21,13 +23,38 @@ namespace eosio { namespace chain { namespace webassembly { namespace wavm {
 
 running_instance_context the_running_instance_context;
 
+static weak_ptr<wavm_runtime::runtime_guard> __runtime_guard_ptr;
+static std::mutex __runtime_guard_lock;
+
+//instances still owned by a wavm_instantiated_module; these are the roots when collecting released instances.
+// Guarded by __runtime_guard_lock since WAVM's object graph is shared by every wavm_runtime
+static std::set<ModuleInstance*> __live_instances;
+static bool __collection_pending = false;
+
+//WAVM's object list and the LLVM context are process wide and unsynchronized, so instantiation and collection are
+// serialized. Running an already instantiated module does not touch either
+static std::mutex __instantiation_lock;
+
+//held while a module runs. Instantiation can happen on a background compile thread at the same time, but collection
+// frees generated code and objects, so it only happens while nothing runs and is otherwise left pending
+static std::mutex __execution_lock;
+
 class wavm_instantiated_module : public wasm_instantiated_module_interface {
    public:
       wavm_instantiated_module(ModuleInstance* instance, std::unique_ptr<Module> module, std::vector<uint8_t> initial_mem) :
          _initial_memory(initial_mem),
          _instance(instance),
          _module(std::move(module))
-      {}
+      {
+         std::lock_guard<std::mutex> l(__runtime_guard_lock);
+         __live_instances.insert(_instance);
+      }
+
+      ~wavm_instantiated_module() {
+         std::lock_guard<std::mutex> l(__runtime_guard_lock);
+         __live_instances.erase(_instance);
+         __collection_pending = true;
+      }
 
       void apply(apply_context& context) override {
          vector<Value> args = {Value(uint64_t(context.receiver)),
@@ -37,6 +64,10 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
          call("apply", args, context);
       }
 
+      std::vector<uint8_t> take_object_code() override {
+         return takeObjectCode(_instance);
+      }
+
    private:
       void call(const string &entry_point, const vector <Value> &args, apply_context &context) {
          try {
@@ -46,22 +77,28 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
 
             EOS_ASSERT( getFunctionType(call)->parameters.size() == args.size(), wasm_exception, "" );
 
+            std::lock_guard<std::mutex> execution_guard(__execution_lock);
+
             //The memory instance is reused across all wavm_instantiated_modules, but for wasm instances
             // that didn't declare "memory", getDefaultMemory() won't see it
             MemoryInstance* default_mem = getDefaultMemory(_instance);
             if(default_mem) {
                //reset memory resizes the sandbox'ed memory to the module's init memory size and then
-               // (effectively) memzeros it all
+               // (effectively) memzeros it all; only the pages dirtied by the previous call cost anything
                resetMemory(default_mem, _module->memories.defs[0].type);
 
-               char* memstart = &memoryRef<char>(getDefaultMemory(_instance), 0);
-               memcpy(memstart, _initial_memory.data(), _initial_memory.size());
+               //the image is bounded by maximum_linear_memory_init so this copy does not grow with the memory size
+               if(!_initial_memory.empty()) {
+                  char* memstart = &memoryRef<char>(getDefaultMemory(_instance), 0);
+                  memcpy(memstart, _initial_memory.data(), _initial_memory.size());
+               }
             }
 
             the_running_instance_context.memory = default_mem;
             the_running_instance_context.apply_ctx = &context;
 
             resetGlobalInstances(_instance);
+
             runInstanceStartFunc(_instance);
             Runtime::invokeFunction(call,args);
          } catch( const wasm_exit& e ) {
@@ -76,7 +113,8 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
 
       std::vector<uint8_t>     _initial_memory;
       //naked pointer because ModuleInstance is opaque
-      //_instance is deleted via WAVM's object garbage collection when wavm_rutime is deleted
+      //_instance is deleted via WAVM's object garbage collection on the next instantiation after this is destroyed
+      // that does not overlap a running module, or when the last wavm_runtime is deleted
       ModuleInstance*          _instance;
       std::unique_ptr<Module>  _module;
 };
@@ -92,9 +130,6 @@ wavm_runtime::runtime_guard::~runtime_guard() {
    Runtime::freeUnreferencedObjects({});
 }
 
-static weak_ptr<wavm_runtime::runtime_guard> __runtime_guard_ptr;
-static std::mutex __runtime_guard_lock;
-
 wavm_runtime::wavm_runtime() {
    std::lock_guard<std::mutex> l(__runtime_guard_lock);
    if (__runtime_guard_ptr.use_count() == 0) {
@@ -108,7 +143,29 @@ wavm_runtime::wavm_runtime() {
 wavm_runtime::~wavm_runtime() {
 }
 
-std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) {
+std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory,
+                                                                                     const std::vector<uint8_t>& object_code) {
+   std::lock_guard<std::mutex> instantiation_guard(__instantiation_lock);
+
+   //reclaim the generated code of modules evicted since the last instantiation, unless a module is running
+   std::unique_lock<std::mutex> execution_guard(__execution_lock, std::try_to_lock);
+   if(execution_guard.owns_lock()) {
+      std::vector<ObjectInstance*> roots;
+      bool collect = false;
+      {
+         std::lock_guard<std::mutex> l(__runtime_guard_lock);
+         std::swap(collect, __collection_pending);
+         if(collect) {
+            roots.reserve(__live_instances.size());
+            for(ModuleInstance* instance : __live_instances)
+               roots.push_back(asObject(instance));
+         }
+      }
+      if(collect)
+         Runtime::freeUnreferencedObjects(std::move(roots));
+      execution_guard.unlock();
+   }
+
    std::unique_ptr<Module> module = std::make_unique<Module>();
    try {
       Serialization::MemoryInputStream stream((const U8*)code_bytes, code_size);
@@ -119,14 +176,27 @@ std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_mo
       EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
    }
 
+   //the injected code only calls checktime once the poll flag is raised. The generated code reads the deadline
+   // timer's expired flag in its place, so loops cost a load instead of a host call until the deadline may have
+   // passed, and the timer's signal handler never writes to the storage of an instance that may be gone
+   static_assert(sizeof(deadline_timer::expired) == sizeof(I32), "the poll flag is an i32 global");
+   module->volatileGlobalIndex = wasm_injections::deadline_poll_global_index(*module);
+   module->volatileGlobalAddress = &deadline_timer::expired;
+
    eosio::chain::webassembly::common::root_resolver resolver;
    LinkResult link_result = linkModule(*module, resolver);
-   ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports));
+   //the generated code refers to the instance through symbols bound on load, so object code generated for another
+   // instance of the same code, even in another process, is loaded instead of compiling again
+   ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports), object_code);
    EOS_ASSERT(instance != nullptr, wasm_exception, "Fail to Instantiate WAVM Module");
 
    return std::make_unique<wavm_instantiated_module>(instance, std::move(module), initial_memory);
 }
 
+std::string wavm_runtime::object_code_version() {
+   return getObjectCodeVersion();
+}
+
 void wavm_runtime::immediately_exit_currently_running_module() {
 #ifdef _WIN32
    throw wasm_exit();
@@ -357,6 +357,8 @@ namespace eosio { namespace testing {
                vcfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
             else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
                vcfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
+            else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--tiered"))
+               vcfg.wasm_runtime = chain::wasm_interface::vm_type::tiered;
          }
          return vcfg;
       }
@@ -142,7 +142,14 @@ namespace IR
 
 		Uptr startFunctionIndex;
 
-		Module() : startFunctionIndex(UINTPTR_MAX) {}
+		// A mutable global that may be written from outside the module while its code runs, so that every get_global
+		// of it loads it again. Not part of the binary format, UINTPTR_MAX if there is none.
+		Uptr volatileGlobalIndex;
+		// When set, the volatile global is read from this address instead of its instance's storage, so that whatever
+		// writes it never depends on the lifetime of an instance. Not part of the binary format.
+		const volatile void* volatileGlobalAddress;
+
+		Module() : startFunctionIndex(UINTPTR_MAX), volatileGlobalIndex(UINTPTR_MAX), volatileGlobalAddress(nullptr) {}
 	};
 	
 	// Finds a named user section in a module.
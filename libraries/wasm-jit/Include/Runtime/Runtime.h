@@ -190,6 +190,9 @@ namespace Runtime
 	// Writes a new value to a global, and returns the previous value.
 	RUNTIME_API Value setGlobalValue(GlobalInstance* global,Value newValue);
 
+	// Gets the address the generated code loads a global's value from. Stores to it are seen by running code.
+	RUNTIME_API U8* getGlobalValueAddress(GlobalInstance* global);
+
 	//
 	// Modules
 	//
@@ -203,13 +206,24 @@ namespace Runtime
 	};
 
 	// Instantiates a module, bindings its imports to the specified objects. May throw InstantiationException.
-	RUNTIME_API ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports);
+	// objectCode is the object code taken from an earlier instance of the same module, which is loaded instead of
+	// generating the code again. Object code that can't be loaded is ignored and the code is generated.
+	RUNTIME_API ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports,const std::vector<U8>& objectCode = {});
+
+	// Takes the object code generated for a module instance, which is empty if it was loaded from object code.
+	RUNTIME_API std::vector<U8> takeObjectCode(ModuleInstance* moduleInstance);
+
+	// Object code is only loaded by a runtime of the same version, which covers the code generator and the target.
+	RUNTIME_API std::string getObjectCodeVersion();
 
 	// Gets the default table/memory for a ModuleInstance.
 	RUNTIME_API MemoryInstance* getDefaultMemory(ModuleInstance* moduleInstance);
 	RUNTIME_API uint64_t getDefaultMemorySize(ModuleInstance* moduleInstance);
 	RUNTIME_API TableInstance* getDefaultTable(ModuleInstance* moduleInstance);
 
+	// Gets a ModuleInstance's global by its index in the module's global index space.
+	RUNTIME_API GlobalInstance* getInstanceGlobal(ModuleInstance* moduleInstance,Uptr globalIndex);
+
 	RUNTIME_API void runInstanceStartFunc(ModuleInstance* moduleInstance);
 	RUNTIME_API void resetGlobalInstances(ModuleInstance* moduleInstance);
 	RUNTIME_API void resetMemory(MemoryInstance* memory, IR::MemoryType& newMemoryType);
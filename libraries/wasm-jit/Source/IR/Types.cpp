@@ -1,6 +1,7 @@
 #include "Types.h"
 
 #include <map>
+#include <mutex>
 
 namespace IR
 {
@@ -20,11 +21,18 @@ namespace IR
 			static std::map<Key,FunctionType*> map;
 			return map;
 		}
+		// Modules may be decoded on more than one thread at a time, e.g. while a native compile runs in the background.
+		static std::mutex& mutex()
+		{
+			static std::mutex m;
+			return m;
+		}
 	};
 
 	template<typename Key,typename Value,typename CreateValueThunk>
 	Value findExistingOrCreateNew(std::map<Key,Value>& map,Key&& key,CreateValueThunk createValueThunk)
 	{
+		std::lock_guard<std::mutex> lock(FunctionTypeMap::mutex());
 		auto mapIt = map.find(key);
 		if(mapIt != map.end()) { return mapIt->second; }
 		else
@@ -61,6 +61,17 @@ namespace LLVMJIT
 			likelyTrueBranchWeights = llvm::MDTuple::getDistinct(context,{llvm::MDString::get(context,"branch_weights"),i32MaxAsMetadata,zeroAsMetadata});
 
 		}
+
+		// Emits a reference to an object of the module instance. The reference is an external symbol that is bound when
+		// the object code is loaded (see resolveInstanceSymbol), so the object code can be loaded again for another instance.
+		llvm::Constant* emitInstanceSymbol(const std::string& name,llvm::Type* type)
+		{
+			auto symbol = llvmModule->getOrInsertGlobal(name,llvmInstanceSymbolType);
+			return type->isPointerTy()
+				? llvm::ConstantExpr::getPointerCast(symbol,type)
+				: llvm::ConstantExpr::getPtrToInt(symbol,type);
+		}
+
 		llvm::Module* emit();
 	};
 
@@ -74,6 +85,7 @@ namespace LLVMJIT
 		const FunctionDef& functionDef;
 		const FunctionType* functionType;
 		FunctionInstance* functionInstance;
+		Uptr functionDefIndex;
 		llvm::Function* llvmFunction;
 		llvm::IRBuilder<> irBuilder;
 
@@ -115,12 +127,13 @@ namespace LLVMJIT
 		std::vector<BranchTarget> branchTargetStack;
 		std::vector<llvm::Value*> stack;
 
-		EmitFunctionContext(EmitModuleContext& inEmitModuleContext,const Module& inModule,const FunctionDef& inFunctionDef,FunctionInstance* inFunctionInstance,llvm::Function* inLLVMFunction)
+		EmitFunctionContext(EmitModuleContext& inEmitModuleContext,const Module& inModule,const FunctionDef& inFunctionDef,FunctionInstance* inFunctionInstance,Uptr inFunctionDefIndex,llvm::Function* inLLVMFunction)
 		: moduleContext(inEmitModuleContext)
 		, module(inModule)
 		, functionDef(inFunctionDef)
 		, functionType(inModule.types[inFunctionDef.type.index])
 		, functionInstance(inFunctionInstance)
+		, functionDefIndex(inFunctionDefIndex)
 		, llvmFunction(inLLVMFunction)
 		, irBuilder(context)
 		{}
@@ -306,7 +319,9 @@ namespace LLVMJIT
 			WAVM_ASSERT_THROW(intrinsicObject);
 			FunctionInstance* intrinsicFunction = asFunction(intrinsicObject);
 			WAVM_ASSERT_THROW(intrinsicFunction->type == intrinsicType);
-			auto intrinsicFunctionPointer = emitLiteralPointer(intrinsicFunction->nativeFunction,asLLVMType(intrinsicType)->getPointerTo());
+			auto intrinsicFunctionPointer = moduleContext.emitInstanceSymbol(
+				"wavmIntrinsic:" + Intrinsics::getDecoratedName(intrinsicName,intrinsicType),
+				asLLVMType(intrinsicType)->getPointerTo());
 			return irBuilder.CreateCall(intrinsicFunctionPointer,llvm::ArrayRef<llvm::Value*>(args.begin(),args.end()));
 		}
 
@@ -687,7 +702,7 @@ namespace LLVMJIT
 			// Load the type for this table entry.
 			auto functionTypePointerPointer = irBuilder.CreateInBoundsGEP(moduleContext.defaultTablePointer,{functionIndexZExt,emitLiteral((U32)0)});
 			auto functionTypePointer = irBuilder.CreateLoad(functionTypePointerPointer);
-			auto llvmCalleeType = emitLiteralPointer(calleeType,llvmI8PtrType);
+			auto llvmCalleeType = moduleContext.emitInstanceSymbol("wavmType" + std::to_string(imm.type.index),llvmI8PtrType);
 			
 			// If the function type doesn't match, trap.
 			emitConditionalTrapIntrinsic(
@@ -696,7 +711,7 @@ namespace LLVMJIT
 				FunctionType::get(ResultType::none,{ValueType::i32,ValueType::i64,ValueType::i64}),
 				{	tableElementIndex,
 					irBuilder.CreatePtrToInt(llvmCalleeType,llvmI64Type),
-					emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultTable))	}
+					moduleContext.emitInstanceSymbol("wavmInstance.defaultTable",llvmI64Type)	}
 				);
 
 			// Call the function loaded from the table.
@@ -733,7 +748,9 @@ namespace LLVMJIT
 		void get_global(GetOrSetVariableImm<true> imm)
 		{
 			WAVM_ASSERT_THROW(imm.variableIndex < moduleContext.globalPointers.size());
-			push(irBuilder.CreateLoad(moduleContext.globalPointers[imm.variableIndex]));
+			// A load of a global written from outside the module must not be hoisted out of a loop or merged.
+			const bool isVolatile = imm.variableIndex == moduleContext.module.volatileGlobalIndex;
+			push(irBuilder.CreateLoad(moduleContext.globalPointers[imm.variableIndex],isVolatile));
 		}
 		void set_global(GetOrSetVariableImm<true> imm)
 		{
@@ -750,7 +767,7 @@ namespace LLVMJIT
 		void grow_memory(MemoryImm)
 		{
 			auto deltaNumPages = pop();
-			auto defaultMemoryObjectAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultMemory));
+			auto defaultMemoryObjectAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultMemory",llvmI64Type);
 			auto previousNumPages = emitRuntimeIntrinsic(
 				"wavmIntrinsics.growMemory",
 				FunctionType::get(ResultType::i32,{ValueType::i32,ValueType::i64}),
@@ -759,7 +776,7 @@ namespace LLVMJIT
 		}
 		void current_memory(MemoryImm)
 		{
-			auto defaultMemoryObjectAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultMemory));
+			auto defaultMemoryObjectAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultMemory",llvmI64Type);
 			auto currentNumPages = emitRuntimeIntrinsic(
 				"wavmIntrinsics.currentMemory",
 				FunctionType::get(ResultType::i32,{ValueType::i64}),
@@ -1234,7 +1251,7 @@ namespace LLVMJIT
 		{
 			auto numWaiters = pop();
 			auto address = pop();
-			auto defaultMemoryObjectAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultMemory));
+			auto defaultMemoryObjectAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultMemory",llvmI64Type);
 			push(emitRuntimeIntrinsic(
 				"wavmIntrinsics.wake",
 				FunctionType::get(ResultType::i32,{ValueType::i32,ValueType::i32,ValueType::i64}),
@@ -1245,7 +1262,7 @@ namespace LLVMJIT
 			auto timeout = pop();
 			auto expectedValue = pop();
 			auto address = pop();
-			auto defaultMemoryObjectAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultMemory));
+			auto defaultMemoryObjectAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultMemory",llvmI64Type);
 			push(emitRuntimeIntrinsic(
 				"wavmIntrinsics.wait",
 				FunctionType::get(ResultType::i32,{ValueType::i32,ValueType::i32,ValueType::f64,ValueType::i64}),
@@ -1256,7 +1273,7 @@ namespace LLVMJIT
 			auto timeout = pop();
 			auto expectedValue = pop();
 			auto address = pop();
-			auto defaultMemoryObjectAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultMemory));
+			auto defaultMemoryObjectAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultMemory",llvmI64Type);
 			push(emitRuntimeIntrinsic(
 				"wavmIntrinsics.wait",
 				FunctionType::get(ResultType::i32,{ValueType::i32,ValueType::i64,ValueType::f64,ValueType::i64}),
@@ -1269,7 +1286,7 @@ namespace LLVMJIT
 			auto errorFunctionIndex = pop();
 			auto argument = pop();
 			auto functionIndex = pop();
-			auto defaultTableAsI64 = emitLiteral(reinterpret_cast<U64>(moduleContext.moduleInstance->defaultTable));
+			auto defaultTableAsI64 = moduleContext.emitInstanceSymbol("wavmInstance.defaultTable",llvmI64Type);
 			emitRuntimeIntrinsic(
 				"wavmIntrinsics.launchThread",
 				FunctionType::get(ResultType::none,{ValueType::i32,ValueType::i32,ValueType::i32,ValueType::i64}),
@@ -1513,7 +1530,7 @@ namespace LLVMJIT
 			emitRuntimeIntrinsic(
 				"wavmIntrinsics.debugEnterFunction",
 				FunctionType::get(ResultType::none,{ValueType::i64}),
-				{emitLiteral(reinterpret_cast<U64>(functionInstance))}
+				{moduleContext.emitInstanceSymbol("wavmInstance.functionDef" + std::to_string(functionDefIndex),llvmI64Type)}
 				);
 		}
 
@@ -1564,7 +1581,7 @@ namespace LLVMJIT
 			emitRuntimeIntrinsic(
 				"wavmIntrinsics.debugExitFunction",
 				FunctionType::get(ResultType::none,{ValueType::i64}),
-				{emitLiteral(reinterpret_cast<U64>(functionInstance))}
+				{moduleContext.emitInstanceSymbol("wavmInstance.functionDef" + std::to_string(functionDefIndex),llvmI64Type)}
 				);
 		}
 
@@ -1580,7 +1597,9 @@ namespace LLVMJIT
 		// Create literals for the default memory base and mask.
 		if(moduleInstance->defaultMemory)
 		{
-			defaultMemoryBase = emitLiteralPointer(moduleInstance->defaultMemory->baseAddress,llvmI8PtrType);
+			defaultMemoryBase = emitInstanceSymbol("wavmInstance.defaultMemoryBase",llvmI8PtrType);
+
+			// The end offset is the size of the address space reserved for every memory, not a property of the instance.
 			const Uptr defaultMemoryEndOffsetValue = Uptr(moduleInstance->defaultMemory->endOffset);
 			defaultMemoryEndOffset = emitLiteral(defaultMemoryEndOffsetValue);
 		}
@@ -1593,7 +1612,8 @@ namespace LLVMJIT
 				llvmI8PtrType,
 				llvmI8PtrType
 				});
-			defaultTablePointer = emitLiteralPointer(moduleInstance->defaultTable->baseAddress,tableElementType->getPointerTo());
+			defaultTablePointer = emitInstanceSymbol("wavmInstance.defaultTableBase",tableElementType->getPointerTo());
+			// Like the memory end offset, the same for every table.
 			defaultTableMaxElementIndex = emitLiteral(((Uptr)moduleInstance->defaultTable->endOffset)/sizeof(TableInstance::FunctionElement));
 		}
 		else
@@ -1605,12 +1625,19 @@ namespace LLVMJIT
 		for(Uptr functionIndex = 0;functionIndex < module.functions.imports.size();++functionIndex)
 		{
 			const FunctionInstance* functionInstance = moduleInstance->functions[functionIndex];
-			importedFunctionPointers.push_back(emitLiteralPointer(functionInstance->nativeFunction,asLLVMType(functionInstance->type)->getPointerTo()));
+			importedFunctionPointers.push_back(emitInstanceSymbol(
+				"wavmInstance.importedFunction" + std::to_string(functionIndex),
+				asLLVMType(functionInstance->type)->getPointerTo()));
 		}
 
 		// Create LLVM pointer constants for the module's globals.
-		for(auto global : moduleInstance->globals)
-		{ globalPointers.push_back(emitLiteralPointer(&global->value,asLLVMType(global->type.valueType)->getPointerTo())); }
+		for(Uptr globalIndex = 0;globalIndex < moduleInstance->globals.size();++globalIndex)
+		{
+			const GlobalInstance* global = moduleInstance->globals[globalIndex];
+			globalPointers.push_back(emitInstanceSymbol(
+				"wavmInstance.global" + std::to_string(globalIndex),
+				asLLVMType(global->type.valueType)->getPointerTo()));
+		}
 		
 		// Create the LLVM functions.
 		functionDefs.resize(module.functions.defs.size());
@@ -1623,7 +1650,7 @@ namespace LLVMJIT
 
 		// Compile each function in the module.
 		for(Uptr functionDefIndex = 0;functionDefIndex < module.functions.defs.size();++functionDefIndex)
-		{ EmitFunctionContext(*this,module,module.functions.defs[functionDefIndex],moduleInstance->functionDefs[functionDefIndex],functionDefs[functionDefIndex]).emit(); }
+		{ EmitFunctionContext(*this,module,module.functions.defs[functionDefIndex],moduleInstance->functionDefs[functionDefIndex],functionDefIndex,functionDefs[functionDefIndex]).emit(); }
 		
 		// Finalize the debug info.
 		diBuilder.finalize();
@@ -40,6 +40,7 @@ namespace LLVMJIT
 	llvm::Type* llvmVoidType;
 	llvm::Type* llvmBoolType;
 	llvm::Type* llvmI8PtrType;
+	llvm::Type* llvmInstanceSymbolType;
 	
 	#if ENABLE_SIMD_PROTOTYPE
 	llvm::Type* llvmI8x16Type;
@@ -215,12 +216,38 @@ namespace LLVMJIT
 		void operator=(const UnitMemoryManager&) = delete;
 	};
 
+	// Used to override LLVM's default behavior of looking up unresolved symbols in DLL exports.
+	struct NullResolver : llvm::JITSymbolResolver
+	{
+		static NullResolver singleton;
+		virtual llvm::JITSymbol findSymbol(const std::string& name) override;
+		virtual llvm::JITSymbol findSymbolInLogicalDylib(const std::string& name) override;
+	};
+
+	// Whether a symbol is one of the few runtime functions LLVM generated code may call.
+	bool isRuntimeSymbol(const std::string& name);
+
+	// Copies the object file the compile layer generates for a module, so it can be loaded again later.
+	struct ObjectCodeCapture : llvm::ObjectCache
+	{
+		std::vector<U8>& objectCode;
+
+		ObjectCodeCapture(std::vector<U8>& inObjectCode): objectCode(inObjectCode) {}
+
+		void notifyObjectCompiled(const llvm::Module* llvmModule,llvm::MemoryBufferRef object) override
+		{
+			objectCode.assign(reinterpret_cast<const U8*>(object.getBufferStart()),reinterpret_cast<const U8*>(object.getBufferEnd()));
+		}
+		std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* llvmModule) override { return nullptr; }
+	};
+
 	// A unit of JIT compilation.
 	// Encapsulates the LLVM JIT compilation pipeline but allows subclasses to define how the resulting code is used.
 	struct JITUnit
 	{
-		JITUnit(bool inShouldLogMetrics = true)
-		: shouldLogMetrics(inShouldLogMetrics)
+		JITUnit(llvm::JITSymbolResolver* inResolver,bool inShouldLogMetrics = true)
+		: resolver(inResolver)
+		, shouldLogMetrics(inShouldLogMetrics)
 		#ifdef _WIN32
 			, pdataCopy(nullptr)
 		#endif
@@ -238,10 +265,17 @@ namespace LLVMJIT
 			#endif
 		}
 
-		void compile(llvm::Module* llvmModule);
+		// Compiles the module, and if outObjectCode is given copies the generated object file to it.
+		void compile(llvm::Module* llvmModule,std::vector<U8>* outObjectCode = nullptr);
+
+		// Loads object code generated by an earlier compile, returns false without loading anything if it is unusable.
+		bool load(const std::vector<U8>& objectCode);
 
 		virtual void notifySymbolLoaded(const char* name,Uptr baseAddress,Uptr numBytes,std::map<U32,U32>&& offsetToOpIndexMap) = 0;
 
+		// Checks that previously generated object code can be loaded by this unit.
+		virtual bool canLoad(const llvm::object::ObjectFile& object) const { return false; }
+
 	private:
 		
 		// Functor that receives notifications when an object produced by the JIT is loaded.
@@ -267,6 +301,7 @@ namespace LLVMJIT
 		typedef llvm::orc::IRCompileLayer<ObjectLayer> CompileLayer;
 
 		UnitMemoryManager memoryManager;
+		llvm::JITSymbolResolver* resolver;
 		std::unique_ptr<ObjectLayer> objectLayer;
 		std::unique_ptr<CompileLayer> compileLayer;
 		CompileLayer::ModuleSetHandleT handle;
@@ -286,14 +321,38 @@ namespace LLVMJIT
 		#endif
 	};
 
+	// Binds the symbols generated code refers to its module instance through, see EmitModuleContext::emitInstanceSymbol.
+	// Only used while the unit is compiled or loaded.
+	struct InstanceResolver : llvm::JITSymbolResolver
+	{
+		const IR::Module& module;
+		ModuleInstance* moduleInstance;
+
+		InstanceResolver(const IR::Module& inModule,ModuleInstance* inModuleInstance)
+		: module(inModule), moduleInstance(inModuleInstance) {}
+
+		virtual llvm::JITSymbol findSymbol(const std::string& name) override
+		{
+			Uptr value;
+			if(resolveInstanceSymbol(module,moduleInstance,name,value)) { return llvm::JITSymbol(value,llvm::JITSymbolFlags::None); }
+			return NullResolver::singleton.findSymbol(name);
+		}
+		virtual llvm::JITSymbol findSymbolInLogicalDylib(const std::string& name) override { return llvm::JITSymbol(nullptr); }
+	};
+
 	// The JIT compilation unit for a WebAssembly module instance.
 	struct JITModule : JITUnit, JITModuleBase
 	{
 		ModuleInstance* moduleInstance;
+		InstanceResolver instanceResolver;
 
 		std::vector<JITSymbol*> functionDefSymbols;
 
-		JITModule(ModuleInstance* inModuleInstance): moduleInstance(inModuleInstance) {}
+		JITModule(const IR::Module& inModule,ModuleInstance* inModuleInstance)
+		: JITUnit(&instanceResolver)
+		, moduleInstance(inModuleInstance)
+		, instanceResolver(inModule,inModuleInstance)
+		{}
 		~JITModule() override
 		{
 			// Delete the module's symbols, and remove them from the global address-to-symbol map.
@@ -324,6 +383,33 @@ namespace LLVMJIT
 				}
 			}
 		}
+
+		bool canLoad(const llvm::object::ObjectFile& object) const override
+		{
+			// Every symbol the code refers to must be bound, and every function of the module must be defined.
+			std::vector<bool> isFunctionDefined(moduleInstance->functionDefs.size(),false);
+			for(auto symbol : object.symbols())
+			{
+				auto name = symbol.getName();
+				if(!name) { llvm::consumeError(name.takeError()); return false; }
+				if(symbol.getFlags() & llvm::object::SymbolRef::SF_Undefined)
+				{
+					Uptr value;
+					if(!resolveInstanceSymbol(instanceResolver.module,moduleInstance,name->str(),value)
+					&& !isRuntimeSymbol(name->str())) { return false; }
+				}
+				else
+				{
+					Uptr functionDefIndex;
+					if(getFunctionIndexFromExternalName(name->str().c_str(),functionDefIndex))
+					{
+						if(functionDefIndex >= isFunctionDefined.size()) { return false; }
+						isFunctionDefined[functionDefIndex] = true;
+					}
+				}
+			}
+			return std::find(isFunctionDefined.begin(),isFunctionDefined.end(),false) == isFunctionDefined.end();
+		}
 	};
 
 	// The JIT compilation unit for a single invoke thunk.
@@ -333,7 +419,7 @@ namespace LLVMJIT
 
 		JITSymbol* symbol;
 
-		JITInvokeThunkUnit(const FunctionType* inFunctionType): JITUnit(false), functionType(inFunctionType), symbol(nullptr) {}
+		JITInvokeThunkUnit(const FunctionType* inFunctionType): JITUnit(&NullResolver::singleton,false), functionType(inFunctionType), symbol(nullptr) {}
 
 		void notifySymbolLoaded(const char* name,Uptr baseAddress,Uptr numBytes,std::map<U32,U32>&& offsetToOpIndexMap) override
 		{
@@ -346,14 +432,6 @@ namespace LLVMJIT
 		}
 	};
 	
-	// Used to override LLVM's default behavior of looking up unresolved symbols in DLL exports.
-	struct NullResolver : llvm::JITSymbolResolver
-	{
-		static NullResolver singleton;
-		virtual llvm::JITSymbol findSymbol(const std::string& name) override;
-		virtual llvm::JITSymbol findSymbolInLogicalDylib(const std::string& name) override;
-	};
-	
 	static std::map<std::string,const char*> runtimeSymbolMap =
 	{
 		#ifdef _WIN32
@@ -377,6 +455,8 @@ namespace LLVMJIT
 		#endif
 	};
 
+	bool isRuntimeSymbol(const std::string& name) { return runtimeSymbolMap.count(name) != 0; }
+
 	NullResolver NullResolver::singleton;
 	llvm::JITSymbol NullResolver::findSymbol(const std::string& name)
 	{
@@ -555,7 +635,7 @@ namespace LLVMJIT
 		Log::printf(Log::Category::debug,"Dumped LLVM module to: %s\n",augmentedFilename.c_str());
 	}
 
-	void JITUnit::compile(llvm::Module* llvmModule)
+	void JITUnit::compile(llvm::Module* llvmModule,std::vector<U8>* outObjectCode)
 	{
 		// Get a target machine object for this host, and set the module to use its data layout.
 		llvmModule->setDataLayout(targetMachine->createDataLayout());
@@ -593,13 +673,20 @@ namespace LLVMJIT
 
 		if(DUMP_OPTIMIZED_MODULE) { printModule(llvmModule,"llvmOptimizedDump"); }
 
-		// Pass the module to the JIT compiler.
+		// Pass the module to the JIT compiler, which hands the object file it generates to the capture if there is one.
 		Timing::Timer machineCodeTimer;
+		std::unique_ptr<ObjectCodeCapture> objectCodeCapture;
+		if(outObjectCode)
+		{
+			objectCodeCapture = llvm::make_unique<ObjectCodeCapture>(*outObjectCode);
+			compileLayer->setObjectCache(objectCodeCapture.get());
+		}
 		handle = compileLayer->addModuleSet(
 			std::vector<llvm::Module*>{llvmModule},
 			&memoryManager,
-			&NullResolver::singleton);
+			resolver);
 		handleIsValid = true;
+		compileLayer->setObjectCache(nullptr);
 		compileLayer->emitAndFinalize(handle);
 
 		if(shouldLogMetrics)
@@ -610,17 +697,102 @@ namespace LLVMJIT
 		delete llvmModule;
 	}
 
-	void instantiateModule(const IR::Module& module,ModuleInstance* moduleInstance)
+	bool JITUnit::load(const std::vector<U8>& objectCode)
 	{
-		// Emit LLVM IR for the module.
-		auto llvmModule = emitModule(module,moduleInstance);
+		Timing::Timer loadTimer;
 
+		auto buffer = llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(reinterpret_cast<const char*>(objectCode.data()),objectCode.size()));
+		auto object = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+		if(!object) { llvm::consumeError(object.takeError()); return false; }
+		if(!canLoad(**object)) { return false; }
+
+		std::vector<std::unique_ptr<llvm::object::OwningBinary<llvm::object::ObjectFile>>> objectSet;
+		objectSet.push_back(llvm::make_unique<llvm::object::OwningBinary<llvm::object::ObjectFile>>(std::move(*object),std::move(buffer)));
+		handle = objectLayer->addObjectSet(std::move(objectSet),&memoryManager,resolver);
+		handleIsValid = true;
+		objectLayer->emitAndFinalize(handle);
+
+		if(shouldLogMetrics)
+		{
+			Timing::logTimer("Loaded object code",loadTimer);
+		}
+		return true;
+	}
+
+	bool resolveInstanceSymbol(const IR::Module& module,ModuleInstance* moduleInstance,const std::string& decoratedName,Uptr& outValue)
+	{
+		#if defined(_WIN32) && !defined(_WIN64)
+			if(!decoratedName.size() || decoratedName[0] != '_') { return false; }
+			const std::string name = decoratedName.substr(1);
+		#else
+			const std::string& name = decoratedName;
+		#endif
+
+		// Parses the index that follows prefix in the name.
+		auto getIndex = [&name](const char* prefix,Uptr& outIndex) -> bool
+		{
+			const Uptr numPrefixChars = strlen(prefix);
+			if(name.compare(0,numPrefixChars,prefix) || name.size() == numPrefixChars) { return false; }
+			char* numberEnd = nullptr;
+			U64 index64 = std::strtoull(name.c_str() + numPrefixChars,&numberEnd,10);
+			if(*numberEnd || index64 > UINTPTR_MAX) { return false; }
+			outIndex = Uptr(index64);
+			return true;
+		};
+
+		const char intrinsicPrefix[] = "wavmIntrinsic:";
+		Uptr index;
+		if(name == "wavmInstance.defaultMemory" && moduleInstance->defaultMemory)
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->defaultMemory); }
+		else if(name == "wavmInstance.defaultMemoryBase" && moduleInstance->defaultMemory)
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->defaultMemory->baseAddress); }
+		else if(name == "wavmInstance.defaultTable" && moduleInstance->defaultTable)
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->defaultTable); }
+		else if(name == "wavmInstance.defaultTableBase" && moduleInstance->defaultTable)
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->defaultTable->baseAddress); }
+		else if(getIndex("wavmInstance.importedFunction",index) && index < module.functions.imports.size())
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->functions[index]->nativeFunction); }
+		else if(getIndex("wavmInstance.functionDef",index) && index < moduleInstance->functionDefs.size())
+		{ outValue = reinterpret_cast<Uptr>(moduleInstance->functionDefs[index]); }
+		else if(getIndex("wavmInstance.global",index) && index < moduleInstance->globals.size())
+		{
+			outValue = index == module.volatileGlobalIndex && module.volatileGlobalAddress
+				? reinterpret_cast<Uptr>(module.volatileGlobalAddress)
+				: reinterpret_cast<Uptr>(&moduleInstance->globals[index]->value);
+		}
+		else if(getIndex("wavmType",index) && index < module.types.size())
+		{ outValue = reinterpret_cast<Uptr>(module.types[index]); }
+		else if(!name.compare(0,sizeof(intrinsicPrefix) - 1,intrinsicPrefix))
+		{
+			FunctionInstance* intrinsicFunction = Intrinsics::findFunction(name.substr(sizeof(intrinsicPrefix) - 1));
+			if(!intrinsicFunction) { return false; }
+			outValue = reinterpret_cast<Uptr>(intrinsicFunction->nativeFunction);
+		}
+		else { return false; }
+
+		// LLVM takes a null address for a symbol it can't find.
+		return outValue != 0;
+	}
+
+	std::string getObjectCodeVersion()
+	{
+		// The target machine is created for the process triple and a generic CPU, so the triple covers the target.
+		// Bump the leading number whenever the code emitted for a module changes.
+		return std::string("wavm-object-1 llvm-" LLVM_VERSION_STRING " ") + llvm::sys::getProcessTriple();
+	}
+
+	void instantiateModule(const IR::Module& module,ModuleInstance* moduleInstance,const std::vector<U8>& objectCode)
+	{
 		// Construct the JIT compilation pipeline for this module.
-		auto jitModule = new JITModule(moduleInstance);
+		auto jitModule = new JITModule(module,moduleInstance);
 		moduleInstance->jitModule = jitModule;
 
-		// Compile the module.
-		jitModule->compile(llvmModule);
+		// Load the code generated for an earlier instance of the module if it fits this one.
+		if(objectCode.size() && jitModule->load(objectCode)) { return; }
+
+		// Emit LLVM IR for the module, and compile it.
+		auto llvmModule = emitModule(module,moduleInstance);
+		jitModule->compile(llvmModule,&jitModule->objectCode);
 	}
 
 	std::string getExternalFunctionName(ModuleInstance* moduleInstance,Uptr functionDefIndex)
@@ -780,6 +952,7 @@ namespace LLVMJIT
 		llvmVoidType = llvm::Type::getVoidTy(context);
 		llvmBoolType = llvm::Type::getInt1Ty(context);
 		llvmI8PtrType = llvmI8Type->getPointerTo();
+		llvmInstanceSymbolType = llvm::StructType::create(context,"InstanceSymbol");
 		
 		#if ENABLE_SIMD_PROTOTYPE
 		llvmI8x16Type = llvm::VectorType::get(llvmI8Type,16);
@@ -25,6 +25,7 @@
 
 #include "llvm/Analysis/Passes.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
@@ -42,6 +43,7 @@
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Object/SymbolSize.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/TargetSelect.h"
@@ -79,6 +81,10 @@ namespace LLVMJIT
 	extern llvm::Type* llvmBoolType;
 	extern llvm::Type* llvmI8PtrType;
 
+	// The type of the external symbols generated code refers to its module instance through. It is opaque so LLVM
+	// makes no assumptions about the size or alignment of what they point to.
+	extern llvm::Type* llvmInstanceSymbolType;
+
 	#if ENABLE_SIMD_PROTOTYPE
 	extern llvm::Type* llvmI8x16Type;
 	extern llvm::Type* llvmI16x8Type;
@@ -127,4 +133,7 @@ namespace LLVMJIT
 
 	// Emits LLVM IR for a module.
 	llvm::Module* emitModule(const IR::Module& module,ModuleInstance* moduleInstance);
+
+	// Binds a symbol emitted by EmitModuleContext::emitInstanceSymbol to the value it stands for in a module instance.
+	bool resolveInstanceSymbol(const IR::Module& module,ModuleInstance* moduleInstance,const std::string& name,Uptr& outValue);
 }
@@ -89,12 +89,14 @@ namespace Runtime
 	}
 
 	void resetMemory(MemoryInstance* memory, MemoryType& newMemoryType) {
-		memory->type.size.min = 1;
-		if(shrinkMemory(memory, memory->numPages - 1) == -1)
+		// Decommitting drops every page touched since the last reset and, on Linux, recommitting maps them back
+		// lazily as zero pages, so a reset costs in proportion to the pages the last call dirtied rather than to the
+		// memory's size. Elsewhere growMemory zeroes the recommitted pages itself.
+		memory->type.size.min = 0;
+		if(shrinkMemory(memory, memory->numPages) == -1)
 			causeException(Exception::Cause::outOfMemory);
-		memset(memory->baseAddress, 0, 1<<IR::numBytesPerPageLog2);
 		memory->type = newMemoryType;
-		if(growMemory(memory, memory->type.size.min - 1) == -1)
+		if(growMemory(memory, memory->type.size.min) == -1)
 			causeException(Exception::Cause::outOfMemory);
    }
 
@@ -114,7 +116,11 @@ namespace Runtime
 			{
 				return -1;
 			}
+			// Pages past the end of the memory are always decommitted. Linux guarantees that decommitted pages of a
+			// private anonymous mapping read back as zero once committed again, other platforms do not.
+			#ifndef __linux__
 			memset(memory->baseAddress + (memory->numPages << IR::numBytesPerPageLog2), 0, numNewPages << IR::numBytesPerPageLog2);
+			#endif
 			memory->numPages += numNewPages;
 		}
 		return previousNumPages;
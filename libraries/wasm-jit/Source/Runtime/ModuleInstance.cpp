@@ -30,7 +30,7 @@ namespace Runtime
 
 	MemoryInstance* MemoryInstance::theMemoryInstance = nullptr;
 
-	ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports)
+	ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports,const std::vector<U8>& objectCode)
 	{
 		ModuleInstance* moduleInstance = new ModuleInstance(
 			std::move(imports.functions),
@@ -129,8 +129,8 @@ namespace Runtime
 			moduleInstance->functions.push_back(functionInstance);
 		}
 
-		// Generate machine code for the module.
-		LLVMJIT::instantiateModule(module,moduleInstance);
+		// Generate machine code for the module, or load the code generated for an earlier instance.
+		LLVMJIT::instantiateModule(module,moduleInstance,objectCode);
 
 		// Set up the instance's exports.
 		for(const Export& exportIt : module.exports)
@@ -181,10 +181,24 @@ namespace Runtime
 		delete jitModule;
 	}
 
+	std::vector<U8> takeObjectCode(ModuleInstance* moduleInstance)
+	{
+		WAVM_ASSERT_THROW(moduleInstance->jitModule);
+		return std::move(moduleInstance->jitModule->objectCode);
+	}
+
+	std::string getObjectCodeVersion() { return LLVMJIT::getObjectCodeVersion(); }
+
 	MemoryInstance* getDefaultMemory(ModuleInstance* moduleInstance) { return moduleInstance->defaultMemory; }
 	uint64_t getDefaultMemorySize(ModuleInstance* moduleInstance) { return moduleInstance->defaultMemory->numPages << IR::numBytesPerPageLog2; }
 	TableInstance* getDefaultTable(ModuleInstance* moduleInstance) { return moduleInstance->defaultTable; }
 
+	GlobalInstance* getInstanceGlobal(ModuleInstance* moduleInstance,Uptr globalIndex)
+	{
+		WAVM_ASSERT_THROW(globalIndex < moduleInstance->globals.size());
+		return moduleInstance->globals[globalIndex];
+	}
+
 	void runInstanceStartFunc(ModuleInstance* moduleInstance) {
 		if(moduleInstance->startFunctionIndex != UINTPTR_MAX)
 			invokeFunction(moduleInstance->functions[moduleInstance->startFunctionIndex],{});
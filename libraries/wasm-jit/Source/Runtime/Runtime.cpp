@@ -154,4 +154,9 @@ namespace Runtime
 		global->value = newValue;
 		return previousValue;
 	}
+
+	U8* getGlobalValueAddress(GlobalInstance* global)
+	{
+		return reinterpret_cast<U8*>(&global->value);
+	}
 }
@@ -16,11 +16,15 @@ namespace LLVMJIT
 	
 	struct JITModuleBase
 	{
+		// The object code generated for the module, until it is taken by takeObjectCode.
+		std::vector<U8> objectCode;
+
 		virtual ~JITModuleBase() {}
 	};
 
 	void init();
-	void instantiateModule(const IR::Module& module,Runtime::ModuleInstance* moduleInstance);
+	void instantiateModule(const IR::Module& module,Runtime::ModuleInstance* moduleInstance,const std::vector<U8>& objectCode);
+	std::string getObjectCodeVersion();
 	bool describeInstructionPointer(Uptr ip,std::string& outDescription);
 	
 	typedef void (*InvokeFunctionPointer)(void*,U64*);
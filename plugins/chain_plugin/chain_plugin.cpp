@@ -11,9 +11,10 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/wasm_interface.hpp>
 #include <eosio/chain/resource_limits.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 
 #include <eosio/chain/eosio_contract.hpp>
@@ -208,20 +209,47 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
    cfg.add_options()
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
+         ("blocks-log-stride", bpo::value<uint32_t>(),
+          "split the block log into a retained file every this many blocks, named by the first and last block it holds (default never splits)")
+         ("max-retained-block-files", bpo::value<uint32_t>(),
+          "the oldest retained block log files beyond this many are archived to blocks-archive-dir, or removed if it is empty (default keeps all)")
+         ("blocks-archive-dir", bpo::value<bfs::path>()->default_value("archive"),
+          "the location retained block log files are archived to beyond max-retained-block-files (absolute path or relative to the blocks directory), an empty path removes them instead")
+         ("blocks-log-compression", bpo::bool_switch()->default_value(false),
+          "compress each block of retained block log files, which stay randomly readable")
+         ("block-log-write-queue-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of irreversible blocks queued for a block log writer thread, which writes and flushes them in batches, 0 writes them on the main thread")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
-         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"), "Override default WASM runtime")
+         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt/tiered"),
+          "Override default WASM runtime, tiered interprets contracts with wabt until their wavm compile finishes in the background")
+         ("wasm-tier-up-calls", bpo::value<uint32_t>()->default_value(wasm_interface::tiering_policy().compile_after_calls),
+          "Number of interpreted calls of a contract before its native compile is started (tiered runtime)")
+         ("wasm-tier-sync-compile-max-size-kb", bpo::value<uint64_t>()->default_value(wasm_interface::tiering_policy().sync_compile_max_size / 1024),
+          "Contracts up to this size (in KiB) are compiled natively before their first call rather than interpreted (tiered runtime)")
+         ("wasm-code-cache-dir", bpo::value<bfs::path>()->default_value(config::default_wasm_code_cache_dir_name),
+          "the location of a cache of prepared contract code and the object code generated for it, kept across restarts (absolute path or relative to application data dir), an empty path disables it")
+         ("wasm-code-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_code_cache_size / (1024  * 1024)),
+          "Maximum size (in MiB) of the contract code cache, least recently used entries are removed beyond it")
+         ("wasm-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_cache_size / (1024  * 1024)),
+          "Maximum size (in MiB) of instantiated contract code kept in memory, least recently used contracts are evicted beyond it")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
           "Override default maximum ABI serialization time allowed in ms")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
          ("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")
-         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks database")
-         ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
+         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks log")
+         ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reversible blocks log drops below this size (in MiB).")
          ("signature-cpu-billable-pct", bpo::value<uint32_t>()->default_value(config::default_sig_cpu_bill_pct / config::percent_1),
           "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")
+         ("signature-recovery-cache-size", bpo::value<uint32_t>()->default_value(config::default_sig_recovery_cache_size),
+          "Number of recovered transaction signature keys to cache, 0 to disable")
          ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in controller thread pool")
+         ("replay-read-ahead-blocks", bpo::value<uint16_t>()->default_value(config::default_replay_read_ahead_blocks),
+          "Number of blocks read and decoded ahead of the one being applied during replay, 0 to disable")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
+         ("native-contract-mode", bpo::value<eosio::chain::native_contract_registry::mode>()->value_name("disabled/enabled/differential"),
+          "Whether registered native implementations run in place of the contract code they match, differential runs both and logs any difference (default disabled)")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
           "Account added to actor whitelist (may specify multiple times)")
          ("actor-blacklist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -379,6 +407,15 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
             my->blocks_dir = bld;
       }
 
+      if( options.count( "wasm-code-cache-dir" )) {
+         auto ccd = options.at( "wasm-code-cache-dir" ).as<bfs::path>();
+         if( !ccd.empty() && ccd.is_relative())
+            my->chain_config->wasm_code_cache_dir = app().data_dir() / ccd;
+         else
+            my->chain_config->wasm_code_cache_dir = ccd;
+      }
+      my->chain_config->wasm_code_cache_size = options.at( "wasm-code-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+
       if( options.count("checkpoint") ) {
          auto cps = options.at("checkpoint").as<vector<string>>();
          my->loaded_checkpoints.reserve(cps.size());
@@ -404,6 +441,17 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->abi_serializer_max_time_ms = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
       my->chain_config->blocks_dir = my->blocks_dir;
+
+      if( options.count( "blocks-log-stride" )) {
+         my->chain_config->blocks_log.stride = options.at( "blocks-log-stride" ).as<uint32_t>();
+         EOS_ASSERT( my->chain_config->blocks_log.stride > 0, plugin_config_exception, "blocks-log-stride must be greater than 0" );
+      }
+      if( options.count( "max-retained-block-files" ))
+         my->chain_config->blocks_log.max_retained_files = options.at( "max-retained-block-files" ).as<uint32_t>();
+      if( options.count( "blocks-archive-dir" ))
+         my->chain_config->blocks_log.archive_dir = options.at( "blocks-archive-dir" ).as<bfs::path>();
+      my->chain_config->blocks_log.compress_retained_files = options.at( "blocks-log-compression" ).as<bool>();
+      my->chain_config->blocks_log.write_queue_size = options.at( "block-log-write-queue-size" ).as<uint32_t>();
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
 
@@ -426,14 +474,31 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
                      "chain-threads ${num} must be greater than 0", ("num", my->chain_config->thread_pool_size) );
       }
 
+      if( options.count( "replay-read-ahead-blocks" ))
+         my->chain_config->replay_read_ahead_blocks = options.at( "replay-read-ahead-blocks" ).as<uint16_t>();
+
       my->chain_config->sig_cpu_bill_pct = options.at("signature-cpu-billable-pct").as<uint32_t>();
       EOS_ASSERT( my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                   "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct) );
       my->chain_config->sig_cpu_bill_pct *= config::percent_1;
 
+      my->chain_config->sig_recovery_cache_size = options.at("signature-recovery-cache-size").as<uint32_t>();
+
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
 
+      if( options.count( "wasm-cache-size-mb" ))
+         my->chain_config->wasm_cache_size = options.at( "wasm-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+
+      if( options.count( "wasm-tier-up-calls" ))
+         my->chain_config->wasm_tiering.compile_after_calls = options.at( "wasm-tier-up-calls" ).as<uint32_t>();
+
+      if( options.count( "wasm-tier-sync-compile-max-size-kb" ))
+         my->chain_config->wasm_tiering.sync_compile_max_size = options.at( "wasm-tier-sync-compile-max-size-kb" ).as<uint64_t>() * 1024;
+
+      if( options.count( "native-contract-mode" ))
+         my->chain_config->native_contract_mode = options.at( "native-contract-mode" ).as<native_contract_registry::mode>();
+
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
@@ -496,16 +561,16 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
              options.at( "fix-reversible-blocks" ).as<bool>()) {
             // Do not try to recover reversible blocks if the directory does not exist, unless the option was explicitly provided.
             if( !recover_reversible_blocks( backup_dir / config::reversible_blocks_dir_name,
-                                            my->chain_config->reversible_cache_size,
                                             my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
                                             options.at( "truncate-at-block" ).as<uint32_t>())) {
                ilog( "Reversible blocks database was not corrupted. Copying from backup to blocks directory." );
                fc::copy( backup_dir / config::reversible_blocks_dir_name,
                          my->chain_config->blocks_dir / config::reversible_blocks_dir_name );
-               fc::copy( backup_dir / config::reversible_blocks_dir_name / "shared_memory.bin",
-                         my->chain_config->blocks_dir / config::reversible_blocks_dir_name / "shared_memory.bin" );
-               fc::copy( backup_dir / config::reversible_blocks_dir_name / "shared_memory.meta",
-                         my->chain_config->blocks_dir / config::reversible_blocks_dir_name / "shared_memory.meta" );
+               // the reversible block log, or the database of earlier versions it is made from on startup
+               using boost::filesystem::directory_iterator;
+               for( directory_iterator enditr, itr{backup_dir / config::reversible_blocks_dir_name}; itr != enditr; ++itr ) {
+                  fc::copy( itr->path(), my->chain_config->blocks_dir / config::reversible_blocks_dir_name / itr->path().filename() );
+               }
             }
          }
       } else if( options.at( "replay-blockchain" ).as<bool>()) {
@@ -514,14 +579,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
             wlog( "The --truncate-at-block option does not work for a regular replay of the blockchain." );
          clear_directory_contents( my->chain_config->state_dir );
          if( options.at( "fix-reversible-blocks" ).as<bool>()) {
-            if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
-                                            my->chain_config->reversible_cache_size )) {
+            if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name )) {
                ilog( "Reversible blocks database was not corrupted." );
             }
          }
       } else if( options.at( "fix-reversible-blocks" ).as<bool>()) {
          if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
-                                         my->chain_config->reversible_cache_size,
                                          optional<fc::path>(),
                                          options.at( "truncate-at-block" ).as<uint32_t>())) {
             ilog( "Reversible blocks database verified to not be corrupted. Now exiting..." );
@@ -536,8 +599,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          ilog("Importing reversible blocks from '${file}'", ("file", reversible_blocks_file.generic_string()) );
          fc::remove_all( my->chain_config->blocks_dir/config::reversible_blocks_dir_name );
 
-         import_reversible_blocks( my->chain_config->blocks_dir/config::reversible_blocks_dir_name,
-                                   my->chain_config->reversible_cache_size, reversible_blocks_file );
+         import_reversible_blocks( my->chain_config->blocks_dir/config::reversible_blocks_dir_name, reversible_blocks_file );
 
          EOS_THROW( node_management_success, "imported reversible blocks" );
       }
@@ -553,7 +615,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
          // recover genesis information from the snapshot
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
+         auto reader = make_istream_snapshot_reader(infile);
          reader->validate();
          reader->read_section<genesis_state>([this]( auto &section ){
             section.read_row(my->chain_config->genesis);
@@ -707,7 +769,8 @@ void chain_plugin::plugin_startup()
       auto shutdown = [](){ return app().is_quiting(); };
       if (my->snapshot_path) {
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
+         // the rows are created on this thread, the chunks of the snapshot are read ahead and decompressed on others
+         auto reader = make_istream_snapshot_reader(infile, my->chain_config->thread_pool_size);
          my->chain->startup(shutdown, reader);
          infile.close();
       } else {
@@ -769,26 +832,21 @@ bool chain_plugin::block_is_on_preferred_chain(const block_id_type& block_id) {
    return b && b->id() == block_id;
 }
 
-bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t cache_size,
+bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir,
                                               optional<fc::path> new_db_dir, uint32_t truncate_at_block ) {
    try {
-      chainbase::database reversible( db_dir, database::read_only); // Test if dirty
-      // If it reaches here, then the reversible database is not dirty
-
-      if( truncate_at_block == 0 )
-         return false;
-
-      reversible.add_index<reversible_block_index>();
-      const auto& ubi = reversible.get_index<reversible_block_index,by_num>();
-
-      auto itr = ubi.rbegin();
-      if( itr != ubi.rend() && itr->blocknum <= truncate_at_block )
-         return false; // Because we are not going to be truncating the reversible database at all.
-   } catch( const std::runtime_error& ) {
+      reversible_block_log reversible( db_dir, true );
+      for( uint32_t n = reversible.first_block_num(); !reversible.empty() && n <= reversible.last_block_num(); ++n )
+         reversible.read_block_by_num( n ); // Verifies the checksum of every block.
+      // If it reaches here, then the only damage the reversible block log can have is an incomplete last record
+
+      if( !reversible.repaired() && (truncate_at_block == 0 || reversible.last_block_num() <= truncate_at_block) )
+         return false; // Because we are not going to be truncating the reversible block log at all.
+   } catch( const fc::exception& ) {
    } catch( ... ) {
       throw;
    }
-   // Reversible block database is dirty. So back it up (unless already moved) and then create a new one.
+   // Reversible block log is damaged. So back it up (unless already moved) and then create a new one.
 
    auto reversible_dir = fc::canonical( db_dir );
    if( reversible_dir.filename().generic_string() == "." ) {
@@ -819,8 +877,7 @@ bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t c
 
    ilog( "Reconstructing '${reversible_dir}' from backed up reversible directory", ("reversible_dir", reversible_dir) );
 
-   chainbase::database  old_reversible( backup_dir, database::read_only, 0, true );
-   chainbase::database  new_reversible( reversible_dir, database::read_write, cache_size );
+   reversible_block_log new_reversible( reversible_dir );
    std::fstream         reversible_blocks;
    reversible_blocks.open( (reversible_dir.parent_path() / std::string("portable-reversible-blocks-").append( now ) ).generic_string().c_str(),
                            std::ios::out | std::ios::binary );
@@ -828,35 +885,27 @@ bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t c
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   old_reversible.add_index<reversible_block_index>();
-   new_reversible.add_index<reversible_block_index>();
-   const auto& ubi = old_reversible.get_index<reversible_block_index,by_num>();
-   auto itr = ubi.begin();
-   if( itr != ubi.end() ) {
-      start = itr->blocknum;
-      end = start - 1;
-   }
-   if( truncate_at_block > 0 && start > truncate_at_block ) {
-      ilog( "Did not recover any reversible blocks since the specified block number to stop at (${stop}) is less than first block in the reversible database (${start}).", ("stop", truncate_at_block)("start", start) );
-      return true;
-   }
    try {
-      for( ; itr != ubi.end(); ++itr ) {
-         EOS_ASSERT( itr->blocknum == end + 1, gap_in_reversible_blocks_db,
-                     "gap in reversible block database between ${end} and ${blocknum}",
-                     ("end", end)("blocknum", itr->blocknum)
-                   );
-         reversible_blocks.write( itr->packedblock.data(), itr->packedblock.size() );
-         new_reversible.create<reversible_block_object>( [&]( auto& ubo ) {
-            ubo.blocknum = itr->blocknum;
-            ubo.set_block( itr->get_block() ); // get_block and set_block rather than copying the packed data acts as additional validation
-         });
-         end = itr->blocknum;
+      reversible_block_log old_reversible( backup_dir, true );
+      if( !old_reversible.empty() ) {
+         start = old_reversible.first_block_num();
+         end = start - 1;
+      }
+      if( truncate_at_block > 0 && start > truncate_at_block ) {
+         ilog( "Did not recover any reversible blocks since the specified block number to stop at (${stop}) is less than first block in the reversible database (${start}).", ("stop", truncate_at_block)("start", start) );
+         return true;
+      }
+      for( uint32_t n = start; !old_reversible.empty() && n <= old_reversible.last_block_num(); ++n ) {
+         auto b = old_reversible.read_block_by_num( n ); // Verifies the checksum of the block.
+         auto packed = fc::raw::pack( *b );
+         reversible_blocks.write( packed.data(), packed.size() );
+         new_reversible.append( b );
+         end = n;
          ++num;
          if( end == truncate_at_block )
             break;
       }
-   } catch( const gap_in_reversible_blocks_db& e ) {
+   } catch( const fc::exception& e ) {
       wlog( "${details}", ("details", e.to_detail_string()) );
    } catch( ... ) {}
 
@@ -875,10 +924,9 @@ bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t c
 }
 
 bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
-                                             uint32_t cache_size,
                                              const fc::path& reversible_blocks_file ) {
    std::fstream         reversible_blocks;
-   chainbase::database  new_reversible( reversible_dir, database::read_write, cache_size );
+   reversible_block_log new_reversible( reversible_dir );
    reversible_blocks.open( reversible_blocks_file.generic_string().c_str(), std::ios::in | std::ios::binary );
 
    reversible_blocks.seekg( 0, std::ios::end );
@@ -888,7 +936,6 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   new_reversible.add_index<reversible_block_index>();
    try {
       while( reversible_blocks.tellg() < end_pos ) {
          signed_block tmp;
@@ -904,10 +951,7 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
                       );
          }
 
-         new_reversible.create<reversible_block_object>( [&]( auto& ubo ) {
-            ubo.blocknum = num;
-            ubo.set_block( std::make_shared<signed_block>(std::move(tmp)) );
-         });
+         new_reversible.append( std::make_shared<signed_block>(std::move(tmp)) );
          end = num;
       }
    } catch( gap_in_reversible_blocks_db& e ) {
@@ -925,34 +969,26 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
 
 bool chain_plugin::export_reversible_blocks( const fc::path& reversible_dir,
                                              const fc::path& reversible_blocks_file ) {
-   chainbase::database  reversible( reversible_dir, database::read_only, 0, true );
+   reversible_block_log reversible( reversible_dir, true );
    std::fstream         reversible_blocks;
    reversible_blocks.open( reversible_blocks_file.generic_string().c_str(), std::ios::out | std::ios::binary );
 
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   reversible.add_index<reversible_block_index>();
-   const auto& ubi = reversible.get_index<reversible_block_index,by_num>();
-   auto itr = ubi.begin();
-   if( itr != ubi.end() ) {
-      start = itr->blocknum;
+   if( !reversible.empty() ) {
+      start = reversible.first_block_num();
       end = start - 1;
    }
    try {
-      for( ; itr != ubi.end(); ++itr ) {
-         EOS_ASSERT( itr->blocknum == end + 1, gap_in_reversible_blocks_db,
-                     "gap in reversible block database between ${end} and ${blocknum}",
-                     ("end", end)("blocknum", itr->blocknum)
-                   );
-         signed_block tmp;
-         fc::datastream<const char *> ds( itr->packedblock.data(), itr->packedblock.size() );
-         fc::raw::unpack(ds, tmp); // Verify that packed block has not been corrupted.
-         reversible_blocks.write( itr->packedblock.data(), itr->packedblock.size() );
-         end = itr->blocknum;
+      for( uint32_t n = start; !reversible.empty() && n <= reversible.last_block_num(); ++n ) {
+         auto b = reversible.read_block_by_num( n ); // Verify that packed block has not been corrupted.
+         auto packed = fc::raw::pack( *b );
+         reversible_blocks.write( packed.data(), packed.size() );
+         end = n;
          ++num;
       }
-   } catch( const gap_in_reversible_blocks_db& e ) {
+   } catch( const fc::exception& e ) {
       wlog( "${details}", ("details", e.to_detail_string()) );
    } catch( ... ) {}
 
@@ -1398,6 +1434,10 @@ read_only::get_producer_schedule_result read_only::get_producer_schedule( const
    return result;
 }
 
+read_only::get_wasm_cache_stats_result read_only::get_wasm_cache_stats( const read_only::get_wasm_cache_stats_params& p ) const {
+   return db.get_wasm_interface().get_cache_stats();
+}
+
 template<typename Api>
 struct resolver_factory {
    static auto make(const Api* api, const fc::microseconds& max_serialization_time) {
@@ -1642,8 +1682,9 @@ read_only::get_code_results read_only::get_code( const get_code_params& params )
 
    EOS_ASSERT( params.code_as_wasm, unsupported_feature, "Returning WAST from get_code is no longer supported" );
 
-   if( accnt.code.size() ) {
-      result.wasm = string(accnt.code.begin(), accnt.code.end());
+   if( accnt.code_version != digest_type() ) {
+      const auto& code = d.get<code_object,by_code_hash>( accnt.code_version );
+      result.wasm = string(code.code.begin(), code.code.end());
       result.code_hash = accnt.code_version;
    }
 
@@ -1661,7 +1702,7 @@ read_only::get_code_hash_results read_only::get_code_hash( const get_code_hash_p
    const auto& d = db.db();
    const auto& accnt  = d.get<account_object,by_name>( params.account_name );
 
-   if( accnt.code.size() ) {
+   if( accnt.code_version != digest_type() ) {
       result.code_hash = accnt.code_version;
    }
 
@@ -1674,7 +1715,10 @@ read_only::get_raw_code_and_abi_results read_only::get_raw_code_and_abi( const g
 
    const auto& d = db.db();
    const auto& accnt = d.get<account_object,by_name>(params.account_name);
-   result.wasm = blob{{accnt.code.begin(), accnt.code.end()}};
+   if( accnt.code_version != digest_type() ) {
+      const auto& code = d.get<code_object,by_code_hash>( accnt.code_version );
+      result.wasm = blob{{code.code.begin(), code.code.end()}};
+   }
    result.abi = blob{{accnt.abi.begin(), accnt.abi.end()}};
 
    return result;
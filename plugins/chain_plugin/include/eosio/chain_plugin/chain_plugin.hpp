@@ -352,6 +352,13 @@ public:
 
    get_producer_schedule_result get_producer_schedule( const get_producer_schedule_params& params )const;
 
+   struct get_wasm_cache_stats_params {
+   };
+
+   using get_wasm_cache_stats_result = chain::wasm_interface::cache_stats;
+
+   get_wasm_cache_stats_result get_wasm_cache_stats( const get_wasm_cache_stats_params& params )const;
+
    struct get_scheduled_transactions_params {
       bool        json = false;
       string      lower_bound;  /// timestamp OR transaction ID
@@ -672,13 +679,11 @@ public:
    bool block_is_on_preferred_chain(const chain::block_id_type& block_id);
 
    static bool recover_reversible_blocks( const fc::path& db_dir,
-                                          uint32_t cache_size,
                                           optional<fc::path> new_db_dir = optional<fc::path>(),
                                           uint32_t truncate_at_block = 0
                                         );
 
    static bool import_reversible_blocks( const fc::path& reversible_dir,
-                                         uint32_t cache_size,
                                          const fc::path& reversible_blocks_file
                                        );
 
@@ -730,6 +735,7 @@ FC_REFLECT( eosio::chain_apis::read_only::get_producers_result, (rows)(total_pro
 
 FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_producer_schedule_params )
 FC_REFLECT( eosio::chain_apis::read_only::get_producer_schedule_result, (active)(pending)(proposed) );
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_wasm_cache_stats_params )
 
 FC_REFLECT( eosio::chain_apis::read_only::get_scheduled_transactions_params, (json)(lower_bound)(limit) )
 FC_REFLECT( eosio::chain_apis::read_only::get_scheduled_transactions_result, (transactions)(more) );
@@ -585,6 +585,7 @@ namespace eosio {
 
       void enqueue( const net_message &msg, bool trigger_send = true );
       void enqueue_block( const signed_block_ptr& sb, bool trigger_send = true, bool to_sync_queue = false);
+      void enqueue_block( const serialized_block_view& sb, bool trigger_send = true, bool to_sync_queue = false);
       void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                            bool trigger_send, int priority, go_away_reason close_after_send,
                            bool to_sync_queue = false);
@@ -1027,6 +1028,12 @@ namespace eosio {
       }
       try {
          controller& cc = my_impl->chain_plug->chain();
+         // irreversible blocks are sent as they are serialized in the block log, without decoding them
+         serialized_block_view raw = cc.fetch_serialized_block_by_number(num);
+         if(raw) {
+            enqueue_block( raw, trigger_send, true);
+            return true;
+         }
          signed_block_ptr sb = cc.fetch_block_by_number(num);
          if(sb) {
             enqueue_block( sb, trigger_send, true);
@@ -1085,6 +1092,25 @@ namespace eosio {
       return create_send_buffer( signed_block_which, *sb );
    }
 
+   static std::shared_ptr<std::vector<char>> create_send_buffer( const serialized_block_view& sb ) {
+      // the block is already packed, only the header and the which of net_message for signed_block are added
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      const uint32_t payload_size = which_size + sb.size();
+
+      const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
+      constexpr size_t header_size = sizeof( payload_size );
+      static_assert( header_size == message_header_size, "invalid message_header_size" );
+      const size_t buffer_size = header_size + payload_size;
+
+      auto send_buffer = std::make_shared<vector<char>>( buffer_size );
+      fc::datastream<char*> ds( send_buffer->data(), buffer_size );
+      ds.write( header, header_size );
+      fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+      ds.write( sb.data(), sb.size() );
+
+      return send_buffer;
+   }
+
    static std::shared_ptr<std::vector<char>> create_send_buffer( const packed_transaction& trx ) {
       // this implementation is to avoid copy of packed_transaction to net_message
       // matches which of net_message for packed_transaction
@@ -1095,6 +1121,10 @@ namespace eosio {
       enqueue_buffer( create_send_buffer( sb ), trigger_send, priority::low, no_reason, to_sync_queue);
    }
 
+   void connection::enqueue_block( const serialized_block_view& sb, bool trigger_send, bool to_sync_queue) {
+      enqueue_buffer( create_send_buffer( sb ), trigger_send, priority::low, no_reason, to_sync_queue);
+   }
+
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                                     bool trigger_send, int priority, go_away_reason close_after_send,
                                     bool to_sync_queue)
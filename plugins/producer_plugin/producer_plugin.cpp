@@ -180,6 +180,9 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       // path to write the snapshots to
       bfs::path _snapshots_dir;
+      uint32_t  _snapshot_format_version = unchunked_snapshot_format_version;
+      uint16_t  _snapshot_threads = 1;
+      bool      _snapshot_compression = false;
 
 
       void on_block( const block_state_ptr& bsp ) {
@@ -187,11 +190,11 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          if( bsp->header.timestamp <= _start_time ) return;
          if( bsp->block_num <= _last_signed_block_num ) return;
 
-         const auto& active_producer_to_signing_key = bsp->active_schedule.producers;
+         const auto& active_producer_to_signing_key = bsp->active_schedule->producers;
 
          flat_set<account_name> active_producers;
-         active_producers.reserve(bsp->active_schedule.producers.size());
-         for (const auto& p: bsp->active_schedule.producers) {
+         active_producers.reserve(bsp->active_schedule->producers.size());
+         for (const auto& p: bsp->active_schedule->producers) {
             active_producers.insert(p.producer_name);
          }
 
@@ -227,15 +230,15 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          auto new_bs = bsp->generate_next(new_block_header.timestamp);
 
          // for newly installed producers we can set their watermarks to the block they became active
-         if (new_bs.maybe_promote_pending() && bsp->active_schedule.version != new_bs.active_schedule.version) {
+         if (new_bs.maybe_promote_pending() && bsp->active_schedule->version != new_bs.active_schedule->version) {
             flat_set<account_name> new_producers;
-            new_producers.reserve(new_bs.active_schedule.producers.size());
-            for( const auto& p: new_bs.active_schedule.producers) {
+            new_producers.reserve(new_bs.active_schedule->producers.size());
+            for( const auto& p: new_bs.active_schedule->producers) {
                if (_producers.count(p.producer_name) > 0)
                   new_producers.insert(p.producer_name);
             }
 
-            for( const auto& p: bsp->active_schedule.producers) {
+            for( const auto& p: bsp->active_schedule->producers) {
                new_producers.erase(p.producer_name);
             }
 
@@ -554,6 +557,12 @@ void producer_plugin::set_program_options(
           "Number of worker threads in producer thread pool")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("snapshot-format-version", bpo::value<uint32_t>()->default_value(unchunked_snapshot_format_version),
+          "file format of the snapshots written, independent of the version of the chain state they hold: 1, each section as a single run of rows, or 2, sections in chunks written in parallel and optionally compressed")
+         ("snapshot-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
+          "Number of threads writing and compressing the parts of a format version 2 snapshot")
+         ("snapshot-compression", bpo::bool_switch()->default_value(false),
+          "compress the sections of format version 2 snapshots with zlib")
          ;
    config_file_options.add(producer_options);
 }
@@ -691,6 +700,16 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
                "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
    my->_thread_pool.emplace( thread_pool_size );
 
+   my->_snapshot_format_version = options.at( "snapshot-format-version" ).as<uint32_t>();
+   EOS_ASSERT( my->_snapshot_format_version == unchunked_snapshot_format_version ||
+               my->_snapshot_format_version == chunked_snapshot_format_version,
+               plugin_config_exception, "snapshot-format-version ${v} must be ${v1} or ${v2}",
+               ("v", my->_snapshot_format_version)("v1", unchunked_snapshot_format_version)("v2", chunked_snapshot_format_version));
+   my->_snapshot_threads = options.at( "snapshot-threads" ).as<uint16_t>();
+   EOS_ASSERT( my->_snapshot_threads > 0, plugin_config_exception,
+               "snapshot-threads ${num} must be greater than 0", ("num", my->_snapshot_threads));
+   my->_snapshot_compression = options.at( "snapshot-compression" ).as<bool>();
+
    if( options.count( "snapshots-dir" )) {
       auto sd = options.at( "snapshots-dir" ).as<bfs::path>();
       if( sd.is_relative()) {
@@ -959,9 +978,15 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const {
 
 
    auto snap_out = std::ofstream(snapshot_path, (std::ios::out | std::ios::binary));
-   auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-   chain.write_snapshot(writer);
-   writer->finalize();
+   if( my->_snapshot_format_version == chunked_snapshot_format_version ) {
+      auto writer = std::make_shared<sectioned_snapshot_writer>(snap_out, my->_snapshot_threads, my->_snapshot_compression);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   } else {
+      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   }
    snap_out.flush();
    snap_out.close();
 
@@ -971,7 +996,7 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const {
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
-   const auto& active_schedule = hbs->active_schedule.producers;
+   const auto& active_schedule = hbs->active_schedule->producers;
 
    // determine if this producer is in the active schedule and if so, where
    auto itr = std::find_if(active_schedule.begin(), active_schedule.end(), [&](const auto& asp){ return asp.producer_name == producer_name; });
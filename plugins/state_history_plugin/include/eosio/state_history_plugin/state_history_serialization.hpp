@@ -5,6 +5,7 @@
 #pragma once
 
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
@@ -112,7 +113,12 @@ datastream<ST>& operator<<(datastream<ST>& ds, const history_serial_wrapper<eosi
    fc::raw::pack(ds, as_type<fc::time_point>(obj.obj.last_code_update));
    fc::raw::pack(ds, as_type<eosio::chain::digest_type>(obj.obj.code_version));
    fc::raw::pack(ds, as_type<eosio::chain::block_timestamp_type>(obj.obj.creation_date));
-   fc::raw::pack(ds, as_type<eosio::chain::shared_string>(obj.obj.code));
+   if (obj.obj.code_version != eosio::chain::digest_type()) {
+      const auto& code = obj.db.get<eosio::chain::code_object, eosio::chain::by_code_hash>(obj.obj.code_version);
+      fc::raw::pack(ds, as_type<eosio::chain::shared_string>(code.code));
+   } else {
+      fc::raw::pack(ds, fc::unsigned_int(0));
+   }
    fc::raw::pack(ds, as_type<eosio::chain::shared_string>(obj.obj.abi));
    return ds;
 }
@@ -5,7 +5,7 @@
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/config.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/filesystem.hpp>
@@ -46,27 +46,16 @@ void blocklog::read_log() {
 
    ilog( "existing block log contains block num 1 through block num ${n}", ("n",end->block_num()) );
 
-   optional<chainbase::database> reversible_blocks;
-   try {
-      reversible_blocks.emplace(blocks_dir / config::reversible_blocks_dir_name, chainbase::database::read_only, config::default_reversible_cache_size);
-      reversible_blocks->add_index<reversible_block_index>();
-      const auto& idx = reversible_blocks->get_index<reversible_block_index,by_num>();
-      auto first = idx.lower_bound(end->block_num());
-      auto last = idx.rbegin();
-      if (first != idx.end() && last != idx.rend())
-         ilog( "existing reversible block num ${first} through block num ${last} ", ("first",first->get_block()->block_num())("last",last->get_block()->block_num()) );
-      else {
-         elog( "no blocks available in reversible block database: only block_log blocks are available" );
-         reversible_blocks.reset();
-      }
-   } catch( const std::runtime_error& e ) {
-      if( std::string(e.what()) == "database dirty flag set" ) {
-         elog( "database dirty flag set (likely due to unclean shutdown): only block_log blocks are available" );
-      } else if( std::string(e.what()) == "database metadata dirty flag set" ) {
-         elog( "database metadata dirty flag set (likely due to unclean shutdown): only block_log blocks are available" );
-      } else {
-         throw;
-      }
+   optional<reversible_block_log> reversible_blocks;
+   reversible_blocks.emplace(blocks_dir / config::reversible_blocks_dir_name, true);
+   if (!reversible_blocks->empty() && reversible_blocks->last_block_num() > end->block_num()) {
+      ilog( "existing reversible block num ${first} through block num ${last} ",
+            ("first",std::max(reversible_blocks->first_block_num(), end->block_num() + 1))("last",reversible_blocks->last_block_num()) );
+      if (reversible_blocks->repaired())
+         elog( "reversible block log ends in an incomplete record (likely due to unclean shutdown): only the blocks before it are available" );
+   } else {
+      elog( "no blocks available in reversible block database: only block_log blocks are available" );
+      reversible_blocks.reset();
    }
 
    std::ofstream output_blocks;
@@ -116,11 +105,9 @@ void blocklog::read_log() {
       contains_obj = true;
    }
    if (reversible_blocks) {
-      const reversible_block_object* obj = nullptr;
-      while( (block_num <= last_block) && (obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) ) {
+      while( (block_num <= last_block) && (next = reversible_blocks->read_block_by_num(block_num)) ) {
          if (as_json_array && contains_obj)
             *out << ",";
-         auto next = obj->get_block();
          print_block(next);
          ++block_num;
          contains_obj = true;
@@ -518,5 +518,53 @@ BOOST_AUTO_TEST_CASE( linkauth_special ) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( satisfied_authority_cache ) { try {
+   TESTER chain;
+   chain.create_accounts( {N(alice)} );
+   chain.produce_block();
+
+   const auto& authz = chain.control->get_authorization_manager();
+   vector<action> acts{ action( vector<permission_level>{{N(alice), config::active_name}}, N(alice), N(test), bytes() ) };
+   const flat_set<public_key_type> keys{ chain.get_public_key( N(alice), "active" ) };
+   const flat_set<public_key_type> new_keys{ chain.get_public_key( N(alice), "new" ) };
+
+   auto before = authz.get_satisfied_cache_stats();
+   authz.check_authorization( acts, keys );
+   authz.check_authorization( acts, keys );
+   BOOST_CHECK_EQUAL( authz.get_satisfied_cache_stats().hits, before.hits + 1 );
+
+   // keys not needed by the authority are still reported
+   auto extra_keys = keys;
+   extra_keys.insert( chain.get_public_key( N(alice), "owner" ) );
+   BOOST_CHECK_THROW( authz.check_authorization( acts, extra_keys ), tx_irrelevant_sig );
+
+   // a change that is undone is seen both ways, and a different change made after the undo is not mistaken for it
+   auto& mutable_authz = chain.control->get_mutable_authorization_manager();
+   const auto& perm = authz.get_permission( {N(alice), config::active_name} );
+   const flat_set<public_key_type> other_keys{ chain.get_public_key( N(alice), "other" ) };
+   {
+      auto session = const_cast<chainbase::database&>( chain.control->db() ).start_undo_session( true );
+      mutable_authz.modify_permission( perm, authority( chain.get_public_key( N(alice), "new" ) ) );
+      BOOST_CHECK_THROW( authz.check_authorization( acts, keys ), unsatisfied_authorization );
+      authz.check_authorization( acts, new_keys );
+      session.undo();
+   }
+   before = authz.get_satisfied_cache_stats();
+   authz.check_authorization( acts, keys );
+   BOOST_CHECK_EQUAL( authz.get_satisfied_cache_stats().hits, before.hits + 1 );
+   BOOST_CHECK_THROW( authz.check_authorization( acts, new_keys ), unsatisfied_authorization );
+   {
+      auto session = const_cast<chainbase::database&>( chain.control->db() ).start_undo_session( true );
+      mutable_authz.modify_permission( perm, authority( chain.get_public_key( N(alice), "other" ) ) );
+      BOOST_CHECK_THROW( authz.check_authorization( acts, new_keys ), unsatisfied_authorization );
+      authz.check_authorization( acts, other_keys );
+      session.undo();
+   }
+
+   chain.set_authority( N(alice), config::active_name, authority( chain.get_public_key( N(alice), "new" ) ) );
+   BOOST_CHECK_THROW( authz.check_authorization( acts, keys ), unsatisfied_authorization );
+   authz.check_authorization( acts, new_keys );
+} FC_LOG_AND_RETHROW() }
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,15 @@
  */
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace eosio;
 using namespace testing;
@@ -163,4 +172,396 @@ BOOST_AUTO_TEST_CASE(untrusted_producer_test)
    }) ;
 }
 
+// hashing the large levels of a merkle tree on the thread pool must give the same root as hashing them serially
+BOOST_AUTO_TEST_CASE(parallel_merkle_matches_serial)
+{
+   boost::asio::thread_pool pool( 3 );
+   const size_t per_chunk = config::merkle_pairs_per_chunk;
+   for( size_t count : { size_t(0), size_t(1), size_t(2), size_t(3), 4 * per_chunk - 1, 4 * per_chunk, 4 * per_chunk + 1,
+                         13 * per_chunk + 7 } ) {
+      vector<digest_type> ids;
+      ids.reserve( count );
+      for( size_t i = 0; i < count; ++i )
+         ids.emplace_back( digest_type::hash( uint64_t(i) ) );
+
+      BOOST_TEST_CONTEXT( "digests: " << count ) {
+         BOOST_CHECK_EQUAL( merkle( ids ), merkle( ids, pool, 4 ) );
+         BOOST_CHECK_EQUAL( merkle( ids ), merkle( ids, pool, 1 ) );
+      }
+   }
+   pool.join();
+}
+
+// blocks read from the block log by several threads while blocks are still being appended to it
+BOOST_AUTO_TEST_CASE(block_log_concurrent_reads)
+{ try {
+   tester chain;
+   chain.produce_blocks( 50 );
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > 10 );
+
+   std::atomic<bool> done{false};
+   std::atomic<uint32_t> mismatches{0};
+   vector<std::thread> readers;
+   for( int t = 0; t < 4; ++t ) {
+      readers.emplace_back( [&, t]() {
+         while( !done ) {
+            for( uint32_t n = 1 + t; n <= lib; n += 4 ) {
+               auto raw = chain.control->fetch_serialized_block_by_number( n );
+               if( !raw || raw.unpack()->block_num() != n )
+                  ++mismatches;
+            }
+         }
+      } );
+   }
+   chain.produce_blocks( 50 );
+   done = true;
+   for( auto& r : readers )
+      r.join();
+   BOOST_CHECK_EQUAL( mismatches.load(), 0u );
+
+   // blocks appended after the readers started are read through a fresh mapping, byte for byte as packed
+   const uint32_t new_lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( new_lib > lib );
+   for( uint32_t n : { uint32_t(1), lib, new_lib } ) {
+      auto raw = chain.control->fetch_serialized_block_by_number( n );
+      BOOST_REQUIRE( raw );
+      auto packed = fc::raw::pack( *chain.control->fetch_block_by_number( n ) );
+      BOOST_CHECK( packed == vector<char>( raw.data(), raw.data() + raw.size() ) );
+   }
+   BOOST_CHECK( !chain.control->fetch_serialized_block_by_number( new_lib + 1 ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(block_log_retained_files)
+{ try {
+   tester chain;
+   chain.produce_blocks( 80 );
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > 45 );
+
+   for( bool compress : { false, true } ) {
+      fc::temp_directory tempdir;
+      block_log_config cfg;
+      cfg.stride = 10;
+      cfg.max_retained_files = 2;
+      cfg.archive_dir = "archive";
+      cfg.compress_retained_files = compress;
+
+      auto check_reads = [&]( const block_log& blog, uint32_t first, uint32_t last ) {
+         BOOST_CHECK_EQUAL( blog.first_block_num(), first );
+         for( uint32_t n = first; n <= last; ++n ) {
+            auto raw = blog.read_serialized_block_by_num( n );
+            BOOST_REQUIRE( raw );
+            auto packed = fc::raw::pack( *chain.control->fetch_block_by_number( n ) );
+            BOOST_CHECK( packed == vector<char>( raw.data(), raw.data() + raw.size() ) );
+            BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->block_num(), n );
+         }
+         BOOST_CHECK( !blog.read_serialized_block_by_num( first - 1 ) );
+         BOOST_CHECK( !blog.read_serialized_block_by_num( last + 1 ) );
+      };
+
+      {
+         block_log blog( tempdir.path(), cfg );
+         blog.reset( chain.get_config().genesis, chain.control->fetch_block_by_number( 1 ) );
+         for( uint32_t n = 2; n <= 45; ++n )
+            blog.append( chain.control->fetch_block_by_number( n ) );
+
+         // 1-10 and 11-20 were moved out to the archive once 31-40 was retained, 41-45 are still in blocks.log
+         check_reads( blog, 21, 45 );
+         BOOST_CHECK_EQUAL( blog.get_block_pos( 30 ), block_log::npos );
+         BOOST_CHECK( blog.get_block_pos( 41 ) != block_log::npos );
+         BOOST_CHECK( fc::exists( tempdir.path() / "blocks-31-40.log" ) );
+         BOOST_CHECK( fc::exists( tempdir.path() / "archive" / "blocks-1-10.log" ) );
+         BOOST_CHECK( fc::exists( tempdir.path() / "archive" / "blocks-11-20.index" ) );
+         BOOST_CHECK( !fc::exists( tempdir.path() / "blocks-11-20.log" ) );
+      }
+
+      block_log blog( tempdir.path(), cfg );
+      BOOST_REQUIRE( blog.head() );
+      BOOST_CHECK_EQUAL( blog.head()->block_num(), 45u );
+      check_reads( blog, 21, 45 );
+   }
+} FC_LOG_AND_RETHROW() }
+
+// A crash between renaming blocks.log to its retained file and putting the new blocks.log in its place is completed
+// when the log is opened, and the head is found in the retained file until the next block is appended
+BOOST_AUTO_TEST_CASE(block_log_interrupted_retain)
+{ try {
+   tester chain;
+   chain.produce_blocks( 30 );
+   BOOST_REQUIRE( chain.control->last_irreversible_block_num() > 11 );
+
+   fc::temp_directory tempdir, nextdir;
+   block_log_config cfg;
+   cfg.stride = 10;
+   {
+      block_log blog( tempdir.path(), cfg );
+      blog.reset( chain.get_config().genesis, chain.control->fetch_block_by_number( 1 ) );
+      for( uint32_t n = 2; n <= 10; ++n )
+         blog.append( chain.control->fetch_block_by_number( n ) );
+   }
+   {
+      block_log next( nextdir.path(), cfg );
+      next.reset( chain.get_config().genesis, signed_block_ptr(), 11 );
+   }
+   fc::rename( tempdir.path() / "blocks.index", tempdir.path() / "blocks-1-10.index" );
+   fc::rename( tempdir.path() / "blocks.log", tempdir.path() / "blocks-1-10.log" );
+   fc::copy( nextdir.path() / "blocks.log", tempdir.path() / "blocks.log.next" );
+
+   {
+      block_log blog( tempdir.path(), cfg );
+      BOOST_CHECK( !fc::exists( tempdir.path() / "blocks.log.next" ) );
+      BOOST_REQUIRE( blog.head() );
+      BOOST_CHECK_EQUAL( blog.head()->block_num(), 10u );
+      BOOST_REQUIRE( blog.read_head() );
+      BOOST_CHECK_EQUAL( blog.read_head()->block_num(), 10u );
+      BOOST_CHECK_EQUAL( blog.first_block_num(), 1u );
+
+      // reset to carry on after the retained files keeps them
+      blog.reset( chain.get_config().genesis, signed_block_ptr(), 11 );
+      BOOST_CHECK( fc::exists( tempdir.path() / "blocks-1-10.log" ) );
+      for( uint32_t n = 11; n <= 12; ++n )
+         blog.append( chain.control->fetch_block_by_number( n ) );
+   }
+
+   block_log blog( tempdir.path(), cfg );
+   BOOST_REQUIRE( blog.head() );
+   BOOST_CHECK_EQUAL( blog.head()->block_num(), 12u );
+   for( uint32_t n = 1; n <= 12; ++n )
+      BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->block_num(), n );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(block_log_write_queue)
+{ try {
+   tester chain;
+   chain.produce_blocks( 60 );
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > 40 );
+
+   fc::temp_directory tempdir;
+   block_log_config cfg;
+   cfg.write_queue_size = 4;
+   {
+      block_log blog( tempdir.path(), cfg );
+      blog.reset( chain.get_config().genesis, chain.control->fetch_block_by_number( 1 ) );
+      for( uint32_t n = 2; n <= 40; ++n ) {
+         BOOST_CHECK_EQUAL( blog.append( chain.control->fetch_block_by_number( n ) ), block_log::npos );
+         // readable as soon as it is appended, whether or not the writer got to it yet
+         BOOST_CHECK_EQUAL( blog.head()->block_num(), n );
+         BOOST_REQUIRE( blog.read_block_by_num( n ) );
+         BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->block_num(), n );
+      }
+      BOOST_CHECK_THROW( blog.append( chain.control->fetch_block_by_number( 42 ) ), block_log_append_fail );
+      blog.flush();
+      BOOST_CHECK( blog.get_block_pos( 40 ) != block_log::npos );
+      BOOST_CHECK_EQUAL( blog.read_head()->block_num(), 40u );
+   }
+
+   // a crash in the middle of writing block 41 leaves part of it at the end of the log
+   {
+      auto packed = fc::raw::pack( *chain.control->fetch_block_by_number( 41 ) );
+      std::ofstream out( (tempdir.path() / "blocks.log").generic_string(), std::ios::binary | std::ios::app );
+      out.write( packed.data(), packed.size() / 2 );
+   }
+   block_log blog( tempdir.path(), cfg );
+   BOOST_REQUIRE( blog.head() );
+   BOOST_CHECK_EQUAL( blog.head()->block_num(), 40u );
+   blog.append( chain.control->fetch_block_by_number( 41 ) );
+   blog.flush();
+   for( uint32_t n = 1; n <= 41; ++n )
+      BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->block_num(), n );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(block_log_write_queue_killed)
+{ try {
+   fc::temp_directory tempdir;
+   controller::config cfg = validating_tester::default_config();
+   cfg.blocks_dir = tempdir.path() / config::default_blocks_dir_name;
+   cfg.state_dir = tempdir.path() / config::default_state_dir_name;
+   cfg.blocks_log.write_queue_size = 64;
+   const auto head_file = tempdir.path() / "killed_head";
+
+   // the node is run in a child process and killed there; only the forking thread carries over into a fork, so the
+   // node forked from it has no block log writer and every block it makes irreversible is still queued when it exits
+   const pid_t node = fork();
+   BOOST_REQUIRE( node >= 0 );
+   if( node == 0 ) {
+      int status = 1;
+      try {
+         tester chain( cfg );
+         chain.produce_blocks( 10 );
+         const pid_t killed = fork();
+         if( killed == 0 ) {
+            int killed_status = 1;
+            try {
+               chain.produce_blocks( 10 );
+               std::ofstream( head_file.generic_string() ) << chain.control->head_block_num();
+               killed_status = 0;
+            } catch( ... ) {}
+            _exit( killed_status );
+         }
+         if( killed > 0 && waitpid( killed, &status, 0 ) == killed )
+            status = WIFEXITED( status ) ? WEXITSTATUS( status ) : 1;
+      } catch( ... ) {}
+      _exit( status );
+   }
+   int status = 1;
+   BOOST_REQUIRE_EQUAL( waitpid( node, &status, 0 ), node );
+   BOOST_REQUIRE( WIFEXITED( status ) );
+   BOOST_REQUIRE_EQUAL( WEXITSTATUS( status ), 0 );
+   uint32_t killed_head = 0;
+   std::ifstream( head_file.generic_string() ) >> killed_head;
+   BOOST_REQUIRE( killed_head > 10 );
+
+   {
+      block_log blog( cfg.blocks_dir );
+      BOOST_REQUIRE( blog.head() );
+      BOOST_REQUIRE( blog.head()->block_num() < killed_head - 1 );
+   }
+
+   // the state was left dirty, so it is replayed: from the block log and then from the reversible blocks that were
+   // kept because the block log lost them
+   fc::remove_all( cfg.state_dir );
+   tester chain( cfg );
+   BOOST_CHECK_EQUAL( chain.control->head_block_num(), killed_head );
+   chain.produce_blocks( 5 );
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > killed_head );
+   chain.close();
+
+   block_log blog( cfg.blocks_dir );
+   for( uint32_t n = 1; n <= lib; ++n )
+      BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->block_num(), n );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(block_header_state_sharing)
+{ try {
+   tester chain;
+   chain.produce_blocks( 3 );
+
+   auto head    = chain.control->head_block_state();
+   auto pending = chain.control->pending_block_state();
+   BOOST_REQUIRE( head && pending );
+
+   // the schedules did not change with the pending block, so it holds the same instances as its parent
+   BOOST_CHECK( pending->active_schedule.shares_instance_with( head->active_schedule ) );
+   BOOST_CHECK( pending->pending_schedule.shares_instance_with( head->pending_schedule ) );
+   incremental_merkle expected_merkle = head->blockroot_merkle;
+   expected_merkle.append( head->id );
+   BOOST_CHECK( pending->blockroot_merkle.get_root() == expected_merkle.get_root() );
+
+   // and the state is serialized as it was before it was shared
+   block_header_state copy = fc::raw::unpack<block_header_state>( fc::raw::pack( static_cast<const block_header_state&>( *head ) ) );
+   BOOST_CHECK( fc::raw::pack( copy ) == fc::raw::pack( static_cast<const block_header_state&>( *head ) ) );
+   BOOST_CHECK_EQUAL( copy.active_schedule->producers.size(), head->active_schedule->producers.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(replay_read_ahead)
+{ try {
+   tester chain;
+   for( account_name a : { N(alice), N(bob), N(carol), N(dave), N(erin) } ) {
+      chain.create_account( a );
+      chain.produce_block();
+   }
+   chain.produce_blocks( 20 );
+
+   const uint32_t lib = chain.control->last_irreversible_block_num();
+   const block_id_type lib_id = chain.control->get_block_id_for_num( lib );
+   const controller::config cfg = chain.get_config();
+   chain.close();
+
+   // replaying only the irreversible block log, sequentially and with blocks decoded and their keys recovered ahead
+   for( uint16_t read_ahead : { 0, 4 } ) {
+      BOOST_TEST_CONTEXT( "read ahead: " << read_ahead ) {
+         fc::temp_directory tempdir;
+         controller::config replay_cfg = cfg;
+         replay_cfg.blocks_dir = tempdir.path() / config::default_blocks_dir_name;
+         replay_cfg.state_dir = tempdir.path() / config::default_state_dir_name;
+         replay_cfg.force_all_checks = true;
+         replay_cfg.replay_read_ahead_blocks = read_ahead;
+         fc::create_directories( replay_cfg.blocks_dir );
+         fc::copy( cfg.blocks_dir / "blocks.log", replay_cfg.blocks_dir / "blocks.log" );
+         fc::copy( cfg.blocks_dir / "blocks.index", replay_cfg.blocks_dir / "blocks.index" );
+
+         tester replayed( replay_cfg );
+         BOOST_CHECK_EQUAL( replayed.control->head_block_num(), lib );
+         BOOST_CHECK( replayed.control->head_block_id() == lib_id );
+         BOOST_CHECK( replayed.control->get_account( N(erin) ).name == N(erin) );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(reversible_block_log_truncation)
+{ try {
+   tester chain;
+   chain.produce_blocks( 20 );
+
+   // the controller holds every block after the last irreversible one
+   {
+      reversible_block_log rlog( chain.get_config().blocks_dir / config::reversible_blocks_dir_name, true );
+      BOOST_REQUIRE( !rlog.empty() );
+      BOOST_CHECK_EQUAL( rlog.first_block_num(), chain.control->last_irreversible_block_num() + 1 );
+      BOOST_CHECK_EQUAL( rlog.last_block_num(), chain.control->head_block_num() );
+      BOOST_CHECK( rlog.read_block_by_num( rlog.last_block_num() )->id() == chain.control->head_block_id() );
+   }
+
+   fc::temp_directory tempdir;
+   {
+      reversible_block_log rlog( tempdir.path() );
+      for( uint32_t n = 2; n <= 12; ++n )
+         rlog.append( chain.control->fetch_block_by_number( n ) );
+      BOOST_CHECK_THROW( rlog.append( chain.control->fetch_block_by_number( 14 ) ), gap_in_reversible_blocks_db );
+
+      rlog.remove_through( 5 );
+      rlog.truncate_from( 11 );
+      BOOST_CHECK_EQUAL( rlog.first_block_num(), 6u );
+      BOOST_CHECK_EQUAL( rlog.last_block_num(), 10u );
+      BOOST_CHECK( !rlog.read_block_by_num( 5 ) );
+      BOOST_CHECK( !rlog.read_block_by_num( 11 ) );
+   }
+
+   // a crash in the middle of appending block 11 leaves part of it at the end of the log
+   {
+      auto packed = fc::raw::pack( *chain.control->fetch_block_by_number( 11 ) );
+      std::ofstream out( (tempdir.path() / config::reversible_blocks_log_filename).generic_string(), std::ios::binary | std::ios::app );
+      const uint32_t size = packed.size();
+      const uint64_t checksum = 0;
+      const uint32_t block_num = 11;
+      out.write( (const char*)&size, sizeof(size) );
+      out.write( (const char*)&checksum, sizeof(checksum) );
+      out.write( (const char*)&block_num, sizeof(block_num) );
+      out.write( packed.data(), packed.size() / 2 );
+   }
+
+   reversible_block_log rlog( tempdir.path() );
+   BOOST_CHECK( rlog.repaired() );
+   BOOST_CHECK_EQUAL( rlog.first_block_num(), 6u );
+   BOOST_CHECK_EQUAL( rlog.last_block_num(), 10u );
+   for( uint32_t n = 6; n <= 10; ++n )
+      BOOST_CHECK( rlog.read_block_by_num( n )->id() == chain.control->fetch_block_by_number( n )->id() );
+
+   rlog.append( chain.control->fetch_block_by_number( 11 ) );
+   rlog.remove_through( 11 );
+   BOOST_CHECK( rlog.empty() );
+   rlog.append( chain.control->fetch_block_by_number( 12 ) );
+   BOOST_CHECK_EQUAL( rlog.first_block_num(), 12u );
+   BOOST_CHECK_EQUAL( rlog.last_block_num(), 12u );
+} FC_LOG_AND_RETHROW() }
+
+// a reversible block database that cannot be moved into a log leaves no log behind, so the move is tried again
+BOOST_AUTO_TEST_CASE(reversible_block_log_failed_migration)
+{ try {
+   fc::temp_directory tempdir;
+   const auto log_path = tempdir.path() / config::reversible_blocks_log_filename;
+   std::ofstream( (tempdir.path() / "shared_memory.bin").generic_string(), std::ios::binary | std::ios::trunc );
+
+   BOOST_CHECK_THROW( reversible_block_log( tempdir.path() ), reversible_blocks_exception );
+   BOOST_CHECK( !fc::exists( log_path ) );
+   BOOST_CHECK( !fc::exists( tempdir.path() / (string(config::reversible_blocks_log_filename) + ".tmp") ) );
+   BOOST_CHECK( fc::exists( tempdir.path() / "shared_memory.bin" ) );
+
+   BOOST_CHECK_THROW( reversible_block_log( tempdir.path() ), reversible_blocks_exception );
+   BOOST_CHECK( !fc::exists( log_path ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -222,6 +222,125 @@ static const char mutable_global_wast[] = R"=====(
 )
 )=====";
 
+static const char table_lifecycle_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_remove_i64" (func $db_remove_i64 (param i32)))
+ (import "env" "db_end_i64" (func $db_end_i64 (param i64 i64 i64) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $itr i32)
+  (call $eosio_assert
+   (i32.eq (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 7)) (i32.const -1))
+   (i32.const 16))
+  (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 7) (i32.const 0) (i32.const 8)))
+  (set_local $itr (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 7)))
+  (call $eosio_assert (i32.ge_s (get_local $itr) (i32.const 0)) (i32.const 48))
+  (call $db_remove_i64 (get_local $itr))
+  (call $eosio_assert
+   (i32.eq (call $db_end_i64 (get_local $0) (get_local $0) (i64.const 1)) (i32.const -1))
+   (i32.const 80))
+  (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 8) (i32.const 0) (i32.const 8)))
+  (call $eosio_assert
+   (i32.ge_s (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 8)) (i32.const 0))
+   (i32.const 112))
+  (call $eosio_assert
+   (i32.lt_s (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 7)) (i32.const -1))
+   (i32.const 144))
+ )
+ (data (i32.const 16) "table should not exist yet\00")
+ (data (i32.const 48) "stored row not found\00")
+ (data (i32.const 80) "table should be gone\00")
+ (data (i32.const 112) "row of recreated table not found\00")
+ (data (i32.const 144) "removed row found\00")
+)
+)=====";
+
+static const char store_row_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (drop (call $db_store_i64 (get_local $0) (i64.const ${TABLE}) (get_local $0) (get_local $2) (i32.const 0) (i32.const 8)))
+ )
+)
+)=====";
+
+static const char removable_row_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_remove_i64" (func $db_remove_i64 (param i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $itr i32)
+  (if (i64.eq (get_local $2) (i64.const 0)) (then
+    (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 7) (i32.const 0) (i32.const 8)))
+    (return)
+  ))
+  (set_local $itr (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 7)))
+  (call $eosio_assert (i32.ge_s (get_local $itr) (i32.const 0)) (i32.const 16))
+  (call $db_remove_i64 (get_local $itr))
+ )
+ (data (i32.const 16) "row to remove not found\00")
+)
+)=====";
+
+static const char notify_row_owner_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "require_recipient" (func $require_recipient (param i64)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (call $eosio_assert
+   (i32.ge_s (call $db_find_i64 (i64.const ${OWNER}) (i64.const ${OWNER}) (i64.const 1) (i64.const 7)) (i32.const 0))
+   (i32.const 16))
+  (call $require_recipient (i64.const ${OWNER}))
+ )
+ (data (i32.const 16) "row of the owner not found\00")
+)
+)=====";
+
+static const char tight_loop_wast[] = R"=====(
+(module
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (loop $spin
+   (br $spin)
+  )
+ )
+)
+)=====";
+
+static const char tight_counting_loop_wast[] = R"=====(
+(module
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $i i64)
+  (loop $spin
+   (set_local $i (i64.add (get_local $i) (i64.const 1)))
+   (br_if $spin (i64.ne (get_local $i) (i64.const 0)))
+  )
+ )
+)
+)=====";
+
 static const char biggest_memory_wast[] = R"=====(
 (module
  (import "env" "eosio_assert" (func $$eosio_assert (param i32 i32)))
@@ -2,10 +2,13 @@
  *  @file
  *  @copyright defined in eos/LICENSE
  */
+#include <eosio/chain/database_header_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/transaction_dedup_store.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/filesystem.hpp>
 
 #include <boost/test/unit_test.hpp>
 
@@ -66,7 +69,7 @@ BOOST_AUTO_TEST_SUITE(database_tests)
 
          // Utility function to check expected irreversible block
          auto calc_exp_last_irr_block_num = [&](uint32_t head_block_num) -> uint32_t {
-            const auto producers_size = test.control->head_block_state()->active_schedule.producers.size();
+            const auto producers_size = test.control->head_block_state()->active_schedule->producers.size();
             const auto max_reversible_rounds = EOS_PERCENT(producers_size, config::percent_100 - config::irreversible_threshold_percent);
             if( max_reversible_rounds == 0) {
                return head_block_num;
@@ -99,4 +102,123 @@ BOOST_AUTO_TEST_SUITE(database_tests)
       } FC_LOG_AND_RETHROW()
    }
 
+   // Undo, squash, commit and expiry of the transaction deduplication store, and its round trip through a file
+   BOOST_AUTO_TEST_CASE(transaction_dedup_store_test) {
+      try {
+         fc::temp_directory tempdir;
+         const auto id = []( uint32_t n ) { return fc::sha256::hash( std::to_string(n) ); };
+         const time_point_sec t0( 1000 );
+
+         {
+            transaction_dedup_store store( tempdir.path() );
+            store.set_revision( 10 );
+
+            auto block = store.start_undo_session( true );
+            BOOST_TEST( store.revision() == 11 );
+            BOOST_TEST( store.add( id(1), t0 ) );
+            BOOST_TEST( store.add( id(2), t0 + 1 ) );
+            BOOST_TEST( !store.add( id(1), t0 ) );
+
+            {
+               auto trx = store.start_undo_session( true );
+               BOOST_TEST( store.add( id(3), t0 ) );
+               trx.undo();
+            }
+            BOOST_TEST( !store.contains( id(3) ) );
+
+            {
+               auto trx = store.start_undo_session( true );
+               BOOST_TEST( store.add( id(3), t0 + 2 ) );
+               trx.squash();
+            }
+            BOOST_TEST( store.contains( id(3) ) );
+            BOOST_TEST( store.revision() == 11 );
+            block.push();
+
+            // expiring in a later session is undone along with it
+            {
+               auto next = store.start_undo_session( true );
+               store.clear_expired( fc::time_point( t0 + 1 ) + fc::microseconds(1) );
+               BOOST_TEST( !store.contains( id(1) ) );
+               BOOST_TEST( !store.contains( id(2) ) );
+               BOOST_TEST( store.contains( id(3) ) );
+            }
+            BOOST_TEST( store.contains( id(1) ) );
+            BOOST_TEST( store.contains( id(2) ) );
+            BOOST_TEST( store.get_stats().buckets == 3u );
+
+            // expiration is exclusive of the expiration time itself
+            auto next = store.start_undo_session( true );
+            store.clear_expired( fc::time_point( t0 ) );
+            BOOST_TEST( store.contains( id(1) ) );
+            BOOST_TEST( store.add( id(4), t0 + 2 ) );
+            next.push();
+
+            store.commit( 11 );
+            BOOST_TEST( store.get_stats().undo_sessions == 1u );
+         }
+
+         // the pending session is written out with the contents and can still be undone after reading them back
+         transaction_dedup_store store( tempdir.path() );
+         BOOST_TEST( store.revision() == 12 );
+         BOOST_TEST( store.get_stats().transactions == 4u );
+         vector<transaction_id_type> walked;
+         store.walk( [&]( const transaction_id_type& i, time_point_sec ) { walked.push_back( i ); } );
+         BOOST_TEST( (walked == vector<transaction_id_type>{ id(1), id(2), id(3), id(4) }) );
+
+         store.undo();
+         BOOST_TEST( store.revision() == 11 );
+         BOOST_TEST( !store.contains( id(4) ) );
+         BOOST_TEST( store.contains( id(3) ) );
+         store.undo();
+         BOOST_TEST( store.contains( id(3) ) );
+
+         // walking follows the order of addition rather than of expiration, as snapshots did with the database rows
+         transaction_dedup_store unordered;
+         BOOST_TEST( unordered.add( id(5), t0 + 5 ) );
+         BOOST_TEST( unordered.add( id(6), t0 ) );
+         BOOST_TEST( unordered.add( id(7), t0 + 5 ) );
+         walked.clear();
+         unordered.walk( [&]( const transaction_id_type& i, time_point_sec ) { walked.push_back( i ); } );
+         BOOST_TEST( (walked == vector<transaction_id_type>{ id(5), id(6), id(7) }) );
+      } FC_LOG_AND_RETHROW()
+   }
+
+   // A state database from before its layout was versioned, or of an older version, is refused, and replaying the blockchain rebuilds it
+   BOOST_AUTO_TEST_CASE(database_version_check) {
+      try {
+         tester test;
+         test.produce_blocks( 2 );
+         test.control->abort_block();
+
+         auto& db = test.control->mutable_db();
+         const auto& header = db.get<database_header_object>();
+         BOOST_TEST( header.version == database_header_object::current_version );
+         db.remove( header );
+         test.close();
+
+         BOOST_CHECK_THROW( test.open( nullptr ), bad_database_version_exception );
+         test.close();
+
+         fc::remove_all( test.get_config().state_dir );
+         test.open( nullptr );
+         test.produce_blocks( 2 );
+         test.control->abort_block();
+
+         // a database of an older layout is refused the same way
+         test.control->mutable_db().modify( test.control->db().get<database_header_object>(), []( auto& h ) {
+            h.version = database_header_object::minimum_version - 1;
+         });
+         test.close();
+
+         BOOST_CHECK_THROW( test.open( nullptr ), bad_database_version_exception );
+         test.close();
+
+         fc::remove_all( test.get_config().state_dir );
+         test.open( nullptr );
+         BOOST_TEST( test.control->db().get<database_header_object>().version == database_header_object::current_version );
+         test.produce_blocks( 2 );
+      } FC_LOG_AND_RETHROW()
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
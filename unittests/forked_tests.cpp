@@ -16,6 +16,8 @@
 
 #include <contracts.hpp>
 
+#include <fstream>
+
 using namespace eosio::chain;
 using namespace eosio::testing;
 
@@ -381,4 +383,99 @@ BOOST_AUTO_TEST_CASE( read_modes ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( reuse_unapplied_transaction_metadata ) try {
+   tester main;
+   tester other;
+   push_blocks(main, other);
+
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                             newaccount{
+                                .creator  = config::system_account_name,
+                                .name     = N(alice),
+                                .owner    = authority( get_public_key( N(alice), "owner" ) ),
+                                .active   = authority( get_public_key( N(alice), "active" ) )
+                             });
+   main.set_transaction_headers( trx );
+   trx.sign( get_private_key( config::system_account_name, "active" ), main.control->get_chain_id() );
+
+   main.push_transaction( trx );
+   other.push_transaction( trx );
+   // as when a block produced elsewhere arrives, the speculatively applied transaction goes back to unapplied
+   other.control->abort_block();
+   BOOST_REQUIRE_EQUAL( other.control->get_unapplied_transactions().size(), 1u );
+   auto unapplied = other.control->get_unapplied_transactions().begin()->second;
+   const bool unapplied_accepted = unapplied->accepted;
+
+   transaction_metadata_ptr applied;
+   auto c = other.control->accepted_block.connect( [&]( const block_state_ptr& bsp ) {
+      if( bsp->trxs.size() == 1 )
+         applied = bsp->trxs.front();
+   });
+   other.push_block( main.produce_block() );
+   c.disconnect();
+
+   // the block's metadata shares the unpacked transaction and the recovered keys, and leaves the unapplied one as it was
+   BOOST_REQUIRE( applied );
+   BOOST_CHECK( applied != unapplied );
+   BOOST_CHECK( applied->packed_trx == unapplied->packed_trx );
+   BOOST_CHECK( applied->signed_id == unapplied->signed_id );
+   BOOST_CHECK( applied->signing_keys_future.valid() );
+   BOOST_CHECK_EQUAL( unapplied->accepted, unapplied_accepted );
+   BOOST_CHECK( other.control->get_unapplied_transactions().empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( fork_database_log_recovery ) try {
+   tester chain;
+   chain.produce_blocks( 1500 );
+   const auto head_id = chain.control->head_block_id();
+   const auto state_dir = chain.get_config().state_dir;
+   const auto forkdb_log = state_dir / config::forkdb_log_filename;
+   BOOST_REQUIRE( fc::exists( forkdb_log ) );
+   // the log was compacted as blocks became irreversible rather than growing with every block
+   BOOST_CHECK( fc::file_size( forkdb_log ) < 1500 * fc::raw::pack_size( *chain.control->head_block_state() ) );
+
+   // the log as a crash would leave it: everything recorded so far, and part of a record being written
+   const auto crash_copy = state_dir / "forkdb.log.crash";
+   fc::copy( forkdb_log, crash_copy );
+   chain.close();
+   BOOST_CHECK( !fc::exists( state_dir / config::forkdb_filename ) );
+   fc::remove( forkdb_log );
+   fc::rename( crash_copy, forkdb_log );
+   {
+      std::ofstream out( forkdb_log.generic_string(), std::ios::binary | std::ios::app );
+      out.write( "partial", 7 );
+   }
+
+   chain.open( nullptr );
+   BOOST_CHECK_EQUAL( chain.control->head_block_id(), head_id );
+   BOOST_REQUIRE( chain.control->fork_db_head_block_id() == head_id );
+   chain.produce_blocks( 10 );
+   BOOST_CHECK_EQUAL( chain.control->head_block_num(), block_header::num_from_id( head_id ) + 10 );
+} FC_LOG_AND_RETHROW()
+
+// a replay writes the fork database log once, compacted, when it ends
+BOOST_AUTO_TEST_CASE( fork_database_log_after_replay ) try {
+   tester chain;
+   chain.produce_blocks( 1500 );
+   const auto head_id = chain.control->head_block_id();
+   const auto state_dir = chain.get_config().state_dir;
+   const auto forkdb_log = state_dir / config::forkdb_log_filename;
+   const auto state_size = fc::raw::pack_size( *chain.control->head_block_state() );
+   chain.close();
+
+   fc::remove_all( state_dir );
+   chain.open( nullptr );
+   BOOST_CHECK_EQUAL( chain.control->head_block_id(), head_id );
+   BOOST_REQUIRE( fc::exists( forkdb_log ) );
+   // one record per block state held and the head, rather than the changes made by every replayed block
+   BOOST_CHECK( fc::file_size( forkdb_log ) < 4 * state_size );
+
+   chain.close();
+   chain.open( nullptr );
+   BOOST_REQUIRE( chain.control->fork_db_head_block_id() == head_id );
+   chain.produce_blocks( 10 );
+   BOOST_CHECK_EQUAL( chain.control->head_block_num(), block_header::num_from_id( head_id ) + 10 );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
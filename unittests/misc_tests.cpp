@@ -6,6 +6,7 @@
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/authority_checker.hpp>
 #include <eosio/chain/chain_config.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -868,6 +869,24 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
       BOOST_CHECK_EQUAL(1u, keys5.second.size());
       BOOST_CHECK_EQUAL(public_key, *keys5.second.begin());
 
+      // recover a batch, skipping the transactions that already have their keys
+      vector<transaction_metadata_ptr> batch;
+      for( int i = 0; i < 5; ++i )
+         batch.emplace_back( std::make_shared<transaction_metadata>( std::make_shared<packed_transaction>( trx, packed_transaction::none) ) );
+      batch.emplace_back( mtrx );
+      auto report = transaction_metadata::start_recover_keys( batch, thread_pool, test.control->get_chain_id(), 2 ).get();
+      BOOST_CHECK_EQUAL(5u, report.transactions);
+      BOOST_CHECK_EQUAL(5u, report.signatures);
+      for( const auto& m : batch ) {
+         auto batch_keys = m->recover_keys( test.control->get_chain_id() );
+         BOOST_CHECK_EQUAL(1u, batch_keys.second.size());
+         BOOST_CHECK_EQUAL(public_key, *batch_keys.second.begin());
+      }
+
+      // nothing left to recover
+      report = transaction_metadata::start_recover_keys( batch, thread_pool, test.control->get_chain_id(), 2 ).get();
+      BOOST_CHECK_EQUAL(0u, report.transactions);
+
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_CASE(reflector_init_test) {
@@ -1068,6 +1087,41 @@ BOOST_AUTO_TEST_CASE(reflector_init_test) {
 }
 
 
+BOOST_AUTO_TEST_CASE(signature_recovery_cache_test) { try {
+   signature_recovery_cache cache( signature_recovery_cache::shard_count ); // one entry per shard
+   const auto priv = base_tester::get_private_key( N(alice), "active" );
+   const auto pub  = priv.get_public_key();
+   const auto sig  = priv.sign( digest_type::hash( std::string("digest") ) );
+   const auto trx_a = transaction_id_type::hash( std::string("a") );
+   const auto trx_b = transaction_id_type::hash( std::string("b") );
+
+   public_key_type key;
+   fc::microseconds cpu_usage;
+   BOOST_CHECK( !cache.find( trx_a, sig, key, cpu_usage ) );
+   cache.add( trx_a, sig, pub, fc::microseconds(7) );
+   BOOST_REQUIRE( cache.find( trx_a, sig, key, cpu_usage ) );
+   BOOST_CHECK_EQUAL( key, pub );
+   BOOST_CHECK_EQUAL( cpu_usage.count(), 7 );
+   BOOST_CHECK( !cache.find( trx_b, sig, key, cpu_usage ) ); // same signature of another transaction
+
+   // a second signature of the same transaction lands in the same, full, shard and evicts the first
+   const auto sig2 = priv.sign( digest_type::hash( std::string("other digest") ) );
+   cache.add( trx_a, sig2, pub, fc::microseconds(3) );
+   BOOST_CHECK( !cache.find( trx_a, sig, key, cpu_usage ) );
+   BOOST_CHECK( cache.find( trx_a, sig2, key, cpu_usage ) );
+
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.entries, 1u );
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.misses, 3u );
+   BOOST_CHECK_EQUAL( stats.evictions, 1u );
+
+   cache.set_capacity( 0 );
+   cache.add( trx_b, sig, pub, fc::microseconds(7) );
+   BOOST_CHECK( !cache.find( trx_b, sig, key, cpu_usage ) );
+} FC_LOG_AND_RETHROW() }
+
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
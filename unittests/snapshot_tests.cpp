@@ -4,6 +4,7 @@
  */
 #include <sstream>
 
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -147,9 +148,156 @@ struct buffered_snapshot_suite {
 
 };
 
+struct sectioned_snapshot_suite {
+   using writer_t = sectioned_snapshot_writer;
+   using reader_t = sectioned_snapshot_reader;
+   using write_storage_t = std::ostringstream;
+   using snapshot_t = std::string;
+   using read_storage_t = std::istringstream;
+
+   // several threads and chunks far smaller than the sections, so that sections span chunks and parts
+   static const uint32_t threads = 4;
+   static const uint64_t chunk_size = 4*1024;
+
+   struct writer : public writer_t {
+      writer( const std::shared_ptr<write_storage_t>& storage )
+      :writer_t(*storage, threads, true, chunk_size)
+      ,storage(storage)
+      {
+
+      }
+
+      std::shared_ptr<write_storage_t> storage;
+   };
+
+   struct reader : public reader_t {
+      explicit reader(const std::shared_ptr<read_storage_t>& storage)
+      :reader_t(*storage, threads)
+      ,storage(storage)
+      {}
+
+      std::shared_ptr<read_storage_t> storage;
+   };
+
+
+   static auto get_writer() {
+      return std::make_shared<writer>(std::make_shared<write_storage_t>());
+   }
+
+   static auto finalize(const std::shared_ptr<writer>& w) {
+      w->finalize();
+      return w->storage->str();
+   }
+
+   static auto get_reader( const snapshot_t& buffer) {
+      return std::make_shared<reader>(std::make_shared<read_storage_t>(buffer));
+   }
+
+};
+
 BOOST_AUTO_TEST_SUITE(snapshot_tests)
 
-using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite>;
+using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite, sectioned_snapshot_suite>;
+
+BOOST_AUTO_TEST_CASE(test_sectioned_snapshot_parts)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+
+   static const uint32_t parts = 37;
+   static const uint64_t rows_per_part = 1000;
+
+   for( bool compress : { false, true } ) {
+      for( uint32_t threads : { 1u, 4u } ) {
+         std::ostringstream out;
+         sectioned_snapshot_writer writer(out, threads, compress, 512);
+         writer.write_section("before", [&db]( auto& section ) {
+            section.add_row(std::string("first"), db);
+         });
+         writer.write_section_parts("numbers", parts, [&db]( uint32_t part, auto& section ) {
+            // parts of differing sizes, some of them empty
+            if( part % 5 == 3 ) {
+               return;
+            }
+            for( uint64_t n = part * rows_per_part; n < part * rows_per_part + rows_per_part - part; ++n ) {
+               section.add_row(n, db);
+            }
+         });
+         writer.write_section("empty", []( auto& ) {});
+         writer.finalize();
+
+         std::istringstream in(out.str());
+         auto reader = make_istream_snapshot_reader(in, threads);
+         BOOST_REQUIRE(std::dynamic_pointer_cast<sectioned_snapshot_reader>(reader));
+         reader->validate();
+
+         std::vector<uint64_t> expected;
+         for( uint32_t part = 0; part < parts; ++part ) {
+            if( part % 5 == 3 ) {
+               continue;
+            }
+            for( uint64_t n = part * rows_per_part; n < part * rows_per_part + rows_per_part - part; ++n ) {
+               expected.push_back(n);
+            }
+         }
+
+         // read the sections out of the order they were written in, as the directory allows
+         std::vector<uint64_t> actual;
+         reader->read_section("numbers", [&actual]( auto& section ) {
+            bool more = !section.empty();
+            while( more ) {
+               uint64_t n = 0;
+               more = section.read_row(n);
+               actual.push_back(n);
+            }
+         });
+         BOOST_REQUIRE(expected == actual);
+
+         reader->read_section("empty", []( auto& section ) {
+            BOOST_REQUIRE(section.empty());
+         });
+
+         reader->read_section("before", []( auto& section ) {
+            std::string s;
+            BOOST_REQUIRE(!section.read_row(s));
+            BOOST_REQUIRE_EQUAL(s, "first");
+         });
+
+         BOOST_REQUIRE(!reader->has_section<uint64_t>());
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE(test_istream_snapshot_reader_versions)
+{
+   tester chain;
+   chain.control->abort_block();
+
+   std::ostringstream unchunked_out;
+   auto unchunked_writer = std::make_shared<ostream_snapshot_writer>(unchunked_out);
+   chain.control->write_snapshot(unchunked_writer);
+   unchunked_writer->finalize();
+
+   std::ostringstream sectioned_out;
+   auto sectioned_writer = std::make_shared<sectioned_snapshot_writer>(sectioned_out, 2, true);
+   chain.control->write_snapshot(sectioned_writer);
+   sectioned_writer->finalize();
+
+   std::istringstream unchunked_in(unchunked_out.str());
+   auto unchunked_reader = make_istream_snapshot_reader(unchunked_in);
+   BOOST_REQUIRE(std::dynamic_pointer_cast<istream_snapshot_reader>(unchunked_reader));
+   unchunked_reader->validate();
+
+   std::istringstream sectioned_in(sectioned_out.str());
+   auto sectioned_reader = make_istream_snapshot_reader(sectioned_in);
+   BOOST_REQUIRE(std::dynamic_pointer_cast<sectioned_snapshot_reader>(sectioned_reader));
+   sectioned_reader->validate();
+
+   // a snapshot cut short loses its directory
+   std::istringstream truncated_in(sectioned_out.str().substr(0, sectioned_out.str().size() / 2));
+   auto truncated_reader = make_istream_snapshot_reader(truncated_in);
+   BOOST_REQUIRE_THROW(truncated_reader->validate(), snapshot_exception);
+}
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_exhaustive_snapshot, SNAPSHOT_SUITE, snapshot_suites)
 {
@@ -252,4 +400,77 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_replay_over_snapshot, SNAPSHOT_SUITE, snapsho
    BOOST_REQUIRE_EQUAL(expected_post_integrity_hash.str(), snap_chain.control->calculate_integrity_hash().str());
 }
 
+BOOST_AUTO_TEST_CASE(test_version_1_snapshot)
+{
+   tester chain;
+
+   // two accounts running the same code, so that a single code_object is referenced twice
+   chain.create_accounts({N(snapshot), N(snapshot1)});
+   chain.produce_blocks(1);
+   for( account_name a : { N(snapshot), N(snapshot1) } ) {
+      chain.set_code(a, contracts::snapshot_test_wasm());
+      chain.set_abi(a, contracts::snapshot_test_abi().data());
+   }
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+   const auto expected_integrity_hash = chain.control->calculate_integrity_hash();
+
+   auto writer = variant_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   const auto snapshot = variant_snapshot_suite::finalize(writer);
+
+   // lay it out as version 1 did: no section of code objects, and the code of each account in its row
+   const auto header_section = detail::snapshot_section_traits<chain_snapshot_header>::section_name();
+   const auto account_section = detail::snapshot_section_traits<account_object>::section_name();
+   const auto code_section = detail::snapshot_section_traits<code_object>::section_name();
+
+   std::map<std::string, fc::variant> code_by_hash;
+   for( const auto& section : snapshot["sections"].get_array() ) {
+      if( section["name"].as_string() != code_section ) continue;
+      for( const auto& row : section["rows"].get_array() )
+         code_by_hash[row["code_hash"].as_string()] = row["code"];
+   }
+   BOOST_REQUIRE_EQUAL(code_by_hash.size(), 1u);
+
+   fc::variants v1_sections;
+   for( const auto& section : snapshot["sections"].get_array() ) {
+      const auto name = section["name"].as_string();
+      if( name == code_section ) continue;
+
+      fc::variants rows;
+      for( const auto& row : section["rows"].get_array() ) {
+         if( name == header_section ) {
+            rows.emplace_back(fc::mutable_variant_object("version", 1));
+         } else if( name == account_section ) {
+            auto code = code_by_hash.find(row["code_version"].as_string());
+            rows.emplace_back(fc::mutable_variant_object(row)
+               ("code", code != code_by_hash.end() ? code->second : fc::variant(blob())));
+         } else {
+            rows.emplace_back(row);
+         }
+      }
+      v1_sections.emplace_back(fc::mutable_variant_object("name", name)("rows", std::move(rows)));
+   }
+   const fc::variant v1_snapshot = fc::mutable_variant_object(snapshot.get_object())("sections", std::move(v1_sections));
+
+   snapshotted_tester snap_chain(chain.get_config(), variant_snapshot_suite::get_reader(v1_snapshot), 1);
+   BOOST_REQUIRE_EQUAL(expected_integrity_hash.str(), snap_chain.control->calculate_integrity_hash().str());
+
+   const auto code_hash = snap_chain.control->get_account(N(snapshot)).code_version;
+   BOOST_REQUIRE_EQUAL(code_hash, snap_chain.control->get_account(N(snapshot1)).code_version);
+   const auto& code = snap_chain.control->db().get<code_object, by_code_hash>(code_hash);
+   BOOST_CHECK_EQUAL(code.code_ref_count, 2u);
+   BOOST_CHECK_EQUAL(code.code.size(), contracts::snapshot_test_wasm().size());
+
+   // the code read from the account rows runs, on both accounts
+   for( account_name a : { N(snapshot), N(snapshot1) } ) {
+      chain.push_action(a, N(increment), a, mutable_variant_object()
+         ( "value", 1 )
+      );
+   }
+   snap_chain.push_block(chain.produce_block());
+   chain.control->abort_block();
+   BOOST_REQUIRE_EQUAL(chain.control->calculate_integrity_hash().str(), snap_chain.control->calculate_integrity_hash().str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
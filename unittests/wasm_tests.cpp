@@ -6,8 +6,11 @@
 #include <utility>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/wasm_code_cache.hpp>
 #include <eosio/chain/wasm_eosio_constraints.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/testing/tester.hpp>
@@ -66,6 +69,42 @@ struct provereset {
 
 FC_REFLECT_EMPTY(provereset);
 
+/// the config of a tester of its own, keeping its blocks and state in dir
+static controller::config isolated_config( const fc::temp_directory& dir ) {
+   auto cfg = validating_tester::default_config();
+   cfg.blocks_dir = dir.path() / config::default_blocks_dir_name;
+   cfg.state_dir = dir.path() / config::default_state_dir_name;
+   return cfg;
+}
+
+/// creates each account and sets its code, producing blocks around it
+static void deploy_contracts( base_tester& chain, const vector<std::pair<account_name, string>>& contracts ) {
+   chain.produce_blocks(2);
+   vector<account_name> accounts;
+   for( const auto& c : contracts )
+      accounts.push_back( c.first );
+   chain.create_accounts( accounts );
+   chain.produce_block();
+   for( const auto& c : contracts )
+      chain.set_code( c.first, c.second.c_str() );
+   chain.produce_blocks(1);
+}
+
+/// pushes a transaction of one action without data to account, authorized by its active permission
+static transaction_trace_ptr push_contract_action( base_tester& chain, account_name account, action_name act_name = action_name(),
+                                                   fc::time_point deadline = fc::time_point::maximum(),
+                                                   uint32_t billed_cpu_time_us = base_tester::DEFAULT_BILLED_CPU_TIME_US ) {
+   signed_transaction trx;
+   action act;
+   act.account = account;
+   act.name = act_name;
+   act.authorization = vector<permission_level>{{account,config::active_name}};
+   trx.actions.push_back(act);
+   chain.set_transaction_headers(trx);
+   trx.sign(chain.get_private_key( account, "active" ), chain.control->get_chain_id());
+   return chain.push_transaction( trx, deadline, billed_cpu_time_us );
+}
+
 BOOST_AUTO_TEST_SUITE(wasm_tests)
 
 /**
@@ -622,6 +661,195 @@ BOOST_FIXTURE_TEST_CASE( check_global_reset, TESTER ) try {
    BOOST_CHECK_EQUAL(transaction_receipt::executed, receipt.status);
 } FC_LOG_AND_RETHROW()
 
+// Tables looked up within an action are cached, make sure the cache follows a table being created, removed and
+// created again by that same action
+BOOST_FIXTURE_TEST_CASE( table_lifecycle_within_action, TESTER ) try {
+   deploy_contracts( *this, {{N(tablecycle), table_lifecycle_wast}} );
+   push_contract_action( *this, N(tablecycle) );
+   produce_blocks(1);
+
+   const auto* tid = control->db().find<table_id_object, by_code_scope_table>(
+                        boost::make_tuple( N(tablecycle), N(tablecycle), name(1ULL) ) );
+   BOOST_REQUIRE( tid != nullptr );
+   BOOST_CHECK_EQUAL( 1u, tid->count );
+} FC_LOG_AND_RETHROW()
+
+// A loop that makes no calls only reaches checktime through the injected poll flag, make sure it still fails with
+// deadline_exception once its deadline has passed
+BOOST_FIXTURE_TEST_CASE( tight_loop_deadline, TESTER ) try {
+   deploy_contracts( *this, {{N(spinner), tight_loop_wast}} );
+   BOOST_CHECK_THROW(push_contract_action( *this, N(spinner), action_name(), fc::time_point::now() + fc::milliseconds(10), 200 ),
+                     deadline_exception);
+} FC_LOG_AND_RETHROW()
+
+// The same with the code compiled by wavm whatever runtime the tests run under: the generated loop must load the
+// poll flag again on every iteration rather than once before the loop
+BOOST_AUTO_TEST_CASE( tight_loop_deadline_wavm ) try {
+   fc::temp_directory tempdir;
+   auto cfg = isolated_config( tempdir );
+   cfg.wasm_runtime = wasm_interface::vm_type::wavm;
+   tester chain( cfg );
+
+   deploy_contracts( chain, {{N(spinner), tight_loop_wast}, {N(counter), tight_counting_loop_wast}} );
+   for( account_name a : { N(spinner), N(counter) } ) {
+      BOOST_CHECK_THROW(push_contract_action( chain, a, action_name(), fc::time_point::now() + fc::milliseconds(10), 200 ),
+                        deadline_exception);
+   }
+} FC_LOG_AND_RETHROW()
+
+// A native implementation only stands in for the exact code it was registered for; in differential mode it runs
+// alongside that code, and any divergence is counted while the outcome of the WASM code is kept
+BOOST_FIXTURE_TEST_CASE( native_contract_registry_modes, TESTER ) try {
+   deploy_contracts( *this, {{N(nativegood), fc::format_string(store_row_wast, fc::mutable_variant_object("TABLE", 2))},
+                             {N(nativebad), fc::format_string(store_row_wast, fc::mutable_variant_object("TABLE", 3))}} );
+
+   auto& registry = control->get_native_contract_registry();
+   uint32_t good_calls = 0;
+   registry.register_contract( control->get_account(N(nativegood)).code_version, [&]( apply_context& context ) {
+      ++good_calls;
+      const char row[8] = {};
+      context.db_store_i64( context.receiver, 2, context.receiver, context.act.name.value, row, sizeof(row) );
+   });
+   registry.register_contract( control->get_account(N(nativebad)).code_version, [&]( apply_context& context ) {
+      const char row[8] = {1};
+      context.db_store_i64( context.receiver, 3, context.receiver, context.act.name.value, row, sizeof(row) );
+   });
+   BOOST_CHECK_THROW( registry.register_contract( control->get_account(N(nativegood)).code_version,
+                                                  []( apply_context& ) {} ), misc_exception );
+
+   auto push = [&]( account_name account, uint64_t action_num ) {
+      push_contract_action( *this, account, name(action_num) );
+   };
+
+   auto find_row = [&]( account_name account, uint64_t table, uint64_t primary ) -> const key_value_object* {
+      const auto* tid = control->db().find<table_id_object, by_code_scope_table>(
+                           boost::make_tuple( account, account, name(table) ) );
+      if( !tid ) return nullptr;
+      return control->db().find<key_value_object, by_scope_primary>( boost::make_tuple( tid->id, primary ) );
+   };
+
+   // disabled by default
+   push( N(nativegood), 1 );
+   BOOST_CHECK_EQUAL( 0u, good_calls );
+   BOOST_CHECK( find_row( N(nativegood), 2, 1 ) != nullptr );
+
+   registry.set_mode( native_contract_registry::mode::differential );
+   push( N(nativegood), 2 );
+   BOOST_CHECK_EQUAL( 1u, good_calls );
+   BOOST_CHECK_EQUAL( 0u, registry.mismatches() );
+   BOOST_CHECK( find_row( N(nativegood), 2, 2 ) != nullptr );
+
+   push( N(nativebad), 1 );
+   BOOST_CHECK_EQUAL( 1u, registry.mismatches() );
+   const auto* bad_row = find_row( N(nativebad), 3, 1 );
+   BOOST_REQUIRE( bad_row != nullptr );
+   BOOST_CHECK_EQUAL( 0, bad_row->value[0] );
+
+   registry.set_mode( native_contract_registry::mode::enabled );
+   push( N(nativegood), 3 );
+   BOOST_CHECK_EQUAL( 2u, good_calls );
+   BOOST_CHECK( find_row( N(nativegood), 2, 3 ) != nullptr );
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+// Differential mode leaves no trace of the native run: the receipts, RAM deltas and billed usage are those of the
+// WASM code alone, whether the native implementation agrees with it or not
+BOOST_AUTO_TEST_CASE( native_contract_differential_receipts ) try {
+   auto run = []( native_contract_registry::mode mode ) {
+      TESTER chain;
+      deploy_contracts( chain, {{N(nativegood), fc::format_string(store_row_wast, fc::mutable_variant_object("TABLE", 2))},
+                                {N(nativebad), fc::format_string(store_row_wast, fc::mutable_variant_object("TABLE", 3))}} );
+
+      auto& registry = chain.control->get_native_contract_registry();
+      registry.register_contract( chain.control->get_account(N(nativegood)).code_version, []( apply_context& context ) {
+         const char row[8] = {};
+         context.db_store_i64( context.receiver, 2, context.receiver, context.act.name.value, row, sizeof(row) );
+      });
+      registry.register_contract( chain.control->get_account(N(nativebad)).code_version, []( apply_context& context ) {
+         const char row[64] = {1};
+         context.db_store_i64( context.receiver, 4, context.receiver, context.act.name.value, row, sizeof(row) );
+      });
+      registry.set_mode( mode );
+
+      vector<transaction_trace_ptr> traces;
+      for( account_name account : { N(nativegood), N(nativebad) } ) {
+         for( uint64_t action_num : { 1, 2 } )
+            traces.push_back( push_contract_action( chain, account, name(action_num) ) );
+      }
+      chain.produce_blocks(1);
+      BOOST_CHECK_EQUAL( mode == native_contract_registry::mode::differential ? 2u : 0u, registry.mismatches() );
+      return traces;
+   };
+
+   const auto disabled = run( native_contract_registry::mode::disabled );
+   const auto differential = run( native_contract_registry::mode::differential );
+   BOOST_REQUIRE_EQUAL( disabled.size(), differential.size() );
+   for( size_t i = 0; i < disabled.size(); ++i ) {
+      BOOST_REQUIRE( disabled[i]->receipt && differential[i]->receipt );
+      BOOST_CHECK( fc::raw::pack( *disabled[i]->receipt ) == fc::raw::pack( *differential[i]->receipt ) );
+      BOOST_CHECK_EQUAL( disabled[i]->net_usage, differential[i]->net_usage );
+      BOOST_REQUIRE_EQUAL( disabled[i]->action_traces.size(), differential[i]->action_traces.size() );
+      for( size_t a = 0; a < disabled[i]->action_traces.size(); ++a ) {
+         const auto& expected = disabled[i]->action_traces[a];
+         const auto& actual = differential[i]->action_traces[a];
+         BOOST_CHECK( fc::raw::pack( expected.receipt ) == fc::raw::pack( actual.receipt ) );
+         BOOST_CHECK( fc::raw::pack( expected.account_ram_deltas ) == fc::raw::pack( actual.account_ram_deltas ) );
+      }
+   }
+} FC_LOG_AND_RETHROW()
+
+// The native run is undone before the WASM code runs in the same context, and undo puts back what the native run
+// removed as new objects; what an earlier receiver of the action cached of them must not be used afterwards
+BOOST_FIXTURE_TEST_CASE( native_contract_differential_undo, TESTER ) try {
+   deploy_contracts( *this, {{N(cachedrow), removable_row_wast},
+                             {N(cachereader), fc::format_string(notify_row_owner_wast,
+                                                 fc::mutable_variant_object("OWNER", std::to_string(N(cachedrow).value)))}} );
+
+   auto& registry = control->get_native_contract_registry();
+   registry.register_contract( control->get_account(N(cachedrow)).code_version, []( apply_context& context ) {
+      if( context.act.name == name() ) {
+         const char row[8] = {};
+         context.db_store_i64( context.receiver, 1, context.receiver, 7, row, sizeof(row) );
+      } else {
+         context.db_remove_i64( context.db_find_i64( context.receiver, context.receiver, 1, 7 ) );
+      }
+   });
+   registry.set_mode( native_contract_registry::mode::differential );
+
+   push_contract_action( *this, N(cachedrow) );
+   BOOST_REQUIRE( control->db().find<table_id_object, by_code_scope_table>(
+                     boost::make_tuple( N(cachedrow), N(cachedrow), name(1ULL) ) ) != nullptr );
+
+   // cachereader finds the row, so its table and the row are cached, and then notifies cachedrow, which removes both
+   push_contract_action( *this, N(cachereader), name(1ULL) );
+   BOOST_CHECK_EQUAL( 0u, registry.mismatches() );
+   BOOST_CHECK( control->db().find<table_id_object, by_code_scope_table>(
+                   boost::make_tuple( N(cachedrow), N(cachedrow), name(1ULL) ) ) == nullptr );
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+// Accounts running the same code share a single code_object, which goes away with the last of them
+BOOST_FIXTURE_TEST_CASE( shared_code_storage, TESTER ) try {
+   deploy_contracts( *this, {{N(codeone), table_lifecycle_wast}, {N(codetwo), table_lifecycle_wast}} );
+
+   const auto code_hash = control->get_account(N(codeone)).code_version;
+   BOOST_REQUIRE_EQUAL( code_hash, control->get_account(N(codetwo)).code_version );
+   const auto* code = control->db().find<code_object, by_code_hash>( code_hash );
+   BOOST_REQUIRE( code != nullptr );
+   BOOST_CHECK_EQUAL( 2u, code->code_ref_count );
+
+   set_code(N(codeone), vector<uint8_t>{});
+   produce_blocks(1);
+   code = control->db().find<code_object, by_code_hash>( code_hash );
+   BOOST_REQUIRE( code != nullptr );
+   BOOST_CHECK_EQUAL( 1u, code->code_ref_count );
+   BOOST_CHECK( control->get_account(N(codeone)).code_version == digest_type() );
+
+   set_code(N(codetwo), vector<uint8_t>{});
+   produce_blocks(1);
+   BOOST_CHECK( control->db().find<code_object, by_code_hash>( code_hash ) == nullptr );
+} FC_LOG_AND_RETHROW()
+
 //Make sure we can create a wasm with maximum pages, but not grow it any
 BOOST_FIXTURE_TEST_CASE( big_memory, TESTER ) try {
    produce_blocks(2);
@@ -1742,6 +1970,164 @@ BOOST_FIXTURE_TEST_CASE( big_maligned_host_ptr, TESTER ) try {
    produce_blocks(1);
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( code_cache_round_trip ) try {
+   fc::temp_directory tempdir;
+   wasm_code_cache cache( tempdir.path(), wasm_interface::vm_type::wabt, "runtime 1" );
+
+   wasm_prepared_code prepared;
+   prepared.code_id = fc::sha256::hash( std::string("code") );
+   prepared.code = {0x00, 0x61, 0x73, 0x6d};
+   prepared.initial_memory = {1, 2, 3};
+   prepared.object_code = {4, 5};
+
+   BOOST_REQUIRE( !cache.find( prepared.code_id ) );
+   cache.add( prepared );
+   cache.flush();
+
+   auto found = cache.find( prepared.code_id );
+   BOOST_REQUIRE( found );
+   BOOST_REQUIRE( found->code == prepared.code );
+   BOOST_REQUIRE( found->initial_memory == prepared.initial_memory );
+   BOOST_REQUIRE( found->object_code == prepared.object_code );
+
+   // entries are keyed by runtime and its version as well as code hash
+   wasm_code_cache other_vm( tempdir.path(), wasm_interface::vm_type::wavm, "runtime 1" );
+   BOOST_REQUIRE( !other_vm.find( prepared.code_id ) );
+   wasm_code_cache other_version( tempdir.path(), wasm_interface::vm_type::wabt, "runtime 2" );
+   BOOST_REQUIRE( !other_version.find( prepared.code_id ) );
+
+   // a damaged entry is discarded rather than handed to a runtime
+   for( const auto& p : boost::filesystem::directory_iterator( tempdir.path() ) ) {
+      std::ofstream out( p.path().generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::in );
+      out.seekp( -1, std::ios::end );
+      out.put( 'x' );
+   }
+   BOOST_REQUIRE( !cache.find( prepared.code_id ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( code_cache_size_bound ) try {
+   fc::temp_directory tempdir;
+
+   auto make = []( const std::string& name ) {
+      wasm_prepared_code prepared;
+      prepared.code_id = fc::sha256::hash( name );
+      prepared.code = std::vector<uint8_t>( 1000, 'a' );
+      return prepared;
+   };
+   const auto first = make( "first" ), second = make( "second" ), third = make( "third" );
+
+   uint64_t entry_size = 0;
+   {
+      wasm_code_cache measure( tempdir.path() / "measure", wasm_interface::vm_type::wabt, string() );
+      measure.add( first );
+      measure.flush();
+      entry_size = measure.size();
+   }
+
+   // room for two entries
+   wasm_code_cache cache( tempdir.path() / "bounded", wasm_interface::vm_type::wabt, string(), 2 * entry_size );
+   cache.add( first );
+   cache.add( second );
+   cache.flush();
+   BOOST_REQUIRE( cache.find( first.code_id ) ); // now used more recently than the second
+
+   cache.add( third );
+   cache.flush();
+   BOOST_REQUIRE_EQUAL( cache.size(), 2 * entry_size );
+   BOOST_REQUIRE( cache.find( first.code_id ) );
+   BOOST_REQUIRE( !cache.find( second.code_id ) );
+   BOOST_REQUIRE( cache.find( third.code_id ) );
+} FC_LOG_AND_RETHROW()
+
+// The object code WAVM generates is kept in the code cache, so after a restart the contract is instantiated from it in
+// the background rather than compiled on its first call
+BOOST_AUTO_TEST_CASE( code_cache_object_code ) try {
+   fc::temp_directory tempdir;
+   auto cfg = isolated_config( tempdir );
+   cfg.wasm_runtime = wasm_interface::vm_type::wavm;
+   cfg.wasm_code_cache_dir = tempdir.path() / config::default_wasm_code_cache_dir_name;
+   {
+      tester chain( cfg );
+      deploy_contracts( chain, {{N(entrya), entry_wast}} );
+      push_contract_action( chain, N(entrya) );
+      chain.produce_block();
+   }
+
+   tester chain( cfg );
+   chain.control->get_wasm_interface().wait_for_pending_compiles();
+   const auto before = chain.control->get_wasm_interface().get_cache_stats();
+   push_contract_action( chain, N(entrya) );
+   chain.produce_block();
+   const auto stats = chain.control->get_wasm_interface().get_cache_stats();
+   BOOST_REQUIRE_EQUAL( stats.misses, before.misses + 1 );
+   BOOST_REQUIRE_EQUAL( stats.preloads, before.preloads + 1 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( instantiation_cache_eviction ) try {
+   fc::temp_directory tempdir;
+   auto cfg = isolated_config( tempdir );
+   cfg.wasm_cache_size = 1; // only the most recently used module fits
+   tester chain( cfg );
+
+   deploy_contracts( chain, {{N(entrya), entry_wast}, {N(entryb), entry_wast_2}} );
+
+   auto run = [&]( account_name account ) {
+      push_contract_action( chain, account );
+      chain.produce_block();
+      return chain.control->get_wasm_interface().get_cache_stats();
+   };
+
+   auto before = chain.control->get_wasm_interface().get_cache_stats();
+   auto stats = run(N(entrya));
+   BOOST_REQUIRE_EQUAL( stats.misses, before.misses + 1 );
+
+   stats = run(N(entrya));
+   BOOST_REQUIRE_EQUAL( stats.hits, before.hits + 1 );
+   BOOST_REQUIRE_EQUAL( stats.misses, before.misses + 1 );
+
+   stats = run(N(entryb));
+   BOOST_REQUIRE_EQUAL( stats.misses, before.misses + 2 );
+   BOOST_REQUIRE_EQUAL( stats.evictions, before.evictions + 1 );
+   BOOST_REQUIRE_EQUAL( stats.entries, 1u );
+
+   // entrya was evicted, so it has to be instantiated again
+   stats = run(N(entrya));
+   BOOST_REQUIRE_EQUAL( stats.misses, before.misses + 3 );
+   BOOST_REQUIRE_EQUAL( stats.entries, 1u );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( tiered_execution ) try {
+   fc::temp_directory tempdir;
+   auto cfg = isolated_config( tempdir );
+   cfg.wasm_runtime = wasm_interface::vm_type::tiered;
+   cfg.wasm_tiering.compile_after_calls = 1;
+   cfg.wasm_tiering.sync_compile_max_size = 0;
+   tester chain( cfg );
+
+   deploy_contracts( chain, {{N(entrycheck), entry_wast}} );
+
+   auto run = [&]() {
+      push_contract_action( chain, N(entrycheck) );
+      chain.produce_block();
+      return chain.control->get_wasm_interface().get_cache_stats();
+   };
+
+   // the first call is interpreted while the native compile runs in the background
+   auto stats = run();
+   BOOST_REQUIRE_EQUAL( stats.interpreted_calls, 1u );
+   BOOST_REQUIRE_EQUAL( stats.native_calls, 0u );
+
+   // once the compile has finished the next call switches to the native module
+   chain.control->get_wasm_interface().wait_for_pending_compiles();
+   stats = run();
+   BOOST_REQUIRE_EQUAL( stats.tier_ups, 1u );
+   BOOST_REQUIRE_EQUAL( stats.native_calls, 1u );
+
+   stats = run();
+   BOOST_REQUIRE_EQUAL( stats.native_calls, 2u );
+   BOOST_REQUIRE_EQUAL( stats.misses, 1u );
+} FC_LOG_AND_RETHROW()
+
 // TODO: restore net_usage_tests
 #if 0
 BOOST_FIXTURE_TEST_CASE(net_usage_tests, tester ) try {